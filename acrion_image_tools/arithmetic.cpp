@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "arithmetic.hpp"
+#include "io.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace acrion::imagetools
+{
+    namespace
+    {
+        template <typename T>
+        void ToPhysical(const T* stored, size_t count, double scale, double zero, double* physical)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                physical[i] = zero + scale * (double)stored[i];
+            }
+        }
+
+        // Physical values of `count` samples, starting at sample `first` of `samples`
+        void ToPhysical(const ScaledSamples& samples, int depth, size_t first, size_t count, double* physical)
+        {
+            switch (depth)
+            {
+            case 1:
+                ToPhysical((const uint8_t*)samples.stored + first, count, samples.scale, samples.zero, physical);
+                break;
+            case 2:
+                ToPhysical((const uint16_t*)samples.stored + first, count, samples.scale, samples.zero, physical);
+                break;
+            case 4:
+                ToPhysical((const uint32_t*)samples.stored + first, count, samples.scale, samples.zero, physical);
+                break;
+            case 8:
+                ToPhysical((const uint64_t*)samples.stored + first, count, samples.scale, samples.zero, physical);
+                break;
+            case -4:
+                ToPhysical((const float*)samples.stored + first, count, samples.scale, samples.zero, physical);
+                break;
+            case -8:
+                ToPhysical((const double*)samples.stored + first, count, samples.scale, samples.zero, physical);
+                break;
+            }
+        }
+    }
+
+    acrion::image::BitmapData<double> SubtractPhysical(const ScaledSamples& minuend, const ScaledSamples& subtrahend, int width, int height, int channels, int depth, SubtractMode mode)
+    {
+        if (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != -4 && depth != -8)
+        {
+            throw std::runtime_error("acrion::imagetools::SubtractPhysical: unsupported image depth " + std::to_string(depth));
+        }
+
+        acrion::image::BitmapData<double> result(width, height, channels);
+        double*                           difference = (double*)result.Buffer();
+        const size_t                      rowSamples = (size_t)width * channels;
+
+        parallel::ForEachBand(height,
+                              rowSamples * sizeof(double),
+                              [&](size_t firstRow, size_t rowCount)
+                              {
+                                  const size_t first = firstRow * rowSamples;
+                                  const size_t count = rowCount * rowSamples;
+                                  double*      out   = difference + first;
+
+                                  // the result receives the minuend, the subtrahend goes through a buffer of one row at a time
+                                  std::vector<double> row(rowSamples);
+                                  ToPhysical(minuend, depth, first, count, out);
+
+                                  for (size_t offset = 0; offset < count; offset += rowSamples)
+                                  {
+                                      ToPhysical(subtrahend, depth, first + offset, rowSamples, row.data());
+
+                                      for (size_t i = 0; i < rowSamples; ++i)
+                                      {
+                                          const double value = out[offset + i] - row[i];
+
+                                          if (mode == SubtractMode::Absolute)
+                                          {
+                                              out[offset + i] = std::abs(value);
+                                          }
+                                          else if (mode == SubtractMode::Wrap || value >= 0)
+                                          {
+                                              out[offset + i] = value;
+                                          }
+                                          else
+                                          {
+                                              out[offset + i] = 0;
+                                          }
+                                      }
+                                  }
+                              });
+
+        const auto [min, max] = io::ComputeDisplayRange(result, io::GetDisplayRangeOptions());
+        result.SetBrightnessRangeForDisplay(min, max);
+
+        return result;
+    }
+}
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "acrion_image_tools_export.h"
+
+#include "acrion/image/bitmap_data.hpp"
+
+#include <cstddef>
+
+namespace acrion::imagetools
+{
+    /// How SubtractPhysical treats negative differences, numbered like the `mode` argument of the Subtract* plugin functions.
+    enum class SubtractMode : long long
+    {
+        Clamp    = 0, ///< map negative differences to 0
+        Wrap     = 1, ///< keep negative differences, because doubles have nothing to wrap around
+        Absolute = 2  ///< absolute difference
+    };
+
+    /// The stored samples of a bitmap buffer and their scaling to physical values: physical = zero + scale * stored (see io::ScaledBitmap).
+    struct ScaledSamples
+    {
+        const void* stored = nullptr;
+        double      scale  = 1.0;
+        double      zero   = 0.0;
+    };
+
+    /// Subtracts the physical values of `subtrahend` from those of `minuend`, which both have the given dimensions and depth
+    /// (see acrion::image::Bitmap::Depth()). The differences of scaled samples are in general no stored values of either scaling,
+    /// so the result is a double bitmap of physical values, with the display range of io::GetDisplayRangeOptions().
+    ACRION_IMAGE_TOOLS_EXPORT acrion::image::BitmapData<double> SubtractPhysical(const ScaledSamples& minuend, const ScaledSamples& subtrahend, int width, int height, int channels, int depth, SubtractMode mode);
+}
@@ -0,0 +1,241 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Measures the throughput of the byte swapping kernels that convert FITS samples (big-endian) to native samples, single threaded,
+// for every BITPIX and target type. The reference is the scalar loop that cfitsio uses without SSSE3. Then the same for the FITS
+// checksum kernels, alone and fused with the byte swapping of a read, with the 16 bit sums of upstream cfitsio's ffcsum as reference.
+
+#include "byteswap.hpp"
+#include "checksum.hpp"
+#include "cpu.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using namespace acrion::imagetools;
+
+    template <typename T>
+    void SwapReference(const uint8_t* source, uint8_t* destination, size_t count, uint64_t flip)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            T value;
+            std::memcpy(&value, source + i * sizeof(T), sizeof(T));
+
+#ifdef _MSC_VER
+            if constexpr (sizeof(T) == 2) value = _byteswap_ushort(value);
+            else if constexpr (sizeof(T) == 4) value = _byteswap_ulong(value);
+            else if constexpr (sizeof(T) == 8) value = _byteswap_uint64(value);
+#else
+            if constexpr (sizeof(T) == 2) value = __builtin_bswap16(value);
+            else if constexpr (sizeof(T) == 4) value = __builtin_bswap32(value);
+            else if constexpr (sizeof(T) == 8) value = __builtin_bswap64(value);
+#endif
+
+            value ^= (T)flip;
+            std::memcpy(destination + i * sizeof(T), &value, sizeof(T));
+        }
+    }
+
+    // the checksum loop of cfitsio's ffcsum, which sums the big-endian 16 bit halves of the words separately
+    uint32_t ChecksumReference(const uint8_t* data, size_t size)
+    {
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+
+        for (size_t i = 0; i + 4 <= size; i += 4)
+        {
+            hi += (uint32_t)data[i] << 8 | data[i + 1];
+            lo += (uint32_t)data[i + 2] << 8 | data[i + 3];
+        }
+
+        uint64_t hiCarry = hi >> 16;
+        uint64_t loCarry = lo >> 16;
+
+        while (hiCarry || loCarry)
+        {
+            hi      = (hi & 0xFFFF) + loCarry;
+            lo      = (lo & 0xFFFF) + hiCarry;
+            hiCarry = hi >> 16;
+            loCarry = lo >> 16;
+        }
+
+        return (uint32_t)(hi << 16 | lo);
+    }
+
+    // returns GB/s of converted input
+    template <typename Function>
+    double Measure(size_t bytes, Function&& function)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        function(); // warm up caches and page tables
+
+        int        repetitions = 0;
+        const auto start       = Clock::now();
+        auto       elapsed     = Clock::duration::zero();
+
+        while (elapsed < std::chrono::milliseconds(300))
+        {
+            function();
+            ++repetitions;
+            elapsed = Clock::now() - start;
+        }
+
+        return (double)bytes * repetitions / std::chrono::duration<double>(elapsed).count() / 1e9;
+    }
+
+    const char* InstructionSetName(cpu::InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+        case cpu::InstructionSet::Avx512:
+            return "AVX-512";
+        case cpu::InstructionSet::Avx2:
+            return "AVX2";
+        case cpu::InstructionSet::Sse2:
+            return "SSE2";
+        default:
+            return "scalar";
+        }
+    }
+}
+
+int main()
+{
+    struct Case
+    {
+        int         bitpix;
+        const char* target;
+        uint64_t    flip;
+    };
+
+    const Case cases[] = {
+        {8, "uint8", 0},
+        {8, "int8 (BZERO=-128)", 0x80},
+        {16, "int16", 0},
+        {16, "uint16 (BZERO=2^15)", 0x8000},
+        {32, "int32", 0},
+        {32, "uint32 (BZERO=2^31)", 0x80000000},
+        {64, "int64", 0},
+        {64, "uint64 (BZERO=2^63)", 0x8000000000000000},
+        {-32, "float", 0},
+        {-64, "double", 0},
+    };
+
+    // cache resident and memory bound
+    const size_t sizes[] = {256 * 1024, 64 * 1024 * 1024};
+
+    std::printf("kernel: %s\n", InstructionSetName(cpu::Detect()));
+    std::printf("%-6s %-22s %-10s %12s %12s\n", "BITPIX", "target", "size", "GB/s", "reference");
+
+    for (const size_t bytes : sizes)
+    {
+        std::vector<uint8_t> source(bytes);
+        std::vector<uint8_t> destination(bytes);
+
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            source[i] = (uint8_t)(i * 2654435761u >> 13);
+        }
+
+        for (const Case& c : cases)
+        {
+            const int    sampleSize = (c.bitpix < 0 ? -c.bitpix : c.bitpix) / 8;
+            const size_t count      = bytes / sampleSize;
+
+            const double simd = Measure(bytes, [&] { SwapBytes(source.data(), destination.data(), count, sampleSize, c.flip); });
+            const double reference = Measure(bytes,
+                                             [&]
+                                             {
+                                                 switch (sampleSize)
+                                                 {
+                                                 case 1:
+                                                     return SwapReference<uint8_t>(source.data(), destination.data(), count, c.flip);
+                                                 case 2:
+                                                     return SwapReference<uint16_t>(source.data(), destination.data(), count, c.flip);
+                                                 case 4:
+                                                     return SwapReference<uint32_t>(source.data(), destination.data(), count, c.flip);
+                                                 default:
+                                                     return SwapReference<uint64_t>(source.data(), destination.data(), count, c.flip);
+                                                 }
+                                             });
+
+            std::printf("%-6d %-22s %7zu KiB %12.2f %12.2f\n", c.bitpix, c.target, bytes / 1024, simd, reference);
+        }
+    }
+
+    std::printf("\n%-29s %-10s %12s %12s\n", "checksum", "size", "GB/s", "reference");
+
+    for (const size_t bytes : sizes)
+    {
+        std::vector<uint8_t> source(bytes);
+        std::vector<uint8_t> destination(bytes);
+        const size_t         rowBytes = 16 * 1024;
+        volatile uint32_t    sink     = 0;
+
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            source[i] = (uint8_t)(i * 2654435761u >> 13);
+        }
+
+        if (FitsChecksum(source.data(), bytes) != ChecksumReference(source.data(), bytes))
+        {
+            std::printf("FitsChecksum differs from the reference\n");
+            return 1;
+        }
+
+        const double reference = Measure(bytes, [&] { sink = ChecksumReference(source.data(), bytes); });
+        const double stream    = Measure(bytes, [&] { sink = FitsChecksum(source.data(), bytes); });
+        const double samples   = Measure(bytes, [&] { sink = FitsSampleChecksum(source.data(), bytes / 2, 2, 0x8000); });
+        const double swap      = Measure(bytes, [&] { SwapBytes(source.data(), destination.data(), bytes / 2, 2, 0x8000); });
+        const double fused     = Measure(bytes,
+                                     [&]
+                                     {
+                                         // like the conversion of a memory mapped image, row by row
+                                         uint32_t sum = 0;
+
+                                         for (size_t row = 0; row < bytes; row += rowBytes)
+                                         {
+                                             SwapBytes(source.data() + row, destination.data() + row, rowBytes / 2, 2, 0x8000);
+                                             sum = FitsChecksum(source.data() + row, rowBytes, row, sum);
+                                         }
+
+                                         sink = sum;
+                                     });
+
+        std::printf("%-29s %7zu KiB %12.2f %12.2f\n", "file bytes (read)", bytes / 1024, stream, reference);
+        std::printf("%-29s %7zu KiB %12.2f %12.2f\n", "uint16 samples (write)", bytes / 1024, samples, reference);
+        std::printf("%-29s %7zu KiB %12.2f %12.2f\n", "uint16 swap + checksum", bytes / 1024, fused, swap);
+    }
+
+    return 0;
+}
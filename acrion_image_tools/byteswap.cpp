@@ -0,0 +1,316 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "byteswap.hpp"
+
+#include "cpu.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#ifdef ACRION_IMAGE_TOOLS_X86
+    #include <immintrin.h>
+#endif
+
+namespace acrion::imagetools
+{
+    namespace
+    {
+        template <size_t Size>
+        using Sample = std::conditional_t<Size == 1, uint8_t, std::conditional_t<Size == 2, uint16_t, std::conditional_t<Size == 4, uint32_t, uint64_t>>>;
+
+        template <typename T>
+        T ReverseBytes(T value)
+        {
+#ifdef _MSC_VER
+            if constexpr (sizeof(T) == 1) return value;
+            else if constexpr (sizeof(T) == 2) return _byteswap_ushort(value);
+            else if constexpr (sizeof(T) == 4) return _byteswap_ulong(value);
+            else return _byteswap_uint64(value);
+#else
+            if constexpr (sizeof(T) == 1) return value;
+            else if constexpr (sizeof(T) == 2) return __builtin_bswap16(value);
+            else if constexpr (sizeof(T) == 4) return __builtin_bswap32(value);
+            else return __builtin_bswap64(value);
+#endif
+        }
+
+        template <size_t Size>
+        void SwapScalar(const uint8_t* source, uint8_t* destination, size_t count, uint64_t flip)
+        {
+            using T = Sample<Size>;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                T value;
+                std::memcpy(&value, source + i * Size, Size);
+                value = ReverseBytes(value) ^ (T)flip;
+                std::memcpy(destination + i * Size, &value, Size);
+            }
+        }
+
+#ifdef ACRION_IMAGE_TOOLS_X86
+        // pshufb control for a 512 bit vector that reverses each group of Size bytes; narrower kernels use its beginning
+        template <size_t Size>
+        struct ReversePattern
+        {
+            alignas(64) uint8_t bytes[64] = {};
+
+            constexpr ReversePattern()
+            {
+                for (size_t i = 0; i < 64; ++i)
+                {
+                    bytes[i] = (uint8_t)(i % 16 / Size * Size + Size - 1 - i % Size); // pshufb indexes within 128 bit lanes
+                }
+            }
+        };
+
+        template <size_t Size>
+        constexpr ReversePattern<Size> reversePattern;
+
+        template <size_t Size>
+        ACRION_IMAGE_TOOLS_TARGET("sse2")
+        __m128i Broadcast128(uint64_t flip)
+        {
+            if constexpr (Size == 1) return _mm_set1_epi8((char)flip);
+            else if constexpr (Size == 2) return _mm_set1_epi16((short)flip);
+            else if constexpr (Size == 4) return _mm_set1_epi32((int)flip);
+            else return _mm_set1_epi64x((long long)flip);
+        }
+
+        template <size_t Size>
+        ACRION_IMAGE_TOOLS_TARGET("avx2")
+        __m256i Broadcast256(uint64_t flip)
+        {
+            if constexpr (Size == 1) return _mm256_set1_epi8((char)flip);
+            else if constexpr (Size == 2) return _mm256_set1_epi16((short)flip);
+            else if constexpr (Size == 4) return _mm256_set1_epi32((int)flip);
+            else return _mm256_set1_epi64x((long long)flip);
+        }
+
+        template <size_t Size>
+        ACRION_IMAGE_TOOLS_TARGET("avx512f,avx512bw")
+        __m512i Broadcast512(uint64_t flip)
+        {
+            if constexpr (Size == 1) return _mm512_set1_epi8((char)flip);
+            else if constexpr (Size == 2) return _mm512_set1_epi16((short)flip);
+            else if constexpr (Size == 4) return _mm512_set1_epi32((int)flip);
+            else return _mm512_set1_epi64((long long)flip);
+        }
+
+        // SSE2 has no byte shuffle, so bytes are swapped within 16 bit words by shifts, and the words are reversed by shuffles
+        template <size_t Size>
+        ACRION_IMAGE_TOOLS_TARGET("sse2")
+        void SwapSse2(const uint8_t* source, uint8_t* destination, size_t count, uint64_t flip)
+        {
+            const __m128i flips = Broadcast128<Size>(flip);
+            size_t        i     = 0;
+
+            for (; (i + 16 / Size) <= count; i += 16 / Size)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(source + i * Size));
+
+                if constexpr (Size > 1)
+                {
+                    v = _mm_or_si128(_mm_srli_epi16(v, 8), _mm_slli_epi16(v, 8));
+                }
+
+                if constexpr (Size == 4)
+                {
+                    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+                }
+                else if constexpr (Size == 8)
+                {
+                    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+                }
+
+                _mm_storeu_si128((__m128i*)(destination + i * Size), _mm_xor_si128(v, flips));
+            }
+
+            SwapScalar<Size>(source + i * Size, destination + i * Size, count - i, flip);
+        }
+
+        template <size_t Size>
+        ACRION_IMAGE_TOOLS_TARGET("avx2")
+        void SwapAvx2(const uint8_t* source, uint8_t* destination, size_t count, uint64_t flip)
+        {
+            const __m256i mask  = _mm256_load_si256((const __m256i*)reversePattern<Size>.bytes);
+            const __m256i flips = Broadcast256<Size>(flip);
+            size_t        i     = 0;
+
+            // two vectors per iteration, so that loads, shuffles and stores of both can overlap
+            for (; (i + 64 / Size) <= count; i += 64 / Size)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i*)(source + i * Size));
+                __m256i b = _mm256_loadu_si256((const __m256i*)(source + i * Size + 32));
+
+                if constexpr (Size > 1)
+                {
+                    a = _mm256_shuffle_epi8(a, mask);
+                    b = _mm256_shuffle_epi8(b, mask);
+                }
+
+                _mm256_storeu_si256((__m256i*)(destination + i * Size), _mm256_xor_si256(a, flips));
+                _mm256_storeu_si256((__m256i*)(destination + i * Size + 32), _mm256_xor_si256(b, flips));
+            }
+
+            SwapSse2<Size>(source + i * Size, destination + i * Size, count - i, flip);
+        }
+
+        template <size_t Size>
+        ACRION_IMAGE_TOOLS_TARGET("avx512f,avx512bw")
+        void SwapAvx512(const uint8_t* source, uint8_t* destination, size_t count, uint64_t flip)
+        {
+            const __m512i mask  = _mm512_load_si512(reversePattern<Size>.bytes);
+            const __m512i flips = Broadcast512<Size>(flip);
+            size_t        i     = 0;
+
+            for (; (i + 64 / Size) <= count; i += 64 / Size)
+            {
+                __m512i v = _mm512_loadu_si512(source + i * Size);
+
+                if constexpr (Size > 1)
+                {
+                    v = _mm512_shuffle_epi8(v, mask);
+                }
+
+                _mm512_storeu_si512(destination + i * Size, _mm512_xor_si512(v, flips));
+            }
+
+            SwapSse2<Size>(source + i * Size, destination + i * Size, count - i, flip);
+        }
+#endif
+
+        using Kernel = void (*)(const uint8_t*, uint8_t*, size_t, uint64_t);
+
+        template <size_t Size>
+        Kernel SelectKernel(cpu::InstructionSet instructionSet)
+        {
+#ifdef ACRION_IMAGE_TOOLS_X86
+            switch (instructionSet)
+            {
+            case cpu::InstructionSet::Avx512:
+                return &SwapAvx512<Size>;
+            case cpu::InstructionSet::Avx2:
+                return &SwapAvx2<Size>;
+            case cpu::InstructionSet::Sse2:
+                return &SwapSse2<Size>;
+            default:
+                break;
+            }
+#endif
+            return &SwapScalar<Size>;
+        }
+
+        struct Kernels
+        {
+            Kernel swap1;
+            Kernel swap2;
+            Kernel swap4;
+            Kernel swap8;
+        };
+
+        Kernels SelectKernels(cpu::InstructionSet instructionSet)
+        {
+            return {SelectKernel<1>(instructionSet), SelectKernel<2>(instructionSet), SelectKernel<4>(instructionSet), SelectKernel<8>(instructionSet)};
+        }
+
+        void Swap(const Kernels& kernels, const void* source, void* destination, size_t count, int sampleSize, uint64_t flip)
+        {
+            const uint8_t* in  = (const uint8_t*)source;
+            uint8_t*       out = (uint8_t*)destination;
+
+            switch (sampleSize)
+            {
+            case 1:
+                if ((uint8_t)flip == 0)
+                {
+                    if (in != out)
+                    {
+                        std::memcpy(out, in, count);
+                    }
+                    return;
+                }
+                return kernels.swap1(in, out, count, flip);
+            case 2:
+                return kernels.swap2(in, out, count, flip);
+            case 4:
+                return kernels.swap4(in, out, count, flip);
+            case 8:
+                return kernels.swap8(in, out, count, flip);
+            default:
+                throw std::invalid_argument("acrion::imagetools::SwapBytes: unsupported sample size " + std::to_string(sampleSize));
+            }
+        }
+    }
+
+    void SwapBytes(const void* source, void* destination, size_t count, int sampleSize, uint64_t flip)
+    {
+        static const Kernels kernels = SelectKernels(cpu::Detect());
+        Swap(kernels, source, destination, count, sampleSize, flip);
+    }
+
+    void SwapBytes(const void* source, void* destination, size_t count, int sampleSize, uint64_t flip, cpu::InstructionSet instructionSet)
+    {
+        if (instructionSet > cpu::Detect())
+        {
+            throw std::invalid_argument("acrion::imagetools::SwapBytes: the instruction set is not supported by this CPU");
+        }
+
+        Swap(SelectKernels(instructionSet), source, destination, count, sampleSize, flip);
+    }
+}
+
+// cfitsio is compiled with ACRION_IMAGE_TOOLS_BYTESWAP, which removes its own swap routines from swapproc.c, so that all
+// conversions between FITS byte order and native byte order on its read and write paths use the kernels above.
+extern "C"
+{
+    void ffswap2(short* values, long count)
+    {
+        if (count > 0)
+        {
+            acrion::imagetools::SwapBytes(values, values, (size_t)count, 2);
+        }
+    }
+
+    void ffswap4(int* values, long count)
+    {
+        if (count > 0)
+        {
+            acrion::imagetools::SwapBytes(values, values, (size_t)count, 4);
+        }
+    }
+
+    void ffswap8(double* values, long count)
+    {
+        if (count > 0)
+        {
+            acrion::imagetools::SwapBytes(values, values, (size_t)count, 8);
+        }
+    }
+}
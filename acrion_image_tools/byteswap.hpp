@@ -0,0 +1,45 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace acrion::imagetools
+{
+    // Reverses the byte order of `count` samples of `sampleSize` (1, 2, 4 or 8) bytes, converting between big-endian (as in FITS
+    // files) and little-endian, and XORs each result with the low `sampleSize` bytes of `flip`. Flipping the sign bit converts
+    // between signed integers and unsigned integers with the BZERO convention. `destination` may be `source` for in-place swapping,
+    // but must not overlap it otherwise. Neither needs to be aligned.
+    // The SIMD kernel (SSE2, AVX2 or AVX-512) is selected at runtime via cpu::Detect().
+    void SwapBytes(const void* source, void* destination, size_t count, int sampleSize, uint64_t flip = 0);
+
+    // As above, but with the kernel of the given instruction set instead of the detected one, so that the kernels can be compared
+    // with each other. Throws std::invalid_argument if `instructionSet` is above cpu::Detect().
+    void SwapBytes(const void* source, void* destination, size_t count, int sampleSize, uint64_t flip, cpu::InstructionSet instructionSet);
+}
@@ -37,21 +37,237 @@
 #endif
 #endif
 
+#if defined(unix) || defined(__unix__)  || defined(__unix) || defined(__APPLE__)
+#include <fcntl.h>       /* posix_fadvise, in file_enable_blocks */
+#endif
+
 #define IO_SEEK 0        /* last file I/O operation was a seek */
 #define IO_READ 1        /* last file I/O operation was a read */
 #define IO_WRITE 2       /* last file I/O operation was a write */
 
 static char file_outfile[FLEN_FILENAME];
 
+typedef struct    /* one block of the large block read cache */
+{
+    char *data;
+    LONGLONG start;          /* file offset of data, a multiple of the block size */
+    long length;             /* number of valid bytes, 0 if the block is empty */
+    unsigned long lastuse;
+} fileblock;
+
 typedef struct    /* structure containing disk file structure */ 
 {
     FILE *fileptr;
     LONGLONG currentpos;
     int last_io_op;
+    fileblock *blocks;       /* large block read cache, null if disabled */
+    char *blockmemory;
+    int nblocks;
+    long blocksize;
+    unsigned long usecount;
 } diskdriver;
 
 static diskdriver handleTable[NMAXFILES]; /* allocate diskfile handle tables */
 
+/*
+   acrion image tools: large block read mode for files opened READONLY.
+   Reads smaller than a block are served from a small LRU cache of large,
+   aligned blocks, so that the 2880 byte records that cfitsio requests
+   cost one read() per block instead of one per stdio buffer, and seeks
+   within the cached blocks cost no system call at all. Reads of at least
+   a block go directly to the file. The operating system is told that the
+   file will be read sequentially, which enlarges its readahead.
+*/
+static long file_block_size = 0;   /* 0 disables the large block mode */
+static int file_block_count = 4;
+
+int fits_set_large_block_reads(long blocksize, int nblocks)
+/*
+  Sets the block size in bytes and the number of blocks per file for files
+  that are opened READONLY afterwards. The block size is rounded up to a
+  multiple of 64 KiB; 0 disables the large block mode.
+*/
+{
+    if (blocksize < 0 || nblocks < 1)
+        return(BAD_DIMEN);
+
+    FFLOCK;  /* drivers open files while holding the lock */
+    file_block_size = (blocksize + 65535) / 65536 * 65536;
+    file_block_count = nblocks;
+    FFUNLOCK;
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+int fits_get_large_block_reads(long *blocksize, int *nblocks)
+{
+    FFLOCK;
+    *blocksize = file_block_size;
+    *nblocks = file_block_count;
+    FFUNLOCK;
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+static void file_enable_blocks(int handle)
+/*
+  allocate the block cache of a file that has just been opened READONLY
+*/
+{
+    diskdriver *disk = &handleTable[handle];
+    long blocksize = file_block_size;
+    int nblocks = file_block_count;
+    void *memory = 0;
+    int ii;
+
+    disk->blocks = 0;
+    disk->blockmemory = 0;
+
+    if (blocksize == 0)
+        return;
+
+#if defined(_WIN32)
+    memory = _aligned_malloc((size_t) blocksize * nblocks, 4096);
+#else
+    if (posix_memalign(&memory, 4096, (size_t) blocksize * nblocks) != 0)
+        memory = 0;
+#endif
+
+    disk->blocks = (fileblock *) calloc(nblocks, sizeof(fileblock));
+
+    if (!memory || !disk->blocks)   /* fall back to plain stdio reads */
+    {
+#if defined(_WIN32)
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+        free(disk->blocks);
+        disk->blocks = 0;
+        return;
+    }
+
+    for (ii = 0; ii < nblocks; ii++)
+        disk->blocks[ii].data = (char *) memory + (size_t) ii * blocksize;
+
+    disk->blockmemory = (char *) memory;
+    disk->nblocks = nblocks;
+    disk->blocksize = blocksize;
+    disk->usecount = 0;
+
+    /* all reads go through the blocks, so stdio does not need to buffer */
+    setvbuf(disk->fileptr, NULL, _IONBF, 0);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fileno(disk->fileptr), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+/*--------------------------------------------------------------------------*/
+static void file_free_blocks(int handle)
+{
+    diskdriver *disk = &handleTable[handle];
+
+    if (!disk->blocks)
+        return;
+
+#if defined(_WIN32)
+    _aligned_free(disk->blockmemory);
+#else
+    free(disk->blockmemory);
+#endif
+    free(disk->blocks);
+    disk->blocks = 0;
+    disk->blockmemory = 0;
+}
+/*--------------------------------------------------------------------------*/
+static int file_seek_stream(FILE *diskfile, LONGLONG offset);
+
+static int file_read_past_end(const char *buffer, long nread)
+/*
+  status of a read that reached the end of the file after nread bytes
+*/
+{
+    /* like file_read: some editors will add a single end-of-file character */
+    /* to a file. Ignore it if the character is a zero, 10, or 32 */
+    if (nread == 1 && (*buffer == 0 || *buffer == 10 || *buffer == 32))
+        return(END_OF_FILE);
+
+    return(READ_ERROR);
+}
+
+static int file_read_blocks(int hdl, char *buffer, long nbytes)
+/*
+  read bytes from the current position through the block cache
+*/
+{
+    diskdriver *disk = &handleTable[hdl];
+    LONGLONG pos = disk->currentpos;
+    fileblock *block, *oldest;
+    char *first = buffer;
+    long requested = nbytes;
+    long offset, ncopy, nread;
+    int ii;
+
+    if (nbytes >= disk->blocksize)   /* large reads bypass the cache */
+    {
+        if (file_seek_stream(disk->fileptr, pos))
+            return(SEEK_ERROR);
+
+        nread = (long) fread(buffer, 1, nbytes, disk->fileptr);
+
+        if (nread != nbytes)
+            return(file_read_past_end(buffer, nread));
+
+        return(0);
+    }
+
+    while (nbytes > 0)
+    {
+        block = 0;
+        oldest = disk->blocks;
+
+        for (ii = 0; ii < disk->nblocks; ii++)
+        {
+            if (disk->blocks[ii].length > 0 && pos >= disk->blocks[ii].start &&
+                pos < disk->blocks[ii].start + disk->blocks[ii].length)
+            {
+                block = &disk->blocks[ii];
+                break;
+            }
+
+            if (disk->blocks[ii].lastuse < oldest->lastuse)
+                oldest = &disk->blocks[ii];
+        }
+
+        if (!block)   /* read the aligned block that contains pos */
+        {
+            block = oldest;
+            block->start = pos - pos % disk->blocksize;
+            block->length = 0;
+
+            if (file_seek_stream(disk->fileptr, block->start))
+                return(SEEK_ERROR);
+
+            block->length = (long) fread(block->data, 1, disk->blocksize, disk->fileptr);
+
+            if (pos >= block->start + block->length)   /* beyond the end of the file */
+                return(file_read_past_end(first, requested - nbytes));
+        }
+
+        block->lastuse = ++disk->usecount;
+
+        offset = (long) (pos - block->start);
+        ncopy = block->length - offset;
+        if (ncopy > nbytes)
+            ncopy = nbytes;
+
+        memcpy(buffer, block->data + offset, ncopy);
+        buffer += ncopy;
+        pos += ncopy;
+        nbytes -= ncopy;
+    }
+
+    return(0);
+}
+
 /*--------------------------------------------------------------------------*/
 int file_init(void)
 {
@@ -163,6 +379,10 @@ int file_open(char *filename, int rwmode, int *handle)
     handleTable[*handle].fileptr = diskfile;
     handleTable[*handle].currentpos = 0;
     handleTable[*handle].last_io_op = IO_SEEK;
+    handleTable[*handle].blocks = 0;
+
+    if (!status && rwmode == READONLY)
+        file_enable_blocks(*handle);
 
     return(status);
 }
@@ -583,6 +803,7 @@ printf("ABS = %s\n", absURL);
     handleTable[ii].fileptr = diskfile;
     handleTable[ii].currentpos = 0;
     handleTable[ii].last_io_op = IO_SEEK;
+    handleTable[ii].blocks = 0;
 
     return(0);
 }
@@ -685,6 +906,8 @@ int file_close(int handle)
 */
 {
     
+    file_free_blocks(handle);
+
     if (fclose(handleTable[handle].fileptr) )
         return(FILE_NOT_CLOSED);
 
@@ -728,6 +951,16 @@ int file_seek(int handle, LONGLONG offset)
 /*
   seek to position relative to start of the file
 */
+{
+    /* in large block mode, the file is positioned when a block is read */
+    if (!handleTable[handle].blocks && file_seek_stream(handleTable[handle].fileptr, offset))
+        return(SEEK_ERROR);
+
+    handleTable[handle].currentpos = offset;
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+static int file_seek_stream(FILE *diskfile, LONGLONG offset)
 {
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1400)
@@ -735,22 +968,21 @@ int file_seek(int handle, LONGLONG offset)
      /* Microsoft visual studio C++ */
      /* _fseeki64 supported beginning with version 8.0 */
  
-    if (_fseeki64(handleTable[handle].fileptr, (OFF_T) offset, 0) != 0)
+    if (_fseeki64(diskfile, (OFF_T) offset, 0) != 0)
         return(SEEK_ERROR);
 	
 #elif _FILE_OFFSET_BITS - 0 == 64
 
-    if (fseeko(handleTable[handle].fileptr, (OFF_T) offset, 0) != 0)
+    if (fseeko(diskfile, (OFF_T) offset, 0) != 0)
         return(SEEK_ERROR);
 
 #else
 
-    if (fseek(handleTable[handle].fileptr, (OFF_T) offset, 0) != 0)
+    if (fseek(diskfile, (OFF_T) offset, 0) != 0)
         return(SEEK_ERROR);
 
 #endif
 
-    handleTable[handle].currentpos = offset;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -762,6 +994,17 @@ int file_read(int hdl, void *buffer, long nbytes)
     long nread;
     char *cptr;
 
+    if (handleTable[hdl].blocks)
+    {
+        int status = file_read_blocks(hdl, (char *) buffer, nbytes);
+        if (status)
+            return(status);
+
+        handleTable[hdl].currentpos += nbytes;
+        handleTable[hdl].last_io_op = IO_READ;
+        return(0);
+    }
+
     if (handleTable[hdl].last_io_op == IO_WRITE)
     {
         if (file_seek(hdl, handleTable[hdl].currentpos))
@@ -850,6 +850,9 @@ int CFITS_API fits_get_section_range(char **ptr,long *secmin,long *secmax,long *
    rare cases where it is needed
 */ 
 int CFITS_API ffmbyt(fitsfile *fptr, LONGLONG bytpos, int ignore_err, int *status);
+/* acrion image tools: ffgbyt and ffuptf are public as well, for the FITS checksums of header and data units */
+int CFITS_API ffgbyt(fitsfile *fptr, LONGLONG nbytes, void *buffer, int *status);
+int CFITS_API ffuptf(fitsfile *fptr, int *status);
 /*----------------- write single keywords --------------*/
 int CFITS_API ffpky(fitsfile *fptr, int datatype, const char *keyname, void *value,
           const char *comm, int *status);
@@ -2052,6 +2055,9 @@ int CFITS_API fits_compress_img(fitsfile *infptr, fitsfile *outfptr, int compres
          long *tilesize, int parm1, int parm2, int *status);
 int CFITS_API fits_is_compressed_image(fitsfile *fptr, int *status);
 int CFITS_API fits_is_reentrant(void);
+/* acrion image tools: large block read mode of the disk file driver (drvrfile.c) */
+int CFITS_API fits_set_large_block_reads(long blocksize, int nblocks);
+int CFITS_API fits_get_large_block_reads(long *blocksize, int *nblocks);
 int CFITS_API fits_decompress_img (fitsfile *infptr, fitsfile *outfptr, int *status);
 int CFITS_API fits_img_decompress_header(fitsfile *infptr, fitsfile *outfptr, int *status);
 int CFITS_API fits_img_decompress (fitsfile *infptr, fitsfile *outfptr, int *status);
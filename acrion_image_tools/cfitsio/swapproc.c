@@ -11,6 +11,10 @@
 #include <stdlib.h>
 #include "fitsio2.h"
 
+/* acrion image tools provides its own ffswap2, ffswap4 and ffswap8 with */
+/* runtime selected SIMD kernels (see byteswap.cpp)                       */
+#ifndef ACRION_IMAGE_TOOLS_BYTESWAP
+
 /* bswap builtin is available since GCC 4.3 */
 #if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3)
 #define HAVE_BSWAP
@@ -245,3 +249,5 @@ void ffswap8(double *dvalues,  /* IO - pointer to doubles to be swapped     */
     ffswap8_slow(dvalues, nvals);
 }
 #endif
+
+#endif /* ACRION_IMAGE_TOOLS_BYTESWAP */
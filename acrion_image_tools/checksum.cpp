@@ -0,0 +1,312 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "checksum.hpp"
+
+#include "cpu.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef ACRION_IMAGE_TOOLS_X86
+    #include <immintrin.h>
+#endif
+
+// The kernels add 32 bit little-endian words into 64 bit accumulators and fold the carries back at the end. Swapping the bytes
+// within the 16 bit halves of a word of the file and rotating the sum by 16 bits yields the sum of its big-endian words, and the
+// native words of 16 bit samples are the big-endian words of the file with their halves exchanged, i.e. rotated by 16 bits, too.
+namespace acrion::imagetools
+{
+    namespace
+    {
+        // words per call of a kernel, so that its 64 bit sums cannot overflow
+        constexpr size_t maxKernelWords = size_t(1) << 30;
+
+        uint32_t Fold(uint64_t sum)
+        {
+            while (sum >> 32)
+            {
+                sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+            }
+
+            return (uint32_t)sum;
+        }
+
+        // multiplies by 2^-bits in ones' complement arithmetic
+        uint32_t RotateRight(uint32_t value, unsigned bits)
+        {
+            bits &= 31;
+            return bits ? (value >> bits) | (value << (32 - bits)) : value;
+        }
+
+        uint32_t SwapWithinHalves(uint32_t word)
+        {
+            return ((word & 0x00FF00FF) << 8) | ((word >> 8) & 0x00FF00FF);
+        }
+
+        template <bool Swap>
+        uint64_t SumScalar(const uint8_t* data, size_t words, uint64_t flip)
+        {
+            uint64_t sum = 0;
+
+            for (size_t i = 0; i < words; ++i)
+            {
+                uint32_t word;
+                std::memcpy(&word, data + i * 4, 4);
+                word ^= (uint32_t)(i % 2 ? flip >> 32 : flip);
+                sum += Swap ? SwapWithinHalves(word) : word;
+            }
+
+            return sum;
+        }
+
+#ifdef ACRION_IMAGE_TOOLS_X86
+        template <bool Swap>
+        ACRION_IMAGE_TOOLS_TARGET("sse2")
+        uint64_t SumSse2(const uint8_t* data, size_t words, uint64_t flip)
+        {
+            const __m128i flips = _mm_set1_epi64x((long long)flip);
+            const __m128i zero  = _mm_setzero_si128();
+            __m128i       sum   = zero;
+            size_t        i     = 0;
+
+            for (; i + 4 <= words; i += 4)
+            {
+                __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i * 4)), flips);
+
+                if constexpr (Swap)
+                {
+                    v = _mm_or_si128(_mm_srli_epi16(v, 8), _mm_slli_epi16(v, 8));
+                }
+
+                sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(v, zero));
+                sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(v, zero));
+            }
+
+            alignas(16) uint64_t lanes[2];
+            _mm_store_si128((__m128i*)lanes, sum);
+
+            return lanes[0] + lanes[1] + SumScalar<Swap>(data + i * 4, words - i, flip);
+        }
+
+        template <bool Swap>
+        ACRION_IMAGE_TOOLS_TARGET("avx2")
+        uint64_t SumAvx2(const uint8_t* data, size_t words, uint64_t flip)
+        {
+            const __m256i flips = _mm256_set1_epi64x((long long)flip);
+            const __m256i zero  = _mm256_setzero_si256();
+            __m256i       a     = zero;
+            __m256i       b     = zero;
+            size_t        i     = 0;
+
+            // two vectors per iteration with separate accumulators, so that the additions of both can overlap
+            for (; i + 16 <= words; i += 16)
+            {
+                __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i * 4)), flips);
+                __m256i w = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i * 4 + 32)), flips);
+
+                if constexpr (Swap)
+                {
+                    v = _mm256_or_si256(_mm256_srli_epi16(v, 8), _mm256_slli_epi16(v, 8));
+                    w = _mm256_or_si256(_mm256_srli_epi16(w, 8), _mm256_slli_epi16(w, 8));
+                }
+
+                a = _mm256_add_epi64(a, _mm256_unpacklo_epi32(v, zero));
+                b = _mm256_add_epi64(b, _mm256_unpackhi_epi32(v, zero));
+                a = _mm256_add_epi64(a, _mm256_unpacklo_epi32(w, zero));
+                b = _mm256_add_epi64(b, _mm256_unpackhi_epi32(w, zero));
+            }
+
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(a, b));
+
+            // the SSE2 kernel starts with the flip of an even word, like this one
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumSse2<Swap>(data + i * 4, words - i, flip);
+        }
+#endif
+
+        using Kernel = uint64_t (*)(const uint8_t*, size_t, uint64_t);
+
+        template <bool Swap>
+        Kernel SelectKernel()
+        {
+#ifdef ACRION_IMAGE_TOOLS_X86
+            switch (cpu::Detect())
+            {
+            case cpu::InstructionSet::Avx512: // memory bound, so wider vectors do not pay off
+            case cpu::InstructionSet::Avx2:
+                return &SumAvx2<Swap>;
+            case cpu::InstructionSet::Sse2:
+                return &SumSse2<Swap>;
+            default:
+                break;
+            }
+#endif
+            return &SumScalar<Swap>;
+        }
+
+        // Returns the folded sum of the little-endian words of `size` bytes XORed with `flip`, which repeats every 8 bytes, with the
+        // bytes within each half of a word swapped if `Swap`. A last partial word is filled up with zeros, which are not flipped.
+        template <bool Swap>
+        uint32_t SumWords(const uint8_t* data, size_t size, uint64_t flip)
+        {
+            static const Kernel kernel = SelectKernel<Swap>();
+
+            const size_t words = size / 4;
+            uint32_t     sum   = 0;
+
+            for (size_t first = 0; first < words; first += maxKernelWords)
+            {
+                sum = AddFitsChecksums(sum, Fold(kernel(data + first * 4, std::min(maxKernelWords, words - first), flip)));
+            }
+
+            if (size % 4)
+            {
+                uint32_t word = 0;
+                std::memcpy(&word, data + words * 4, size % 4);
+                word ^= (uint32_t)(words % 2 ? flip >> 32 : flip) & (0xFFFFFFFFu >> (32 - 8 * (size % 4)));
+                sum = AddFitsChecksums(sum, Swap ? SwapWithinHalves(word) : word);
+            }
+
+            return sum;
+        }
+    }
+
+    uint32_t AddFitsChecksums(uint32_t a, uint32_t b)
+    {
+        return Fold((uint64_t)a + b);
+    }
+
+    uint32_t FitsChecksum(const void* data, size_t size, size_t offset, uint32_t sum)
+    {
+        return AddFitsChecksums(sum, RotateRight(RotateRight(SumWords<true>((const uint8_t*)data, size, 0), 16), 8 * (offset % 4)));
+    }
+
+    uint32_t FitsSampleChecksum(const void* samples, size_t count, int sampleSize, uint64_t flip, size_t offset, uint32_t sum)
+    {
+        const uint8_t* data = (const uint8_t*)samples;
+        uint32_t       result;
+
+        switch (sampleSize)
+        {
+        case 1:
+            // bytes are stored as they are
+            result = RotateRight(SumWords<true>(data, count, 0x0101010101010101 * (uint8_t)flip), 16);
+            break;
+        case 2:
+            result = RotateRight(SumWords<false>(data, count * 2, 0x0001000100010001 * (uint16_t)flip), 16);
+            break;
+        case 4:
+            result = SumWords<false>(data, count * 4, 0x0000000100000001 * (uint32_t)flip);
+            break;
+        case 8:
+            // the two words of a sample are exchanged, which does not change their sum
+            result = SumWords<false>(data, count * 8, flip);
+            break;
+        default:
+            throw std::invalid_argument("acrion::imagetools::FitsSampleChecksum: unsupported sample size " + std::to_string(sampleSize));
+        }
+
+        return AddFitsChecksums(sum, RotateRight(result, 8 * (offset % 4)));
+    }
+
+    uint32_t ParallelFitsChecksum(const void* data, size_t size, size_t offset)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        std::mutex     mutex;
+        uint32_t       sum   = FitsChecksum(bytes + size / 4 * 4, size % 4, offset);
+
+        parallel::ForEachBand(size / 4,
+                              4,
+                              [&](size_t firstWord, size_t wordCount)
+                              {
+                                  const uint32_t bandSum = FitsChecksum(bytes + firstWord * 4, wordCount * 4, offset);
+
+                                  std::lock_guard<std::mutex> lock(mutex);
+                                  sum = AddFitsChecksums(sum, bandSum);
+                              });
+
+        return sum;
+    }
+
+    std::string EncodeFitsChecksum(uint32_t sum)
+    {
+        // each byte of the complement is spread over four characters, starting from '0', and characters that are not alphanumeric
+        // are moved into the alphanumeric range in pairs, which keeps the sum of the pair
+        static constexpr uint8_t excluded[] = {0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, 0x40, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f, 0x60};
+
+        const uint32_t value = ~sum;
+        char           ascii[16];
+
+        for (int byteIndex = 0; byteIndex < 4; ++byteIndex)
+        {
+            const int byte = (value >> (24 - 8 * byteIndex)) & 0xFF;
+            int       characters[4];
+
+            for (int& character : characters)
+            {
+                character = byte / 4 + '0';
+            }
+
+            characters[0] += byte % 4;
+
+            for (bool bChanged = true; bChanged;)
+            {
+                bChanged = false;
+
+                for (uint8_t exclude : excluded)
+                {
+                    for (int pair = 0; pair < 4; pair += 2)
+                    {
+                        if (characters[pair] == exclude || characters[pair + 1] == exclude)
+                        {
+                            ++characters[pair];
+                            --characters[pair + 1];
+                            bChanged = true;
+                        }
+                    }
+                }
+            }
+
+            for (int i = 0; i < 4; ++i)
+            {
+                ascii[4 * i + byteIndex] = (char)characters[i];
+            }
+        }
+
+        // the characters are rotated right by one, so that they line up with the words of the header when the value starts at column 12
+        std::string result(16, ' ');
+
+        for (int i = 0; i < 16; ++i)
+        {
+            result[i] = ascii[(i + 15) % 16];
+        }
+
+        return result;
+    }
+}
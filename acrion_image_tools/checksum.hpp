@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Checksums of the FITS checksum convention (FITS standard, appendix J): DATASUM holds the 32 bit ones' complement sum of the
+// big-endian words of the data unit of an HDU, and CHECKSUM an encoding of the complement of the sum of header and data, so that
+// an intact HDU sums to (negative) zero.
+namespace acrion::imagetools
+{
+    // Adds the checksum of `size` bytes of a FITS file that start `offset` bytes after the start of an HDU (only offset % 4 matters)
+    // to `sum`. Missing bytes of a last partial word count as zero, so pieces of an HDU can be summed separately and in any order.
+    // Single threaded; the SIMD kernel is selected at runtime via cpu::Detect().
+    uint32_t FitsChecksum(const void* data, size_t size, size_t offset = 0, uint32_t sum = 0);
+
+    // Like FitsChecksum, for `count` native samples of `sampleSize` bytes as they are stored after XORing them with `flip` (see
+    // SwapBytes) and converting them to big-endian, without converting them.
+    uint32_t FitsSampleChecksum(const void* samples, size_t count, int sampleSize, uint64_t flip = 0, size_t offset = 0, uint32_t sum = 0);
+
+    // FitsChecksum of a large buffer, summed in bands on several threads (see parallel::ThreadsFor).
+    uint32_t ParallelFitsChecksum(const void* data, size_t size, size_t offset = 0);
+
+    uint32_t AddFitsChecksums(uint32_t a, uint32_t b);
+
+    // Returns the value of the CHECKSUM keyword (16 characters) for an HDU with the checksum `sum`, which must have been computed
+    // with '0000000000000000' as the value of CHECKSUM.
+    std::string EncodeFitsChecksum(uint32_t sum);
+}
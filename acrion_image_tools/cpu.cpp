@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "cpu.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <immintrin.h>
+    #include <intrin.h>
+#endif
+
+namespace acrion::imagetools::cpu
+{
+    namespace
+    {
+        InstructionSet DetectUncached()
+        {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            {
+                return InstructionSet::Avx512;
+            }
+
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return InstructionSet::Avx2;
+            }
+
+            if (__builtin_cpu_supports("sse2"))
+            {
+                return InstructionSet::Sse2;
+            }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+            int info[4];
+            __cpuid(info, 0);
+            const int maxLeaf = info[0];
+
+            __cpuid(info, 1);
+            const bool sse2    = (info[3] & (1 << 26)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx     = (info[2] & (1 << 28)) != 0;
+
+            bool avx2   = false;
+            bool avx512 = false;
+
+            if (osxsave && avx && maxLeaf >= 7)
+            {
+                const unsigned long long xcr0 = _xgetbv(0);
+                __cpuidex(info, 7, 0);
+
+                // The OS must save the YMM (bits 1, 2) and for AVX-512 additionally the opmask and ZMM state (bits 5 to 7)
+                avx2   = (xcr0 & 0x06) == 0x06 && (info[1] & (1 << 5)) != 0;
+                avx512 = (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+            }
+
+            if (avx512)
+            {
+                return InstructionSet::Avx512;
+            }
+
+            if (avx2)
+            {
+                return InstructionSet::Avx2;
+            }
+
+            if (sse2)
+            {
+                return InstructionSet::Sse2;
+            }
+#endif
+            return InstructionSet::Scalar;
+        }
+    }
+
+    InstructionSet Detect()
+    {
+        static const InstructionSet instructionSet = DetectUncached();
+        return instructionSet;
+    }
+}
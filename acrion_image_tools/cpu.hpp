@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define ACRION_IMAGE_TOOLS_X86              1
+    #define ACRION_IMAGE_TOOLS_TARGET(features) __attribute__((target(features)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define ACRION_IMAGE_TOOLS_X86 1
+    #define ACRION_IMAGE_TOOLS_TARGET(features) // MSVC accepts all intrinsics without per-function target flags
+#endif
+
+namespace acrion::imagetools::cpu
+{
+    /// Instruction set levels the SIMD kernels of this library are compiled for, in ascending order.
+    enum class InstructionSet
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+        Avx512 ///< AVX-512 F and BW
+    };
+
+    /// Returns the highest instruction set supported by both the CPU and the operating system. The result is determined once and cached.
+    InstructionSet Detect();
+}
@@ -0,0 +1,311 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "display_range.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace acrion::imagetools
+{
+    namespace
+    {
+        std::mutex              optionsMutex;
+        io::DisplayRangeOptions displayRangeOptions;
+
+        // parameters of IRAF's zscale, as in its original implementation
+        constexpr double zscaleRejection    = 2.5;  // rejection threshold of the line fit, in standard deviations
+        constexpr int    zscaleIterations   = 5;    // maximum number of fit and rejection rounds
+        constexpr double zscaleMaxRejected  = 0.5;  // the fit is discarded if more than this fraction of the samples is rejected
+        constexpr size_t zscaleMinSamples   = 5;
+        constexpr double zscaleGrowFraction = 0.01; // rejected samples also reject this fraction of the samples around them
+
+        // Minimum and maximum of all finite samples
+        template <typename T>
+        std::pair<double, double> ExactRange(const T* data, size_t width, size_t height, size_t channels)
+        {
+            std::mutex mutex;
+            double     min = std::numeric_limits<double>::max();
+            double     max = std::numeric_limits<double>::lowest();
+
+            parallel::ForEachBand(height,
+                                  width * channels * sizeof(T),
+                                  [&](size_t firstRow, size_t rowCount)
+                                  {
+                                      T bandMin = std::numeric_limits<T>::max();
+                                      T bandMax = std::numeric_limits<T>::lowest();
+
+                                      for (const T* value = data + firstRow * width * channels; value < data + (firstRow + rowCount) * width * channels; ++value)
+                                      {
+                                          if constexpr (std::is_floating_point_v<T>)
+                                          {
+                                              if (!std::isfinite(*value))
+                                              {
+                                                  continue;
+                                              }
+                                          }
+
+                                          bandMin = std::min(bandMin, *value);
+                                          bandMax = std::max(bandMax, *value);
+                                      }
+
+                                      std::lock_guard<std::mutex> lock(mutex);
+                                      min = std::min(min, (double)bandMin);
+                                      max = std::max(max, (double)bandMax);
+                                  });
+
+            return min <= max ? std::make_pair(min, max) : std::make_pair(0.0, 0.0);
+        }
+
+        // Returns the finite samples of all channels of up to `samples` pixels on a regular grid, in a deterministic order
+        template <typename T>
+        std::vector<double> SamplePixels(const T* data, size_t width, size_t height, size_t channels, size_t samples)
+        {
+            const size_t step        = std::max<size_t>(1, (size_t)std::ceil(std::sqrt((double)width * height / std::max<size_t>(1, samples))));
+            const size_t firstRow    = std::min(step / 2, height - 1);
+            const size_t firstColumn = std::min(step / 2, width - 1);
+            const size_t rows        = (height - firstRow + step - 1) / step;
+            const size_t columns     = (width - firstColumn + step - 1) / step;
+
+            std::vector<double> values(rows * columns * channels);
+
+            parallel::ForEachBand(rows,
+                                  columns * channels * sizeof(double),
+                                  [&](size_t firstSampleRow, size_t sampleRowCount)
+                                  {
+                                      double* out = values.data() + firstSampleRow * columns * channels;
+
+                                      for (size_t row = firstSampleRow; row < firstSampleRow + sampleRowCount; ++row)
+                                      {
+                                          const T* in = data + (firstRow + row * step) * width * channels;
+
+                                          for (size_t column = firstColumn; column < width; column += step)
+                                          {
+                                              for (size_t channel = 0; channel < channels; ++channel)
+                                              {
+                                                  *out++ = (double)in[column * channels + channel];
+                                              }
+                                          }
+                                      }
+                                  });
+
+            values.erase(std::remove_if(values.begin(), values.end(), [](double value) { return !std::isfinite(value); }), values.end());
+            return values;
+        }
+
+        double Percentile(std::vector<double>& values, double percent)
+        {
+            const auto nth = values.begin() + (ptrdiff_t)std::llround(std::clamp(percent, 0.0, 100.0) / 100.0 * (double)(values.size() - 1));
+            std::nth_element(values.begin(), nth, values.end());
+            return *nth;
+        }
+
+        // IRAF's zscale: fits a straight line to the sorted samples, rejecting outliers iteratively, and derives the range from
+        // the slope of the line around the median, so that the range covers the bulk of the pixels with the given contrast.
+        std::pair<double, double> ZScale(std::vector<double>& values, double contrast)
+        {
+            std::sort(values.begin(), values.end());
+
+            const size_t count   = values.size();
+            const size_t center  = (count - 1) / 2;
+            const double median  = count % 2 ? values[center] : 0.5 * (values[center] + values[center + 1]);
+            const size_t minGood = std::max(zscaleMinSamples, (size_t)(count * zscaleMaxRejected));
+            const size_t grow    = std::max<size_t>(1, (size_t)(count * zscaleGrowFraction));
+
+            std::vector<bool> rejected(count);
+            size_t            good     = count;
+            size_t            lastGood = count + 1;
+            double            slope    = 0.0;
+
+            for (int iteration = 0; iteration < zscaleIterations && good < lastGood && good >= minGood; ++iteration)
+            {
+                // least squares fit of values[i] = intercept + slope * i over the samples that are not rejected
+                double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (!rejected[i])
+                    {
+                        sumX  += (double)i;
+                        sumY  += values[i];
+                        sumXX += (double)i * i;
+                        sumXY += (double)i * values[i];
+                    }
+                }
+
+                const double denominator = good * sumXX - sumX * sumX;
+                slope                    = denominator != 0.0 ? (good * sumXY - sumX * sumY) / denominator : 0.0;
+                const double intercept   = (sumY - slope * sumX) / good;
+
+                double sumResidual = 0, sumSquaredResidual = 0;
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (!rejected[i])
+                    {
+                        const double residual = values[i] - (intercept + slope * i);
+                        sumResidual        += residual;
+                        sumSquaredResidual += residual * residual;
+                    }
+                }
+
+                const double mean      = sumResidual / good;
+                const double threshold = zscaleRejection * std::sqrt(std::max(0.0, sumSquaredResidual / good - mean * mean));
+
+                // reject the outliers and their neighbours
+                std::vector<bool> grown(rejected);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (std::abs(values[i] - (intercept + slope * i)) > threshold)
+                    {
+                        std::fill(grown.begin() + (ptrdiff_t)(i >= (grow - 1) / 2 ? i - (grow - 1) / 2 : 0), grown.begin() + (ptrdiff_t)std::min(count, i + grow / 2 + 1), true);
+                    }
+                }
+
+                rejected = std::move(grown);
+                lastGood = good;
+                good     = (size_t)std::count(rejected.begin(), rejected.end(), false);
+            }
+
+            if (good < minGood)
+            {
+                return {values.front(), values.back()};
+            }
+
+            slope /= contrast;
+
+            return {std::max(values.front(), median - (double)center * slope), std::min(values.back(), median + (double)(count - center - 1) * slope)};
+        }
+
+        template <typename T>
+        std::pair<double, double> ComputeRange(const T* data, size_t width, size_t height, size_t channels, const io::DisplayRangeOptions& options)
+        {
+            if (width == 0 || height == 0 || channels == 0)
+            {
+                return {0.0, 0.0};
+            }
+
+            if (options.mode == io::DisplayRangeMode::Exact)
+            {
+                return ExactRange(data, width, height, channels);
+            }
+
+            std::vector<double> values = SamplePixels(data, width, height, channels, options.samples);
+
+            if (values.empty())
+            {
+                return {0.0, 0.0};
+            }
+
+            if (options.mode == io::DisplayRangeMode::ZScale)
+            {
+                return ZScale(values, options.contrast);
+            }
+
+            const double low = Percentile(values, options.lowPercentile);
+            return {low, Percentile(values, options.highPercentile)};
+        }
+    }
+
+    std::pair<double, double> ComputeDisplayRange(const double* pixels, size_t width, size_t height, const io::DisplayRangeOptions& options)
+    {
+        return ComputeRange(pixels, width, height, 1, options);
+    }
+
+    void ApplyDisplayRange(acrion::image::Bitmap& bitmap)
+    {
+        const io::DisplayRangeOptions options = io::GetDisplayRangeOptions();
+
+        if (options.mode != io::DisplayRangeMode::Exact)
+        {
+            const auto [min, max] = io::ComputeDisplayRange(bitmap, options);
+            bitmap.SetBrightnessRangeForDisplay(min, max);
+        }
+    }
+
+    namespace io
+    {
+        void SetDisplayRangeOptions(const DisplayRangeOptions& options)
+        {
+            if (options.lowPercentile < 0.0 || options.highPercentile > 100.0 || options.lowPercentile > options.highPercentile)
+            {
+                throw std::runtime_error("acrion::imagetools::io::SetDisplayRangeOptions: invalid percentiles " + std::to_string(options.lowPercentile) + " and "
+                                         + std::to_string(options.highPercentile));
+            }
+
+            if (!(options.contrast > 0.0))
+            {
+                throw std::runtime_error("acrion::imagetools::io::SetDisplayRangeOptions: the contrast must be positive");
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(optionsMutex);
+                displayRangeOptions = options;
+            }
+
+            InvalidateCache();
+        }
+
+        DisplayRangeOptions GetDisplayRangeOptions()
+        {
+            std::lock_guard<std::mutex> lock(optionsMutex);
+            return displayRangeOptions;
+        }
+
+        std::pair<double, double> ComputeDisplayRange(const acrion::image::Bitmap& bitmap, const DisplayRangeOptions& options)
+        {
+            const size_t width    = bitmap.Width();
+            const size_t height   = bitmap.Height();
+            const size_t channels = bitmap.Channels();
+
+            switch (bitmap.Depth())
+            {
+            case 1:
+                return ComputeRange((const uint8_t*)bitmap.Buffer(), width, height, channels, options);
+            case 2:
+                return ComputeRange((const uint16_t*)bitmap.Buffer(), width, height, channels, options);
+            case 4:
+                return ComputeRange((const uint32_t*)bitmap.Buffer(), width, height, channels, options);
+            case 8:
+                return ComputeRange((const uint64_t*)bitmap.Buffer(), width, height, channels, options);
+            case -4:
+                return ComputeRange((const float*)bitmap.Buffer(), width, height, channels, options);
+            case -8:
+                return ComputeRange((const double*)bitmap.Buffer(), width, height, channels, options);
+            default:
+                throw std::runtime_error("acrion::imagetools::io::ComputeDisplayRange: unsupported image depth " + std::to_string(bitmap.Depth()));
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "io.hpp"
+
+#include "acrion/image/bitmap.hpp"
+
+#include <cstddef>
+#include <utility>
+
+namespace acrion::imagetools
+{
+    // Display range of a single channel image of `width` x `height` doubles. Non-finite values (undefined pixels) are ignored.
+    std::pair<double, double> ComputeDisplayRange(const double* pixels, size_t width, size_t height, const io::DisplayRangeOptions& options);
+
+    // Sets the brightness range of a freshly read bitmap for display according to io::GetDisplayRangeOptions(). In Exact mode,
+    // the bitmap keeps the range it already has, i.e. the exact range of FITS images, which the readers compute on the fly.
+    void ApplyDisplayRange(acrion::image::Bitmap& bitmap);
+}
@@ -24,88 +24,1757 @@ along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "fits.hpp"
+#include "byteswap.hpp"
+#include "checksum.hpp"
+#include "display_range.hpp"
+#include "gzip_index.hpp"
+#include "memory_map.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
 
 #include "fitsio.h"
 
-#include <cbeam/container/shared_array.hpp>
-
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace acrion::imagetools
 {
+    namespace
+    {
+        std::mutex fitsMutex;
+
+        // cfitsio built with _REENTRANT protects its global state itself, so that independent files can be accessed concurrently.
+        // Other builds (e.g. with MSVC, which lacks pthreads) are not thread-safe at all, so all accesses are serialized here.
+        std::unique_lock<std::mutex> LockFitsUnlessReentrant()
+        {
+            static const bool bReentrant = fits_is_reentrant() != 0;
+            return bReentrant ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(fitsMutex);
+        }
+
+        constexpr size_t writeBandSize = 16 * 1024 * 1024;
+
+        // bytes that are read at once through cfitsio to verify the checksums of images that are not memory mapped
+        constexpr size_t checksumChunkSize = 16 * 1024 * 1024;
+
+        // see io::SetFitsChecksums
+        std::atomic<bool> writeChecksums{false};
+        std::atomic<bool> verifyChecksums{false};
+
+        // the maximum number of axes that cfitsio's image functions handle
+        constexpr int maxAxes = 9;
+    }
+
     void ThrowFitsError(int status)
     {
         if (status)
         {
-            std::filesystem::path tempFile = std::filesystem::temp_directory_path() / "test";
+            char text[FLEN_STATUS];
+            fits_get_errstatus(status, text);
             fits_report_error(stderr, status);
-            throw std::runtime_error("acrion::imagetools::ReadFits: fits error");
+            throw std::runtime_error("acrion::imagetools: FITS error " + std::to_string(status) + ": " + text);
         }
     }
 
-    acrion::image::BitmapData<double> ReadFits(const std::filesystem::path& filename)
+    // Turns rows stored bottom-up (FITS order) into top-down order by swapping row pairs, and computes the minimum and maximum
+    // value in the same pass. NaN values (undefined pixels) are ignored by the comparisons.
+    template <typename T>
+    void FlipRowsAndGetRange(T* data, size_t width, size_t height, double& min, double& max)
     {
-        fitsfile* fptr;
-        int       status = 0;
+        std::mutex mutex;
+        min = std::numeric_limits<double>::max();
+        max = std::numeric_limits<double>::lowest();
 
-        if (fits_open_file(&fptr, filename.string().c_str(), READONLY, &status))
+        parallel::ForEachBand((height + 1) / 2,
+                              2 * width * sizeof(T),
+                              [&](size_t firstPair, size_t pairCount)
+                              {
+                                  T bandMin = std::numeric_limits<T>::max();
+                                  T bandMax = std::numeric_limits<T>::lowest();
+
+                                  for (size_t pair = firstPair; pair < firstPair + pairCount; ++pair)
+                                  {
+                                      T* top    = data + pair * width;
+                                      T* bottom = data + (height - 1 - pair) * width;
+
+                                      for (size_t column = 0; column < width; ++column)
+                                      {
+                                          const T a = top[column];
+                                          const T b = bottom[column];
+                                          bandMin   = std::min(bandMin, std::min(a, b));
+                                          bandMax   = std::max(bandMax, std::max(a, b));
+                                          top[column]    = b;
+                                          bottom[column] = a;
+                                      }
+                                  }
+
+                                  std::lock_guard<std::mutex> lock(mutex);
+                                  min = std::min(min, (double)bandMin);
+                                  max = std::max(max, (double)bandMax);
+                              });
+    }
+
+    // cfitsio datatype code of the given sample type
+    template <typename T>
+    constexpr int FitsDatatype()
+    {
+        if constexpr (std::is_same_v<T, uint8_t>) return TBYTE;
+        else if constexpr (std::is_same_v<T, int8_t>) return TSBYTE;
+        else if constexpr (std::is_same_v<T, uint16_t>) return TUSHORT;
+        else if constexpr (std::is_same_v<T, int16_t>) return TSHORT;
+        else if constexpr (std::is_same_v<T, uint32_t>) return TUINT;
+        else if constexpr (std::is_same_v<T, int32_t>) return TINT;
+        else if constexpr (std::is_same_v<T, uint64_t>) return TULONGLONG;
+        else if constexpr (std::is_same_v<T, int64_t>) return TLONGLONG;
+        else if constexpr (std::is_same_v<T, float>) return TFLOAT;
+        else
+        {
+            static_assert(std::is_same_v<T, double>, "unsupported FITS sample type");
+            return TDOUBLE;
+        }
+    }
+
+    // Reads `rows` FITS rows starting at `firstRow` (counted from the bottom, starting at 1) into `pixels` in FITS order, with a single cfitsio call
+    template <typename T>
+    int ReadFitsRows(fitsfile* fptr, const long naxes[maxAxes], long plane, int x, long firstRow, int width, long rows, T* pixels)
+    {
+        int  status = 0;
+        long fpixel[maxAxes];
+        long lpixel[maxAxes];
+        long inc[maxAxes];
+
+        fpixel[0] = x + 1;
+        lpixel[0] = x + width;
+        fpixel[1] = firstRow;
+        lpixel[1] = firstRow + rows - 1;
+
+        // the plane index is split into the coordinates of the third and higher axes
+        for (int axis = 0; axis < maxAxes; ++axis)
+        {
+            if (axis >= 2)
+            {
+                fpixel[axis] = lpixel[axis] = plane % naxes[axis] + 1;
+                plane /= naxes[axis];
+            }
+
+            inc[axis] = 1;
+        }
+
+        // quantized floating point tiles store NaN as ZBLANK, which cfitsio only converts back if a null value is given
+        T     nan    = std::numeric_limits<T>::quiet_NaN();
+        void* nulval = std::is_floating_point_v<T> && fits_is_compressed_image(fptr, &status) ? &nan : nullptr;
+
+        // whole rows are contiguous in the file, so they are read as one sequence of pixels; narrower regions need a subset read
+        if (x == 0 && width == naxes[0])
+        {
+            fits_read_pix(fptr, FitsDatatype<T>(), fpixel, (LONGLONG)width * rows, nulval, pixels, nullptr, &status);
+        }
+        else
+        {
+            fits_read_subset(fptr, FitsDatatype<T>(), fpixel, lpixel, inc, nulval, pixels, nullptr, &status);
+        }
+
+        return status;
+    }
+
+    // Decompresses the rows of a tile-compressed image concurrently. cfitsio decompresses tile by tile and keeps the current tile
+    // in the fitsfile, so each band of whole tile rows is read through a handle of its own. Opening and closing handles modifies
+    // cfitsio's global driver tables, which only a reentrant build of cfitsio protects, so it is serialized here as well.
+    template <typename T>
+    int ReadCompressedFitsRows(fitsfile* fptr, const long naxes[maxAxes], long plane, int x, long firstRow, int width, long rows, T* pixels, std::optional<double> storedOffset)
+    {
+        int  status = 0;
+        int  naxis  = 0;
+        int  hdu    = 0;
+        long tile[maxAxes];
+        char filename[FLEN_FILENAME];
+
+        std::fill(tile, tile + maxAxes, 1L);
+
+        fits_get_hdu_num(fptr, &hdu);
+
+        if (fits_get_img_dim(fptr, &naxis, &status) || fits_get_tile_dim(fptr, std::min(naxis, MAX_COMPRESS_DIM), tile, &status) || fits_file_name(fptr, filename, &status))
+        {
+            return status;
+        }
+
+        const long       tileRows      = std::max(1L, naxis > 1 ? tile[1] : 1L);
+        const long       firstTileRow  = (firstRow - 1) / tileRows;
+        const long       tileRowCount  = (firstRow + rows - 2) / tileRows - firstTileRow + 1;
+        const size_t     bytesPerTiles = (size_t)width * tileRows * sizeof(T);
+        std::mutex       handleMutex;
+        std::atomic<int> firstError{0};
+
+        parallel::ForEachBand(tileRowCount,
+                              bytesPerTiles,
+                              [&](size_t firstBandTileRow, size_t bandTileRows)
+                              {
+                                  const long bandFirstRow = std::max(firstRow, (firstTileRow + (long)firstBandTileRow) * tileRows + 1);
+                                  const long bandEndRow   = std::min(firstRow + rows, (firstTileRow + (long)(firstBandTileRow + bandTileRows)) * tileRows + 1);
+                                  fitsfile*  handle       = fptr; // the first band uses the caller's handle
+                                  int        bandStatus   = 0;
+
+                                  if (firstBandTileRow > 0)
+                                  {
+                                      std::lock_guard<std::mutex> lock(handleMutex);
+
+                                      // read-only opens of the same file get independent handles, see fits_already_open
+                                      if (fits_open_file(&handle, filename, READONLY, &bandStatus) == 0 && fits_movabs_hdu(handle, hdu, nullptr, &bandStatus) == 0 && storedOffset)
+                                      {
+                                          fits_set_bscale(handle, 1.0, *storedOffset, &bandStatus);
+                                      }
+                                  }
+
+                                  if (bandStatus == 0)
+                                  {
+                                      bandStatus = ReadFitsRows(handle, naxes, plane, x, bandFirstRow, width, bandEndRow - bandFirstRow, pixels + (size_t)(bandFirstRow - firstRow) * width);
+                                  }
+
+                                  if (handle != fptr && handle)
+                                  {
+                                      std::lock_guard<std::mutex> lock(handleMutex);
+                                      int                         closeStatus = 0;
+                                      fits_close_file(handle, &closeStatus);
+                                  }
+
+                                  if (bandStatus)
+                                  {
+                                      int expected = 0;
+                                      firstError.compare_exchange_strong(expected, bandStatus);
+                                  }
+                              });
+
+        return firstError;
+    }
+
+    // Reads the given region of the open image into `pixels`, flips it to top-down order and returns the value range.
+    // If `storedOffset` is set, cfitsio's scaling is replaced by adding this offset to the stored values.
+    template <typename T>
+    void ReadFitsPixels(fitsfile* fptr, const long naxes[maxAxes], long plane, int x, int y, int width, int height, T* pixels, double& min, double& max, std::optional<double> storedOffset = std::nullopt)
+    {
+        int        status   = 0;
+        const long firstRow = naxes[1] - (y + height) + 1; // FITS counts rows from the bottom, starting at 1
+        char       compression[FLEN_VALUE] = "";
+
+        if (storedOffset)
+        {
+            fits_set_bscale(fptr, 1.0, *storedOffset, &status);
+        }
+
+        char urlType[FLEN_FILENAME] = "";
+
+        // only files on disk can be opened again for further handles
+        if (fits_is_compressed_image(fptr, &status) && fits_url_type(fptr, urlType, &status) == 0 && std::strcmp(urlType, "file://") == 0)
+        {
+            // fits_get_compression_type returns the setting for writing, so the algorithm is taken from the header
+            fits_read_key_str(fptr, "ZCMPTYPE", compression, nullptr, &status);
+        }
+
+        if (!status)
+        {
+            // fits_hdecompress keeps its state in static variables, which even a reentrant cfitsio only protects by a global lock,
+            // so HCOMPRESS tiles are decompressed one after another
+            status = compression[0] && std::strncmp(compression, "HCOMPRESS", 9) != 0
+                       ? ReadCompressedFitsRows(fptr, naxes, plane, x, firstRow, width, height, pixels, storedOffset)
+                       : ReadFitsRows(fptr, naxes, plane, x, firstRow, width, height, pixels);
+        }
+
+        if (status)
         {
+            fits_close_file(fptr, &status);
             ThrowFitsError(status);
         }
 
-        long   naxes[2] = {1, 1};
-        double min      = std::numeric_limits<double>::max();
-        double max      = std::numeric_limits<double>::lowest();
+        FlipRowsAndGetRange(pixels, width, height, min, max);
+    }
+    template <typename T>
+    acrion::image::Bitmap ReadFitsPixels(fitsfile* fptr, const long naxes[maxAxes], long plane, int x, int y, int width, int height)
+    {
+        acrion::image::BitmapData<T> result(width, height, 1);
+        double                       min, max;
+
+        ReadFitsPixels(fptr, naxes, plane, x, y, width, height, (T*)result.Buffer(), min, max);
+        result.SetBrightnessRangeForDisplay(min, max);
+
+        return result;
+    }
+
+    // Reads signed integer samples and integer samples that are scaled by BSCALE/BZERO without applying the scaling, so that they
+    // keep their stored size. acrion::image::Bitmap has no signed integer types, so signed samples are offset into the range of
+    // the unsigned type of the same size (like the BZERO convention for unsigned integers does), and the offset is folded into the
+    // zero of the returned scaling.
+    template <typename Unsigned>
+    std::shared_ptr<acrion::image::Bitmap> ReadScaledFitsPixels(fitsfile* fptr, const long naxes[maxAxes], long plane, int x, int y, int width, int height, int bitpix, double scale, double zero)
+    {
+        const double offset = bitpix == BYTE_IMG ? 0.0 : std::ldexp(1.0, bitpix - 1); // 2^(bits-1) for signed samples
+
+        acrion::image::BitmapData<Unsigned> result(width, height, 1);
+        double                              min, max;
 
+        ReadFitsPixels(fptr, naxes, plane, x, y, width, height, (Unsigned*)result.Buffer(), min, max, offset);
+        result.SetBrightnessRangeForDisplay(min, max);
+
+        return std::make_shared<io::ScaledBitmap>(result, scale, zero - scale * offset);
+    }
+
+    // Reads BSCALE and BZERO of the current HDU; missing keywords leave the defaults untouched
+    void ReadFitsScaling(fitsfile* fptr, double& scale, double& zero)
+    {
+        int status = 0;
+        fits_read_key_dbl(fptr, "BSCALE", &scale, nullptr, &status);
+        status = 0;
+        fits_read_key_dbl(fptr, "BZERO", &zero, nullptr, &status);
+    }
+
+    // BZERO = 2^(bits-1) (or -128 for bytes) is the FITS convention for integers of the opposite signedness
+    bool IsUnsignedConvention(int bitpix, double zero)
+    {
+        return bitpix > 0 && zero == (bitpix == BYTE_IMG ? -128.0 : std::ldexp(1.0, bitpix - 1));
+    }
+
+    // Reads the given region of the open image, with x and y counted from the top left corner like in the resulting bitmap.
+    // The sample type matches the BITPIX of the file, considering the BZERO convention for unsigned integers. Signed integer
+    // images and integer images that are scaled by BSCALE/BZERO otherwise are returned unscaled as io::ScaledBitmap.
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsPixels(fitsfile* fptr, const long naxes[maxAxes], long plane, int x, int y, int width, int height)
+    {
+        int    status = 0;
+        double scale  = 1.0;
+        double zero   = 0.0;
+        int    bitpix, type;
+
+        if (fits_get_img_type(fptr, &bitpix, &status) || fits_get_img_equivtype(fptr, &type, &status))
         {
-            int bitpix, naxis;
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+        }
+
+        ReadFitsScaling(fptr, scale, zero);
+
+        // BZERO = 2^(bits-1) (or -128 for bytes) only switches between signed and unsigned integers
+        const bool bUnsignedConvention = IsUnsignedConvention(bitpix, zero);
+        const bool bUnsigned           = scale == 1.0 && (bitpix == BYTE_IMG ? zero == 0.0 : bUnsignedConvention);
 
-            if (fits_get_img_param(fptr, 2, &bitpix, &naxis, naxes, &status))
+        // Scaled 64 bit integers are left to cfitsio, because the folded offset of 2^63 would cost precision in double arithmetic.
+        // Unscaled ones are offset exactly, because cfitsio flips the sign bit for an offset of 2^63.
+        if (bitpix > 0 && !bUnsigned && (bitpix != LONGLONG_IMG || (scale == 1.0 && zero == 0.0)))
+        {
+            switch (bitpix)
             {
-                fits_close_file(fptr, &status);
-                ThrowFitsError(status);
+            case BYTE_IMG:
+                return ReadScaledFitsPixels<uint8_t>(fptr, naxes, plane, x, y, width, height, bitpix, scale, zero);
+            case SHORT_IMG:
+                return ReadScaledFitsPixels<uint16_t>(fptr, naxes, plane, x, y, width, height, bitpix, scale, zero);
+            case LONG_IMG:
+                return ReadScaledFitsPixels<uint32_t>(fptr, naxes, plane, x, y, width, height, bitpix, scale, zero);
+            default:
+                return ReadScaledFitsPixels<uint64_t>(fptr, naxes, plane, x, y, width, height, bitpix, scale, zero);
             }
+        }
+
+        // fits_get_img_equivtype only recognizes the unsigned convention for up to 32 bits
+        if (bitpix == LONGLONG_IMG && scale == 1.0 && bUnsignedConvention)
+        {
+            type = ULONGLONG_IMG;
+        }
+
+        switch (type)
+        {
+        case BYTE_IMG:
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPixels<uint8_t>(fptr, naxes, plane, x, y, width, height));
+        case USHORT_IMG:
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPixels<uint16_t>(fptr, naxes, plane, x, y, width, height));
+        case ULONG_IMG:
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPixels<uint32_t>(fptr, naxes, plane, x, y, width, height));
+        case ULONGLONG_IMG:
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPixels<uint64_t>(fptr, naxes, plane, x, y, width, height));
+        case FLOAT_IMG:
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPixels<float>(fptr, naxes, plane, x, y, width, height));
+        default:
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPixels<double>(fptr, naxes, plane, x, y, width, height));
+        }
+    }
+
+    // Moves to the first HDU that contains an image, because multi-extension files often have an empty primary HDU, and reads
+    // the dimensions of the image. Unused axes are set to 1. Returns BITPIX, or closes the file and throws if there is no image.
+    int SelectFitsImage(fitsfile* fptr, long naxes[maxAxes])
+    {
+        int status = 0;
+        int bitpix = 0;
+        int naxis  = 0;
+        int hduType;
+
+        std::fill(naxes, naxes + maxAxes, 1L);
 
-            if (naxis > 2 || naxis == 0)
+        do
+        {
+            if (fits_get_hdu_type(fptr, &hduType, &status) == 0 && hduType == IMAGE_HDU)
             {
-                throw std::runtime_error("acrion::imagetools::ReadFits: only 1D or 2D images are supported");
+                fits_get_img_param(fptr, maxAxes, &bitpix, &naxis, naxes, &status);
             }
+        } while (!status && naxis == 0 && fits_movrel_hdu(fptr, 1, nullptr, &status) == 0);
+
+        if (status == END_OF_FILE)
+        {
+            status = 0;
+            fits_close_file(fptr, &status);
+            throw std::runtime_error("acrion::imagetools::ReadFits: the file does not contain an image");
+        }
+
+        if (status)
+        {
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+        }
+
+        return bitpix;
+    }
+
+    // cfitsio uncompresses gzip-compressed files completely into memory when opening them. Reads of a region or a single plane
+    // pass randomAccess, so that local .gz files are read through a checkpoint index instead, which is built once and saved next
+    // to the file, and only the compressed blocks that contain the requested rows are inflated.
+    std::string GetFitsUrl(const std::filesystem::path& filename, bool randomAccess)
+    {
+        return randomAccess && IsIndexableGzip(filename) ? GetIndexedGzipUrl(filename) : filename.string();
+    }
+
+    fitsfile* OpenFitsImage(const std::filesystem::path& filename, long naxes[maxAxes], bool randomAccess = false)
+    {
+        fitsfile* fptr;
+        int       status = 0;
+
+        if (fits_open_file(&fptr, GetFitsUrl(filename, randomAccess).c_str(), READONLY, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        SelectFitsImage(fptr, naxes);
+
+        return fptr;
+    }
+
+    long long GetPlaneCount(const long naxes[maxAxes])
+    {
+        long long planes = 1;
+
+        for (int axis = 2; axis < maxAxes; ++axis)
+        {
+            planes *= naxes[axis];
         }
 
-        const int width  = (int)naxes[0];
-        const int height = (int)naxes[1];
+        return planes;
+    }
+
+    // DATASUM and CHECKSUM of the current HDU, as far as it has them
+    struct FitsChecksumKeywords
+    {
+        std::optional<uint32_t> dataSum;
+        bool                    bChecksum = false;
+
+        bool Any() const { return dataSum || bChecksum; }
+    };
+
+    FitsChecksumKeywords ReadFitsChecksumKeywords(fitsfile* fptr)
+    {
+        FitsChecksumKeywords keywords;
+        char                 value[FLEN_VALUE];
+        int                  status = 0;
 
-        acrion::image::BitmapData<double> result(width, height, 1);
-        auto                              pixels    = cbeam::container::make_shared_array<double>(width);
-        long                              fpixel[2] = {1, 1};
+        // missing keywords are not an error here, so their messages are removed from cfitsio's error stack
+        fits_write_errmark();
 
-        /* loop over all the rows in the image, top to bottom */
-        for (fpixel[1] = height; fpixel[1] >= 1; fpixel[1]--)
+        if (fits_read_key(fptr, TSTRING, "DATASUM", value, nullptr, &status) == 0)
         {
-            if (fits_read_pix(fptr, TDOUBLE, fpixel, naxes[0], nullptr, pixels.get(), nullptr, &status)) /* read row of pixels */
+            char*                    end;
+            const unsigned long long sum = std::strtoull(value, &end, 10);
+
+            if (end != value && sum <= 0xFFFFFFFF)
             {
-                fits_close_file(fptr, &status);
-                ThrowFitsError(status);
+                keywords.dataSum = (uint32_t)sum;
             }
+        }
 
-            const int row = (int)fpixel[1] - 1;
+        status             = 0;
+        keywords.bChecksum = fits_read_key(fptr, TSTRING, "CHECKSUM", value, nullptr, &status) == 0;
 
-            for (int column = 0; column < width; ++column)
+        fits_clear_errmark();
+
+        return keywords;
+    }
+
+    // Returns why the sums of header and data of an HDU do not match its keywords, or an empty string if they do.
+    std::string FitsChecksumMismatch(const FitsChecksumKeywords& keywords, uint32_t headerSum, uint32_t dataSum)
+    {
+        // 0 and 0xFFFFFFFF are both zero in ones' complement arithmetic
+        const auto normalized = [](uint32_t sum) { return sum == 0xFFFFFFFF ? 0u : sum; };
+
+        if (keywords.dataSum && normalized(*keywords.dataSum) != normalized(dataSum))
+        {
+            return "the data do not match DATASUM " + std::to_string(*keywords.dataSum) + " (their sum is " + std::to_string(dataSum) + ")";
+        }
+
+        if (keywords.bChecksum && normalized(AddFitsChecksums(headerSum, dataSum)) != 0)
+        {
+            return "the header or the data do not match CHECKSUM";
+        }
+
+        return std::string();
+    }
+
+    // Returns the checksum of the bytes from `begin` to `end` of the file, read through cfitsio in chunks that are summed on several threads.
+    uint32_t ReadFitsChecksum(fitsfile* fptr, long long begin, long long end, int& status)
+    {
+        std::vector<uint8_t> chunk((size_t)std::clamp<long long>(end - begin, 0, checksumChunkSize));
+        uint32_t             sum = 0;
+
+        ffmbyt(fptr, begin, 0, &status); // 0 reports the end of the file as an error (REPORT_EOF in cfitsio's internal header)
+
+        for (long long position = begin; position < end && !status; position += (long long)chunk.size())
+        {
+            const size_t bytes = (size_t)std::min<long long>(end - position, (long long)chunk.size());
+
+            if (ffgbyt(fptr, (LONGLONG)bytes, chunk.data(), &status) == 0)
             {
-                const double value = pixels.get()[column];
-                max                = std::max(max, value);
-                min                = std::min(min, value);
-                result.Plot(column, row, value);
+                sum = AddFitsChecksums(sum, ParallelFitsChecksum(chunk.data(), bytes, (size_t)position));
             }
         }
-        fits_close_file(fptr, &status);
 
+        return sum;
+    }
+
+    // Verifies DATASUM and CHECKSUM of the current HDU, if it has them, by reading the HDU through cfitsio. This is for images that
+    // are not memory mapped, i.e. compressed images, whose data unit is small, and files that cfitsio holds in memory.
+    // Returns the mismatch like FitsChecksumMismatch.
+    std::string VerifyFitsChecksums(fitsfile* fptr)
+    {
+        const FitsChecksumKeywords keywords = ReadFitsChecksumKeywords(fptr);
+        int                        status   = 0;
+        long long                  headStart, dataStart, dataEnd;
+
+        if (!keywords.Any() || fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status))
+        {
+            return std::string();
+        }
+
+        const uint32_t headerSum = ReadFitsChecksum(fptr, headStart, dataStart, status);
+        const uint32_t dataSum   = ReadFitsChecksum(fptr, dataStart, dataEnd, status);
+
+        return status ? "the HDU cannot be read to verify its checksums" : FitsChecksumMismatch(keywords, headerSum, dataSum);
+    }
+
+    // Sum of the bytes of a plane in the file, which the conversion of a memory mapped plane computes on the way to verify DATASUM
+    struct PlaneChecksum
+    {
+        size_t   position; // of the plane in the file
+        uint32_t sum = 0;
+    };
+
+    // Reduction of the resolution of a plane while it is converted, see io::ReadReduced
+    struct PlaneReduction
+    {
+        size_t        factor    = 1;
+        io::Reduction reduction = io::Reduction::Bin;
+    };
+
+    // Converts the big-endian samples of a plane, as stored in the file, into native samples in top-down row order and returns
+    // their value range, all in a single pass. `flip` is XORed into the bits of each sample (see SwapBytes), which moves signed
+    // integers into the range of the unsigned type of the same size and vice versa. A `reduction` divides the width and height of
+    // `pixels`: binned rows are swapped into a buffer in the L1 cache and summed from there, decimated samples are picked from
+    // the file before they are swapped. The checksum is only taken of planes that are not reduced.
+    template <typename T>
+    void ConvertMappedFitsPlane(const uint8_t* source, size_t width, size_t height, const PlaneReduction& reduction, T* pixels, uint64_t flip, double& min, double& max, PlaneChecksum* checksum)
+    {
+        const size_t factor    = reduction.factor;
+        const bool   bBin      = factor > 1 && reduction.reduction == io::Reduction::Bin;
+        const size_t rowBytes  = width * sizeof(T);
+        const size_t outWidth  = width / factor;
+        const size_t outHeight = height / factor;
+        std::mutex   mutex;
+        min = std::numeric_limits<double>::max();
+        max = std::numeric_limits<double>::lowest();
+
+        parallel::ForEachBand(outHeight,
+                              rowBytes * (bBin ? factor : 1),
+                              [&](size_t firstRow, size_t rowCount)
+                              {
+                                  T                      bandMin = std::numeric_limits<T>::max();
+                                  T                      bandMax = std::numeric_limits<T>::lowest();
+                                  uint32_t               bandSum = 0;
+                                  std::vector<T>         line(bBin ? outWidth * factor : 0);
+                                  std::vector<BinSum<T>> sums(bBin ? outWidth : 0);
+
+                                  for (size_t row = firstRow; row < firstRow + rowCount; ++row)
+                                  {
+                                      // FITS stores the rows bottom-up, and the blocks of a reduction start at the bottom
+                                      const size_t   rowOffset = (outHeight - 1 - row) * factor * rowBytes;
+                                      const uint8_t* in        = source + rowOffset;
+                                      T*             out       = pixels + row * outWidth;
+
+                                      if (bBin)
+                                      {
+                                          std::fill(sums.begin(), sums.end(), BinSum<T>());
+
+                                          for (size_t i = 0; i < factor; ++i)
+                                          {
+                                              SwapBytes(in + i * rowBytes, line.data(), line.size(), sizeof(T), flip);
+                                              AddBinnedRow(line.data(), outWidth, 1, (int)factor, sums.data());
+                                          }
+
+                                          StoreBinnedRow(sums.data(), outWidth, (int)factor, out);
+                                      }
+                                      else if (factor > 1)
+                                      {
+                                          for (size_t column = 0; column < outWidth; ++column)
+                                          {
+                                              std::memcpy(out + column, in + column * factor * sizeof(T), sizeof(T));
+                                          }
+
+                                          SwapBytes(out, out, outWidth, sizeof(T), flip);
+                                      }
+                                      else
+                                      {
+                                          // the range and the checksum are taken while the row is still in the L1 cache
+                                          SwapBytes(in, out, width, sizeof(T), flip);
+
+                                          if (checksum)
+                                          {
+                                              bandSum = FitsChecksum(in, rowBytes, checksum->position + rowOffset, bandSum);
+                                          }
+                                      }
+
+                                      for (size_t column = 0; column < outWidth; ++column)
+                                      {
+                                          bandMin = std::min(bandMin, out[column]);
+                                          bandMax = std::max(bandMax, out[column]);
+                                      }
+                                  }
+
+                                  std::lock_guard<std::mutex> lock(mutex);
+                                  min = std::min(min, (double)bandMin);
+                                  max = std::max(max, (double)bandMax);
+
+                                  if (checksum)
+                                  {
+                                      checksum->sum = AddFitsChecksums(checksum->sum, bandSum);
+                                  }
+                              });
+    }
+
+    template <typename T>
+    std::shared_ptr<acrion::image::Bitmap> ConvertMappedFitsPlane(const uint8_t* source, int width, int height, const PlaneReduction& reduction, PlaneChecksum* checksum, uint64_t flip = 0)
+    {
+        auto   result = std::make_shared<acrion::image::BitmapData<T>>(width / (int)reduction.factor, height / (int)reduction.factor, 1);
+        double min, max;
+
+        ConvertMappedFitsPlane(source, width, height, reduction, (T*)result->Buffer(), flip, min, max, checksum);
+        result->SetBrightnessRangeForDisplay(min, max);
+
+        return result;
+    }
+
+    // Returns where the data of a plane of the current image HDU starts in the file, if it can be read by mapping the file instead
+    // of through cfitsio's buffers of 2880 byte records: the image must be uncompressed and the file must be a plain file on disk.
+    // Returns -1 otherwise.
+    long long GetMappableFitsPlaneOffset(fitsfile* fptr, const std::filesystem::path& filename, const long naxes[maxAxes], long long plane, int bitpix)
+    {
+        int             status = 0;
+        char            urlType[FLEN_FILENAME];
+        long long       dataStart, dataEnd;
+        std::error_code error;
+
+        // compressed files (e.g. .fits.gz) are uncompressed into memory by cfitsio and have another url type
+        if (fits_is_compressed_image(fptr, &status) || fits_url_type(fptr, urlType, &status) || std::strcmp(urlType, "file://") != 0
+            || !std::filesystem::is_regular_file(filename, error) || fits_get_hduaddrll(fptr, nullptr, &dataStart, &dataEnd, &status))
+        {
+            return -1;
+        }
+
+        const long long planeBytes = (long long)naxes[0] * naxes[1] * (std::abs(bitpix) / 8);
+
+        return dataStart + (plane + 1) * planeBytes <= dataEnd ? dataStart + plane * planeBytes : -1;
+    }
+
+    // Reads a plane of an uncompressed image from the memory mapped file with a single conversion pass, bypassing cfitsio.
+    // The result is the same as from ReadFitsPixels. Returns null without side effects if the image cannot be read this way,
+    // otherwise the file is closed. If `bVerifyChecksums`, the plane is summed while it is converted, and DATASUM and CHECKSUM
+    // are verified if the HDU has them; the rest of the HDU, i.e. the header and the other planes of a cube, is summed separately.
+    // A `reduction` is applied during the conversion; checksums of reduced planes are not verified.
+    std::shared_ptr<acrion::image::Bitmap> ReadMappedFitsPlane(fitsfile* fptr, const std::filesystem::path& filename, const long naxes[maxAxes], long long plane, bool bVerifyChecksums = false, const PlaneReduction& reduction = {})
+    {
+        int    status = 0;
+        int    bitpix = 0;
+        double scale  = 1.0;
+        double zero   = 0.0;
+
+        if (fits_get_img_type(fptr, &bitpix, &status))
+        {
+            return nullptr;
+        }
+
+        const long long offset = GetMappableFitsPlaneOffset(fptr, filename, naxes, plane, bitpix);
+
+        ReadFitsScaling(fptr, scale, zero);
+
+        // like in ReadFitsPixels, signed and scaled integers are returned unscaled as io::ScaledBitmap
+        const bool bUnsigned     = scale == 1.0 && (bitpix == BYTE_IMG ? zero == 0.0 : IsUnsignedConvention(bitpix, zero));
+        const bool bFloatScaled  = bitpix < 0 && (scale != 1.0 || zero != 0.0);
+        const bool bScaled64Bits = bitpix == LONGLONG_IMG && !bUnsigned && (scale != 1.0 || zero != 0.0);
+
+        // scaled floating point and 64 bit integer samples are left to cfitsio, see ReadFitsPixels
+        if (offset < 0 || bFloatScaled || bScaled64Bits)
+        {
+            return nullptr;
+        }
+
+        FitsChecksumKeywords keywords;
+        long long            headStart = 0, dataStart = 0, dataEnd = 0;
+
+        if (bVerifyChecksums && reduction.factor == 1)
+        {
+            keywords = ReadFitsChecksumKeywords(fptr);
+            fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status);
+        }
+
+        fits_close_file(fptr, &status);
         ThrowFitsError(status);
 
-        // TODO read scale and zero from FITS header and make these parameters available in BitmapData
-        result.SetBrightnessRangeForDisplay(min, max);
+        const MemoryMap map(filename);
+        const int       width      = (int)naxes[0];
+        const int       height     = (int)naxes[1];
+        const size_t    planeBytes = (size_t)width * height * (std::abs(bitpix) / 8);
+        const uint8_t*  source     = map.Data() + offset;
+        PlaneChecksum   planeChecksum{(size_t)offset};
+        PlaneChecksum*  checksum   = keywords.Any() ? &planeChecksum : nullptr;
+
+        // decimation skips most rows, which read-ahead would fetch in vain
+        if (reduction.factor == 1 || reduction.reduction == io::Reduction::Bin)
+        {
+            map.WillReadSequentially((size_t)offset, planeBytes);
+        }
+
+        std::shared_ptr<acrion::image::Bitmap> result;
+
+        // like ReadScaledFitsPixels, signed samples are moved into the range of the unsigned type, which the unsigned convention
+        // does as well
+        const double storedOffset = bitpix == BYTE_IMG ? 0.0 : std::ldexp(1.0, bitpix - 1);
+
+        switch (bitpix)
+        {
+        case BYTE_IMG:
+            result = ConvertMappedFitsPlane<uint8_t>(source, width, height, reduction, checksum);
+            break;
+        case SHORT_IMG:
+            result = ConvertMappedFitsPlane<uint16_t>(source, width, height, reduction, checksum, 0x8000);
+            break;
+        case LONG_IMG:
+            result = ConvertMappedFitsPlane<uint32_t>(source, width, height, reduction, checksum, 0x80000000);
+            break;
+        case LONGLONG_IMG:
+            result = ConvertMappedFitsPlane<uint64_t>(source, width, height, reduction, checksum, 0x8000000000000000);
+            break;
+        case FLOAT_IMG:
+            result = ConvertMappedFitsPlane<float>(source, width, height, reduction, checksum);
+            break;
+        default:
+            result = ConvertMappedFitsPlane<double>(source, width, height, reduction, checksum);
+            break;
+        }
+
+        if (bitpix > 0 && !bUnsigned)
+        {
+            result = std::make_shared<io::ScaledBitmap>(*result, scale, zero - scale * storedOffset);
+        }
+
+        if (checksum)
+        {
+            // the fill after the data unit is missing in truncated files, which counts as zeros like the fill itself
+            const size_t planeEnd  = (size_t)offset + planeBytes;
+            const size_t dataBytes = std::min((size_t)dataEnd, map.Size());
+            uint32_t     dataSum   = AddFitsChecksums(planeChecksum.sum, ParallelFitsChecksum(map.Data() + dataStart, (size_t)(offset - dataStart), (size_t)dataStart));
+
+            if (dataBytes > planeEnd)
+            {
+                dataSum = AddFitsChecksums(dataSum, ParallelFitsChecksum(map.Data() + planeEnd, dataBytes - planeEnd, planeEnd));
+            }
+
+            const std::string mismatch = FitsChecksumMismatch(keywords, FitsChecksum(map.Data() + headStart, (size_t)(dataStart - headStart), (size_t)headStart), dataSum);
+
+            if (!mismatch.empty())
+            {
+                throw std::runtime_error("acrion::imagetools::ReadFits: " + filename.string() + ": " + mismatch);
+            }
+        }
 
         return result;
     }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFits(const std::filesystem::path& filename)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        long      naxes[maxAxes];
+        fitsfile* fptr = OpenFitsImage(filename, naxes);
+
+        // the first plane of cubes
+        auto result = ReadMappedFitsPlane(fptr, filename, naxes, 0, verifyChecksums);
+
+        if (!result)
+        {
+            int status = 0;
+            result     = ReadFitsPixels(fptr, naxes, 0, 0, 0, (int)naxes[0], (int)naxes[1]);
+
+            const std::string mismatch = verifyChecksums ? VerifyFitsChecksums(fptr) : std::string();
+
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+
+            if (!mismatch.empty())
+            {
+                throw std::runtime_error("acrion::imagetools::ReadFits: " + filename.string() + ": " + mismatch);
+            }
+        }
+
+        ApplyDisplayRange(*result);
+        return result;
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsFromMemory(const void* data, size_t size)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        // The memory driver reads the caller's buffer in place; in READONLY mode it neither modifies nor reallocates it
+        void*     buffer     = const_cast<void*>(data);
+        size_t    bufferSize = size;
+        fitsfile* fptr;
+        int       status = 0;
+        long      naxes[maxAxes];
+
+        if (fits_open_memfile(&fptr, "memory.fits", READONLY, &buffer, &bufferSize, 0, nullptr, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        SelectFitsImage(fptr, naxes);
+
+        auto result = ReadFitsPixels(fptr, naxes, 0, 0, 0, (int)naxes[0], (int)naxes[1]);
+
+        const std::string mismatch = verifyChecksums ? VerifyFitsChecksums(fptr) : std::string();
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        if (!mismatch.empty())
+        {
+            throw std::runtime_error("acrion::imagetools::ReadFitsFromMemory: " + mismatch);
+        }
+
+        ApplyDisplayRange(*result);
+        return result;
+    }
+
+    bool IsFitsData(const void* data, size_t size)
+    {
+        // Every FITS file starts with the mandatory SIMPLE keyword in the first header card
+        static constexpr char signature[] = "SIMPLE  =";
+        return size >= 2880 && std::memcmp(data, signature, sizeof(signature) - 1) == 0;
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsRegion(const std::filesystem::path& filename, int x, int y, int width, int height)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        long      naxes[maxAxes];
+        fitsfile* fptr   = OpenFitsImage(filename, naxes, true);
+        int       status = 0;
+
+        if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > naxes[0] || y + height > naxes[1])
+        {
+            fits_close_file(fptr, &status);
+            throw std::runtime_error("acrion::imagetools::ReadFitsRegion: region " + std::to_string(width) + "x" + std::to_string(height) + "+" + std::to_string(x) + "+" + std::to_string(y)
+                                     + " exceeds the image size " + std::to_string(naxes[0]) + "x" + std::to_string(naxes[1]));
+        }
+
+        auto result = ReadFitsPixels(fptr, naxes, 0, x, y, width, height);
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        ApplyDisplayRange(*result);
+        return result;
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsReduced(const std::filesystem::path& filename, int factor, io::Reduction reduction)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        long      naxes[maxAxes];
+        fitsfile* fptr   = OpenFitsImage(filename, naxes);
+        int       status = 0;
+
+        if (factor < 1 || factor > naxes[0] || factor > naxes[1])
+        {
+            fits_close_file(fptr, &status);
+            throw std::runtime_error("acrion::imagetools::ReadFitsReduced: invalid factor " + std::to_string(factor) + " for an image of " + std::to_string(naxes[0]) + "x" + std::to_string(naxes[1]) + " pixels");
+        }
+
+        // the first plane of cubes
+        auto result = ReadMappedFitsPlane(fptr, filename, naxes, 0, false, {(size_t)factor, reduction});
+
+        if (!result)
+        {
+            // tile-compressed and gzipped images are decompressed completely anyway
+            result = ReadFitsPixels(fptr, naxes, 0, 0, 0, (int)naxes[0], (int)naxes[1]);
+
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+
+            result = ReduceBitmap(*result, factor, reduction);
+        }
+
+        ApplyDisplayRange(*result);
+        return result;
+    }
+
+    acrion::image::BitmapData<uint8_t> ReadFitsPreview(const std::filesystem::path& filename, int maxEdge)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        long       naxes[maxAxes];
+        fitsfile*  fptr   = OpenFitsImage(filename, naxes);
+        int        status = 0;
+        const long stride = std::max(1L, (std::max(naxes[0], naxes[1]) + maxEdge - 1) / maxEdge);
+        const int  width  = (int)((naxes[0] - 1) / stride + 1);
+        const int  height = (int)((naxes[1] - 1) / stride + 1);
+        long       fpixel[maxAxes];
+        long       lpixel[maxAxes];
+        long       inc[maxAxes];
+
+        // the first plane of cubes
+        std::fill(fpixel, fpixel + maxAxes, 1L);
+        std::fill(lpixel, lpixel + maxAxes, 1L);
+        std::fill(inc, inc + maxAxes, 1L);
+        lpixel[0] = naxes[0];
+        lpixel[1] = naxes[1];
+        inc[0]    = stride;
+        inc[1]    = stride;
+
+        // cfitsio skips the rows between the decimated ones, so only every stride-th row is read from disk
+        std::vector<double> pixels((size_t)width * height);
+
+        if (fits_read_subset(fptr, TDOUBLE, fpixel, lpixel, inc, nullptr, pixels.data(), nullptr, &status))
+        {
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+        }
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        // undefined (NaN) pixels of floating point images are skipped, and shown black
+        const auto [min, max] = ComputeDisplayRange(pixels.data(), width, height, io::GetDisplayRangeOptions());
+        const double scale    = max > min ? 255.0 / (max - min) : 0.0;
+
+        acrion::image::BitmapData<uint8_t> result(width, height, 1);
+
+        for (int row = 0; row < height; ++row)
+        {
+            for (int column = 0; column < width; ++column)
+            {
+                const double value = pixels[(size_t)row * width + column];
+                result.Plot(column, row, std::isfinite(value) ? (uint8_t)(std::clamp(value - min, 0.0, max - min) * scale + 0.5) : 0);
+            }
+        }
+
+        result.SetBrightnessRangeForDisplay(0, 255);
+
+        return result;
+    }
+
+    io::ImageInfo ProbeFits(const std::filesystem::path& filename)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        fitsfile* fptr;
+        int       status = 0;
+        long      naxes[maxAxes];
+
+        if (fits_open_file(&fptr, filename.string().c_str(), READONLY, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        const int bitpix = SelectFitsImage(fptr, naxes);
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        io::ImageInfo info;
+        info.width    = (int)naxes[0];
+        info.height   = (int)naxes[1];
+        info.channels = 1;
+        info.depth    = bitpix / 8; // FITS uses negative BITPIX values for floating point, just like acrion::image::Bitmap::Depth()
+        return info;
+    }
+
+    size_t EstimateFitsBitmapSize(const std::filesystem::path& filename)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        fitsfile* fptr;
+        int       status = 0;
+        long      naxes[maxAxes];
+
+        if (fits_open_file(&fptr, filename.string().c_str(), READONLY, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        const int bitpix = SelectFitsImage(fptr, naxes);
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        // Read keeps the stored size of all samples; only scaled 64 bit integers become double, which has the same size
+        return (size_t)naxes[0] * naxes[1] * ((size_t)std::abs(bitpix) / 8);
+    }
+
+    std::vector<io::FitsHduInfo> ListFitsHdus(const std::filesystem::path& filename)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        fitsfile* fptr;
+        int       status = 0;
+        int       hduCount;
+
+        if (fits_open_file(&fptr, filename.string().c_str(), READONLY, &status) || fits_get_num_hdus(fptr, &hduCount, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        std::vector<io::FitsHduInfo> hdus(hduCount);
+
+        for (int index = 0; index < hduCount; ++index)
+        {
+            io::FitsHduInfo& hdu = hdus[index];
+            int              hduType;
+            char             name[FLEN_VALUE] = "";
+
+            if (fits_movabs_hdu(fptr, index + 1, &hduType, &status))
+            {
+                fits_close_file(fptr, &status);
+                ThrowFitsError(status);
+            }
+
+            fits_read_key_str(fptr, "EXTNAME", name, nullptr, &status);
+            status = 0; // EXTNAME is optional
+
+            hdu.index = index;
+            hdu.name  = name;
+            hdu.type  = hduType == IMAGE_HDU ? io::FitsHduType::Image : hduType == ASCII_TBL ? io::FitsHduType::AsciiTable : io::FitsHduType::BinaryTable;
+
+            if (hduType == IMAGE_HDU) // this includes tile-compressed images, which cfitsio presents as images
+            {
+                long naxes[maxAxes];
+                int  bitpix, naxis;
+
+                std::fill(naxes, naxes + maxAxes, 1L);
+
+                if (fits_get_img_param(fptr, maxAxes, &bitpix, &naxis, naxes, &status))
+                {
+                    fits_close_file(fptr, &status);
+                    ThrowFitsError(status);
+                }
+
+                if (naxis > 0)
+                {
+                    hdu.image.width    = (int)naxes[0];
+                    hdu.image.height   = (int)naxes[1];
+                    hdu.image.channels = 1;
+                    hdu.image.depth    = bitpix / 8;
+                    hdu.planes         = GetPlaneCount(naxes);
+                }
+            }
+        }
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        return hdus;
+    }
+
+    std::vector<std::optional<std::string>> ReadFitsKeywords(const std::filesystem::path& filename, const std::vector<std::string>& keywords)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        fitsfile* fptr;
+        int       status = 0;
+        int       hduCount;
+
+        if (fits_open_file(&fptr, filename.string().c_str(), READONLY, &status) || fits_get_num_hdus(fptr, &hduCount, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        std::vector<std::optional<std::string>> values(keywords.size());
+
+        // the primary header of tile-compressed files (.fz) is usually empty, so missing keywords are looked up in the first extension
+        for (int hdu = 1; hdu <= std::min(hduCount, 2); ++hdu)
+        {
+            int hduType;
+
+            if (hdu > 1 && fits_movabs_hdu(fptr, hdu, &hduType, &status))
+            {
+                break;
+            }
+
+            for (size_t index = 0; index < keywords.size(); ++index)
+            {
+                if (values[index])
+                {
+                    continue;
+                }
+
+                char value[FLEN_VALUE];
+
+                if (fits_read_keyword(fptr, keywords[index].c_str(), value, nullptr, &status) == KEY_NO_EXIST || status == VALUE_UNDEFINED)
+                {
+                    status = 0;
+                    continue;
+                }
+
+                if (status == 0 && value[0] == '\'')
+                {
+                    // removes the quotes, unescapes embedded quotes and concatenates long strings continued with CONTINUE
+                    char* text = nullptr;
+                    if (fits_read_key_longstr(fptr, keywords[index].c_str(), &text, nullptr, &status) == 0)
+                    {
+                        std::string unquoted = text;
+                        unquoted.erase(unquoted.find_last_not_of(' ') + 1); // trailing blanks are not significant in FITS strings
+                        values[index] = unquoted;
+                    }
+                    fits_free_memory(text, &status);
+                }
+                else if (status == 0)
+                {
+                    values[index] = value;
+                }
+
+                if (status)
+                {
+                    fits_close_file(fptr, &status);
+                    ThrowFitsError(status);
+                }
+            }
+        }
+
+        status = 0; // an unreadable extension only means that its keywords are missing
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+
+        return values;
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsPlane(const std::filesystem::path& filename, int hdu, long long plane)
+    {
+        const auto lock = LockFitsUnlessReentrant();
+
+        fitsfile* fptr;
+        int       status = 0;
+        int       hduType, bitpix, naxis;
+        long      naxes[maxAxes];
+
+        std::fill(naxes, naxes + maxAxes, 1L);
+
+        // only the HDU's header and the rows of the requested plane are read from disk
+        if (fits_open_file(&fptr, GetFitsUrl(filename, true).c_str(), READONLY, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        if (fits_movabs_hdu(fptr, hdu + 1, &hduType, &status) || (hduType == IMAGE_HDU && fits_get_img_param(fptr, maxAxes, &bitpix, &naxis, naxes, &status)))
+        {
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+        }
+
+        if (hduType != IMAGE_HDU || naxis == 0)
+        {
+            fits_close_file(fptr, &status);
+            throw std::runtime_error("acrion::imagetools::ReadFitsPlane: HDU " + std::to_string(hdu) + " does not contain an image");
+        }
+
+        if (plane < 0 || plane >= GetPlaneCount(naxes))
+        {
+            fits_close_file(fptr, &status);
+            throw std::runtime_error("acrion::imagetools::ReadFitsPlane: plane " + std::to_string(plane) + " does not exist in HDU " + std::to_string(hdu)
+                                     + ", which has " + std::to_string(GetPlaneCount(naxes)) + " plane(s)");
+        }
+
+        auto result = ReadMappedFitsPlane(fptr, filename, naxes, plane);
+
+        if (!result)
+        {
+            result = ReadFitsPixels(fptr, naxes, (long)plane, 0, 0, (int)naxes[0], (int)naxes[1]);
+
+            fits_close_file(fptr, &status);
+            ThrowFitsError(status);
+        }
+
+        ApplyDisplayRange(*result);
+        return result;
+    }
+
+    // Writes the scaling of a ScaledBitmap to the header and sets it up for the following writes. The samples are written as they
+    // are, and the scaling to physical values goes into the header. Unsigned types are stored as signed integers with an offset,
+    // which is added to BZERO.
+    int WriteFitsScaling(fitsfile* fptr, const acrion::image::Bitmap& bitmap, int bitpix)
+    {
+        int status = 0;
+
+        if (const auto* scaled = dynamic_cast<const io::ScaledBitmap*>(&bitmap))
+        {
+            const double offset = bitpix == USHORT_IMG ? std::ldexp(1.0, 15) : bitpix == ULONG_IMG ? std::ldexp(1.0, 31) : bitpix == ULONGLONG_IMG ? std::ldexp(1.0, 63) : 0.0;
+            double       scale  = scaled->Scale();
+            double       zero   = scaled->Zero() + scale * offset;
+
+            fits_update_key(fptr, TDOUBLE, "BSCALE", &scale, "physical = BZERO + BSCALE * stored value", &status)
+                || fits_update_key(fptr, TDOUBLE, "BZERO", &zero, nullptr, &status)
+                || fits_set_hdustruc(fptr, &status)
+                || fits_set_bscale(fptr, 1.0, offset, &status);
+        }
+
+        return status;
+    }
+
+    // The quantization of compressed floating point images recognizes null pixels by a value, so NaN are replaced by the value
+    // that cfitsio uses for this itself.
+    template <typename T>
+    int WriteCompressedFloatPixels(fitsfile* fptr, long fpixel[2], size_t count, T* values, int* status)
+    {
+        T nullValue = std::is_same_v<T, float> ? FLOATNULLVALUE : DOUBLENULLVALUE;
+
+        std::replace_if(values, values + count, [](T value) { return std::isnan(value); }, nullValue);
+
+        return fits_write_pixnull(fptr, std::is_same_v<T, float> ? TFLOAT : TDOUBLE, fpixel, (LONGLONG)count, values, &nullValue, status);
+    }
+
+    // Writes `rows` rows of the bitmap, starting at FITS row `firstRow` counted from the bottom, to the image in fptr starting at its
+    // first row. FITS stores the bottom row first, so bands of rows are copied in reverse order into a buffer that is written with a single call.
+    // If `dataSum` is given, the checksum of the samples as stored in an uncompressed image is added to it while the band is in the cache.
+    int WriteFitsRows(fitsfile* fptr, const acrion::image::Bitmap& bitmap, int datatype, long firstRow, long rows, uint32_t* dataSum = nullptr)
+    {
+        const long           width       = bitmap.Width();
+        const size_t         sampleSize  = std::abs(bitmap.Depth());
+        const size_t         bytesPerRow = (size_t)width * sampleSize; // in the file; gray images with several channels are reduced to the first one
+        const long           rowsPerBand = std::max(1L, (long)(writeBandSize / std::max<size_t>(bytesPerRow, 1)));
+        std::vector<uint8_t> band(std::min(rowsPerBand, rows) * bytesPerRow);
+        const uint8_t*       buffer      = (const uint8_t*)bitmap.Buffer();
+        long                 fpixel[2]   = {1, 1};
+        int                  status      = 0;
+        const bool           bCompressed = fits_is_compressed_image(fptr, &status) != 0;
+
+        for (long bandRow = 0; bandRow < rows && !status; bandRow += rowsPerBand)
+        {
+            const long bandRows = std::min(rowsPerBand, rows - bandRow);
+
+            for (long row = 0; row < bandRows; ++row)
+            {
+                const uint8_t* source      = buffer + (bitmap.Height() - 1 - firstRow - bandRow - row) * bytesPerRow * bitmap.Channels();
+                uint8_t*       destination = band.data() + row * bytesPerRow;
+
+                if (bitmap.Channels() == 1)
+                {
+                    std::memcpy(destination, source, bytesPerRow);
+                    continue;
+                }
+
+                for (long column = 0; column < width; ++column)
+                {
+                    std::memcpy(destination + column * sampleSize, source + column * sampleSize * bitmap.Channels(), sampleSize);
+                }
+            }
+
+            fpixel[1] = bandRow + 1;
+
+            if (dataSum)
+            {
+                // unsigned integers are stored as signed integers with an offset, i.e. with the sign bit flipped (see WriteFits)
+                const uint64_t flip = sampleSize > 1 && bitmap.Depth() > 0 ? uint64_t(1) << (8 * sampleSize - 1) : 0;
+                *dataSum            = FitsSampleChecksum(band.data(), (size_t)bandRows * width, (int)sampleSize, flip, (size_t)bandRow * bytesPerRow, *dataSum);
+            }
+
+            if (bCompressed && datatype == TFLOAT)
+            {
+                WriteCompressedFloatPixels(fptr, fpixel, (size_t)bandRows * width, (float*)band.data(), &status);
+            }
+            else if (bCompressed && datatype == TDOUBLE)
+            {
+                WriteCompressedFloatPixels(fptr, fpixel, (size_t)bandRows * width, (double*)band.data(), &status);
+            }
+            else
+            {
+                fits_write_pix(fptr, datatype, fpixel, (LONGLONG)bandRows * width, band.data(), &status);
+            }
+        }
+
+        return status;
+    }
+
+    // Sets DATASUM and CHECKSUM of the current HDU, whose data have been written completely, to the checksums of data unit and HDU. The
+    // keywords must exist already, so that the header does not grow afterwards. Without `dataSum`, the data unit is read back for it.
+    int WriteFitsChecksums(fitsfile* fptr, std::optional<uint32_t> dataSum)
+    {
+        int       status = 0;
+        long long headStart, dataStart, dataEnd;
+
+        // fits_set_hdustruc completes the header (e.g. PCOUNT of compressed images) and writes its END card
+        if (fits_set_hdustruc(fptr, &status) || fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status))
+        {
+            return status;
+        }
+
+        if (!dataSum)
+        {
+            // the table of a compressed image: its size without the fill, which is only written when the file is closed, and the
+            // maximum lengths of the compressed tiles in TFORM1, which are otherwise only updated then as well
+            long long heapBytes = 0, rowBytes = 0, rowCount = 0;
+
+            if (fits_read_key(fptr, TLONGLONG, "PCOUNT", &heapBytes, nullptr, &status) || fits_read_key(fptr, TLONGLONG, "NAXIS1", &rowBytes, nullptr, &status)
+                || fits_read_key(fptr, TLONGLONG, "NAXIS2", &rowCount, nullptr, &status) || ffuptf(fptr, &status))
+            {
+                return status;
+            }
+
+            dataSum = ReadFitsChecksum(fptr, dataStart, dataStart + rowBytes * rowCount + heapBytes, status);
+        }
+
+        std::string datasum = std::to_string(*dataSum);
+        char        zeros[] = "0000000000000000";
+
+        if (fits_update_key(fptr, TSTRING, "DATASUM", datasum.data(), "data unit checksum", &status)
+            || fits_update_key(fptr, TSTRING, "CHECKSUM", zeros, "HDU checksum", &status) || fits_set_hdustruc(fptr, &status))
+        {
+            return status;
+        }
+
+        std::string checksum = EncodeFitsChecksum(AddFitsChecksums(ReadFitsChecksum(fptr, headStart, dataStart, status), *dataSum));
+
+        return status ? status : fits_update_key(fptr, TSTRING, "CHECKSUM", checksum.data(), "HDU checksum", &status);
+    }
+
+    // Requests tile compression with tiles of whole rows for the images that are created next in fptr.
+    int RequestFitsTileCompression(fitsfile* fptr, const io::FitsCompressionOptions& options, long width, long tileRows, int ditherSeed)
+    {
+        const int type    = options.compression == io::FitsCompression::Gzip ? GZIP_1 : options.compression == io::FitsCompression::Hcompress ? HCOMPRESS_1 : RICE_1;
+        long      tile[2] = {width, tileRows};
+        int       status  = 0;
+
+        fits_set_compression_type(fptr, type, &status);
+
+        if (tileRows > 0)
+        {
+            fits_set_tile_dim(fptr, 2, tile, &status);
+        }
+
+        fits_set_quantize_level(fptr, options.quantizeLevel, &status);
+        fits_set_quantize_method(fptr, SUBTRACTIVE_DITHER_1, &status);
+        fits_set_dither_seed(fptr, ditherSeed, &status);
+        fits_set_hcomp_scale(fptr, options.hcompressScale, &status);
+
+        return status;
+    }
+
+    // Appends the rows of the tile table of a compressed image to the tile table of fptr, starting at row firstTile + 1, and adds
+    // columns that only the source has, e.g. GZIP_COMPRESSED_DATA for floating point tiles that could not be quantized.
+    int CopyCompressedFitsTiles(fitsfile* source, fitsfile* fptr, long firstTile)
+    {
+        int                  status  = 0;
+        int                  columns = 0;
+        long                 tiles   = 0;
+        std::vector<uint8_t> bytes;
+        std::vector<double>  values;
+
+        if (fits_get_num_cols(source, &columns, &status) || fits_get_num_rows(source, &tiles, &status))
+        {
+            return status;
+        }
+
+        for (int column = 1; column <= columns && !status; ++column)
+        {
+            char keyword[FLEN_KEYWORD];
+            char name[FLEN_VALUE];
+            char format[FLEN_VALUE];
+            int  target   = 0;
+            int  typecode = 0;
+            long repeat   = 0;
+            long width    = 0;
+
+            if (fits_make_keyn("TTYPE", column, keyword, &status) || fits_read_key_str(source, keyword, name, nullptr, &status)
+                || fits_make_keyn("TFORM", column, keyword, &status) || fits_read_key_str(source, keyword, format, nullptr, &status)
+                || fits_get_coltype(source, column, &typecode, &repeat, &width, &status))
+            {
+                break;
+            }
+
+            if (fits_get_colnum(fptr, CASEINSEN, name, &target, &status) == COL_NOT_FOUND)
+            {
+                status = 0;
+                fits_get_num_cols(fptr, &target, &status);
+                fits_insert_col(fptr, ++target, name, format, &status);
+            }
+
+            if (typecode < 0 && typecode != -TBYTE) // compressed tiles are stored as variable length byte arrays
+            {
+                status = BAD_TFORM;
+            }
+
+            for (long tile = 1; tile <= tiles && !status; ++tile)
+            {
+                if (typecode < 0)
+                {
+                    LONGLONG length = 0;
+                    LONGLONG offset = 0;
+
+                    // tiles stored in another column leave this one empty
+                    if (fits_read_descriptll(source, column, tile, &length, &offset, &status) == 0 && length > 0)
+                    {
+                        bytes.resize(length);
+                        fits_read_col(source, TBYTE, column, tile, 1, length, nullptr, bytes.data(), nullptr, &status)
+                            || fits_write_col(fptr, TBYTE, target, firstTile + tile, 1, length, bytes.data(), &status);
+                    }
+                }
+                else
+                {
+                    values.resize(repeat);
+                    fits_read_col(source, TDOUBLE, column, tile, 1, repeat, nullptr, values.data(), nullptr, &status)
+                        || fits_write_col(fptr, TDOUBLE, target, firstTile + tile, 1, repeat, values.data(), &status);
+                }
+            }
+        }
+
+        char zblank[FLEN_CARD];
+        char card[FLEN_CARD];
+        int  sourceStatus = 0;
+        int  targetStatus = 0;
+
+        // cfitsio adds ZBLANK after ZCMPTYPE when it writes tiles of floating point images that may contain NaN
+        if (!status && fits_read_card(source, "ZBLANK", zblank, &sourceStatus) == 0 && fits_read_card(fptr, "ZBLANK", card, &targetStatus) == KEY_NO_EXIST)
+        {
+            fits_read_card(fptr, "ZCMPTYPE", card, &status);
+            fits_insert_card(fptr, zblank, &status);
+        }
+
+        return status;
+    }
+
+    // Compresses the tiles of the image in fptr, whose header has been written, and writes them in order. Bands of tile rows are
+    // compressed concurrently into compressed images in memory, because cfitsio compresses and writes each tile in one step.
+    // Creating and closing memory files modifies cfitsio's global driver tables, so this is serialized.
+    int WriteCompressedFitsTiles(fitsfile* fptr, const acrion::image::Bitmap& bitmap, int bitpix, int datatype, const io::FitsCompressionOptions& options, int ditherSeed)
+    {
+        struct Band
+        {
+            fitsfile* fptr      = nullptr;
+            long      firstTile = 0;
+        };
+
+        const long       height    = bitmap.Height();
+        long             tile[2]   = {1, 1};
+        int              status    = 0;
+        std::mutex       handleMutex;
+        std::atomic<int> firstError{0};
+
+        if (fits_get_tile_dim(fptr, 2, tile, &status))
+        {
+            return status;
+        }
+
+        const long        tileRows = std::max(1L, tile[1]);
+        const long        tiles    = (height + tileRows - 1) / tileRows;
+        std::vector<Band> bands(tiles); // indexed by the first tile of each band
+
+        parallel::ForEachBand(tiles,
+                              (size_t)bitmap.Width() * tileRows * std::abs(bitmap.Depth()),
+                              [&](size_t firstTile, size_t tileCount)
+                              {
+                                  const long firstRow   = (long)firstTile * tileRows;
+                                  long       naxes[2]   = {bitmap.Width(), std::min(height, (long)(firstTile + tileCount) * tileRows) - firstRow};
+                                  Band&      band       = bands[firstTile];
+                                  int        bandStatus = 0;
+
+                                  band.firstTile = (long)firstTile;
+
+                                  {
+                                      std::lock_guard<std::mutex> lock(handleMutex);
+
+                                      // the tiles of a band continue the dither sequence where the previous band ends
+                                      fits_create_file(&band.fptr, "mem://", &bandStatus)
+                                          || RequestFitsTileCompression(band.fptr, options, naxes[0], tileRows, (int)((ditherSeed - 1 + firstTile) % 10000) + 1)
+                                          || fits_create_img(band.fptr, bitpix, 2, naxes, &bandStatus);
+                                  }
+
+                                  if (!bandStatus)
+                                  {
+                                      bandStatus = WriteFitsScaling(band.fptr, bitmap, bitpix);
+                                  }
+
+                                  if (!bandStatus)
+                                  {
+                                      bandStatus = WriteFitsRows(band.fptr, bitmap, datatype, firstRow, naxes[1]);
+                                  }
+
+                                  if (bandStatus)
+                                  {
+                                      int expected = 0;
+                                      firstError.compare_exchange_strong(expected, bandStatus);
+                                  }
+                              });
+
+        status = firstError;
+
+        for (Band& band : bands)
+        {
+            if (band.fptr)
+            {
+                if (!status)
+                {
+                    status = CopyCompressedFitsTiles(band.fptr, fptr, band.firstTile);
+                }
+
+                int closeStatus = 0;
+                fits_close_file(band.fptr, &closeStatus);
+            }
+        }
+
+        return status;
+    }
+
+    void WriteFits(const acrion::image::Bitmap& bitmap, const std::filesystem::path& filename, const io::FitsCompressionOptions& compression)
+    {
+        if (bitmap.Channels() != 1 && bitmap.ContainsColors())
+        {
+            throw std::runtime_error("acrion::imagetools::WriteFits: Creating colored FITS image files is not supported. Please use TIFF format for this.");
+        }
+
+        int bitpix, datatype;
+
+        switch (bitmap.Depth())
+        {
+        case 1:
+            bitpix   = BYTE_IMG;
+            datatype = TBYTE;
+            break;
+        case 2:
+            bitpix   = USHORT_IMG; // cfitsio stores unsigned values as signed integers with BZERO = 32768
+            datatype = TUSHORT;
+            break;
+        case 4:
+            bitpix   = ULONG_IMG;
+            datatype = TUINT;
+            break;
+        case 8:
+            bitpix   = ULONGLONG_IMG;
+            datatype = TULONGLONG;
+            break;
+        case -4:
+            bitpix   = FLOAT_IMG;
+            datatype = TFLOAT;
+            break;
+        case -8:
+            bitpix   = DOUBLE_IMG;
+            datatype = TDOUBLE;
+            break;
+        default:
+            throw std::runtime_error("acrion::imagetools::WriteFits: Unsupported image depth " + std::to_string(bitmap.Depth()));
+        }
+
+        const bool bCompressed = compression.compression != io::FitsCompression::None;
+
+        if (bCompressed && bitmap.Depth() == 8)
+        {
+            throw std::runtime_error("acrion::imagetools::WriteFits: 64 bit integer images cannot be tile-compressed");
+        }
+
+        if (bCompressed && bitmap.Depth() < 0 && compression.quantizeLevel == 0.0f && compression.compression != io::FitsCompression::Gzip)
+        {
+            throw std::runtime_error("acrion::imagetools::WriteFits: floating point images can only be compressed losslessly with Gzip");
+        }
+
+        if (compression.ditherSeed < 0 || compression.ditherSeed > 10000)
+        {
+            throw std::runtime_error("acrion::imagetools::WriteFits: the dither seed must be between 1 and 10000, or 0");
+        }
+
+        int ditherSeed = compression.ditherSeed;
+
+        if (ditherSeed == 0)
+        {
+            // like cfitsio's checksum seed, but taken from the first row, which is available before tiles are compressed in parallel
+            const uint8_t* firstRow = (const uint8_t*)bitmap.Buffer() + (size_t)(bitmap.Height() - 1) * bitmap.Width() * bitmap.Channels() * std::abs(bitmap.Depth());
+            const size_t   length   = (size_t)bitmap.Width() * bitmap.Channels() * std::abs(bitmap.Depth());
+            unsigned long  sum      = 0;
+
+            for (size_t i = 0; i < length; ++i)
+            {
+                sum += firstRow[i];
+            }
+
+            ditherSeed = (int)(sum % 10000) + 1;
+        }
+
+        const auto lock = LockFitsUnlessReentrant();
+
+        fitsfile* fptr;
+        int       status   = 0;
+        long      naxes[2] = {bitmap.Width(), bitmap.Height()};
+
+        // the leading '!' tells cfitsio to overwrite an existing file
+        if (fits_create_file(&fptr, ("!" + filename.string()).c_str(), &status)
+            || (bCompressed && RequestFitsTileCompression(fptr, compression, naxes[0], compression.tileRows, ditherSeed))
+            || fits_create_img(fptr, bitpix, 2, naxes, &status))
+        {
+            ThrowFitsError(status);
+        }
+
+        status = WriteFitsScaling(fptr, bitmap, bitpix);
+
+        // the checksum keywords are written before the data with placeholder values, so that the header keeps its size
+        const bool bChecksums = writeChecksums;
+        char       zeros[]    = "0000000000000000";
+        uint32_t   dataSum    = 0;
+
+        if (!status && bChecksums)
+        {
+            fits_write_key(fptr, TSTRING, "CHECKSUM", zeros, "HDU checksum", &status) || fits_write_key(fptr, TSTRING, "DATASUM", zeros, "data unit checksum", &status);
+        }
+
+        // fits_hcompress keeps its state in static variables, and cfitsio builds that are not reentrant do not protect the random
+        // numbers of the quantization, so these tiles are compressed one after another
+        const bool bParallel = bCompressed && compression.compression != io::FitsCompression::Hcompress && (fits_is_reentrant() || bitmap.Depth() > 0)
+                               && parallel::ThreadsFor((size_t)naxes[0] * naxes[1] * std::abs(bitmap.Depth())) > 1;
+
+        if (!status)
+        {
+            status = bParallel ? WriteCompressedFitsTiles(fptr, bitmap, bitpix, datatype, compression, ditherSeed)
+                               : WriteFitsRows(fptr, bitmap, datatype, 0, naxes[1], bChecksums && !bCompressed ? &dataSum : nullptr);
+        }
+
+        if (!status && bChecksums)
+        {
+            // the data unit of a compressed image is a table of compressed tiles, which is summed after it has been written
+            status = WriteFitsChecksums(fptr, bCompressed ? std::nullopt : std::optional<uint32_t>(dataSum));
+        }
+
+        if (status)
+        {
+            fits_delete_file(fptr, &status);
+            ThrowFitsError(status);
+        }
+
+        fits_close_file(fptr, &status);
+        ThrowFitsError(status);
+    }
+
+    void io::SetFitsChecksums(const FitsChecksums& options)
+    {
+        writeChecksums = options.write;
+
+        // images that are in the cache already have not been verified
+        if (!verifyChecksums.exchange(options.verify) && options.verify)
+        {
+            io::InvalidateCache();
+        }
+    }
+
+    io::FitsChecksums io::GetFitsChecksums()
+    {
+        return {writeChecksums, verifyChecksums};
+    }
+
+    void io::SetFitsReadBlocks(const FitsReadBlocks& options)
+    {
+        if (options.blockCount < 1 || options.blockSize > (size_t)std::numeric_limits<long>::max() / 2)
+        {
+            throw std::runtime_error("acrion::imagetools::io::SetFitsReadBlocks: invalid block size " + std::to_string(options.blockSize) + " or count " + std::to_string(options.blockCount));
+        }
+
+        const auto lock = LockFitsUnlessReentrant();
+        fits_set_large_block_reads((long)options.blockSize, options.blockCount);
+    }
+
+    io::FitsReadBlocks io::GetFitsReadBlocks()
+    {
+        const auto lock = LockFitsUnlessReentrant();
+        long       blockSize;
+        int        blockCount;
+
+        fits_get_large_block_reads(&blockSize, &blockCount);
+
+        return {(size_t)blockSize, blockCount};
+    }
+
+    io::MappedFitsImage::MappedFitsImage(const std::wstring& filePath, int hdu)
+    {
+        const std::filesystem::path filename(filePath);
+        long                        naxes[maxAxes];
+        fitsfile*                   fptr;
+        int                         status = 0;
+        long long                   offset;
+
+        {
+            const auto lock = LockFitsUnlessReentrant();
+
+            if (fits_open_file(&fptr, filename.string().c_str(), READONLY, &status))
+            {
+                ThrowFitsError(status);
+            }
+
+            if (hdu >= 0)
+            {
+                int naxis = 0;
+                std::fill(naxes, naxes + maxAxes, 1L);
+
+                if (fits_movabs_hdu(fptr, hdu + 1, nullptr, &status) || fits_get_img_param(fptr, maxAxes, &_bitpix, &naxis, naxes, &status))
+                {
+                    fits_close_file(fptr, &status);
+                    ThrowFitsError(status);
+                }
+
+                if (naxis == 0)
+                {
+                    fits_close_file(fptr, &status);
+                    throw std::runtime_error("acrion::imagetools::MappedFitsImage: HDU " + std::to_string(hdu) + " does not contain an image");
+                }
+            }
+            else
+            {
+                _bitpix = SelectFitsImage(fptr, naxes);
+            }
+
+            offset = GetMappableFitsPlaneOffset(fptr, filename, naxes, 0, _bitpix);
+            ReadFitsScaling(fptr, _scale, _zero);
+            fits_close_file(fptr, &status);
+        }
+
+        if (offset < 0)
+        {
+            throw std::runtime_error("acrion::imagetools::MappedFitsImage: the image in '" + filename.string() + "' is compressed and cannot be mapped");
+        }
+
+        _width  = (int)naxes[0];
+        _height = (int)naxes[1];
+        _planes = GetPlaneCount(naxes);
+
+        auto map = std::make_shared<const MemoryMap>(filename);
+        _data    = map->Data() + offset;
+        _map     = std::move(map);
+    }
 }
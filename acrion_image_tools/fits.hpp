@@ -24,13 +24,33 @@ along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 */
 
 #pragma once
+#include "io.hpp"
+
 #include "acrion/image/bitmap.hpp"
 #include "acrion/image/bitmap_data.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace acrion::imagetools
 {
-    acrion::image::BitmapData<double> ReadFits(const std::filesystem::path& filename);
+    std::shared_ptr<acrion::image::Bitmap> ReadFits(const std::filesystem::path& filename);
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsFromMemory(const void* data, size_t size);
+    bool                                   IsFitsData(const void* data, size_t size);
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsRegion(const std::filesystem::path& filename, int x, int y, int width, int height);
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsReduced(const std::filesystem::path& filename, int factor, io::Reduction reduction);
+    acrion::image::BitmapData<uint8_t>     ReadFitsPreview(const std::filesystem::path& filename, int maxEdge);
+    io::ImageInfo                          ProbeFits(const std::filesystem::path& filename);
+    // upper bound of the size of the bitmap ReadFits returns, taken from the header
+    size_t                                 EstimateFitsBitmapSize(const std::filesystem::path& filename);
+    std::vector<io::FitsHduInfo>           ListFitsHdus(const std::filesystem::path& filename);
+    // values of the given keywords as they appear in the header (strings without quotes), taken from the primary HDU or, if it lacks them, the first extension
+    std::vector<std::optional<std::string>> ReadFitsKeywords(const std::filesystem::path& filename, const std::vector<std::string>& keywords);
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsPlane(const std::filesystem::path& filename, int hdu, long long plane);
+    void                                   WriteFits(const acrion::image::Bitmap& bitmap, const std::filesystem::path& filename, const io::FitsCompressionOptions& compression = {});
 }
@@ -0,0 +1,645 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "fits_index.hpp"
+#include "fits.hpp"
+
+#include <cbeam/convert/string.hpp>
+#include <cbeam/logging/log_manager.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace acrion::imagetools::io
+{
+    namespace
+    {
+        // file format: magic, keyword count, keywords, entry count, entries (path, size, modification time, one value per keyword).
+        // Integers are little-endian, strings are prefixed with their length in bytes, and a missing value has the length missingValue.
+        constexpr char     magic[8]     = {'A', 'I', 'T', 'F', 'I', 'D', 'X', '1'};
+        constexpr uint32_t missingValue = 0xFFFFFFFF;
+
+        const char* const fitsExtensions[] = {".fits", ".fit", ".fts", ".fz"};
+
+        void WriteInteger(std::string& buffer, uint64_t value, int bytes)
+        {
+            for (int i = 0; i < bytes; ++i)
+            {
+                buffer.push_back((char)(value >> (8 * i)));
+            }
+        }
+
+        void WriteString(std::string& buffer, const std::string& text)
+        {
+            WriteInteger(buffer, text.size(), 4);
+            buffer += text;
+        }
+
+        class IndexReader
+        {
+        public:
+            explicit IndexReader(const std::string& buffer)
+                : _buffer(buffer)
+            {
+            }
+
+            uint64_t Integer(int bytes)
+            {
+                Require(bytes);
+
+                uint64_t value = 0;
+                for (int i = 0; i < bytes; ++i)
+                {
+                    value |= (uint64_t)(uint8_t)_buffer[_position++] << (8 * i);
+                }
+
+                return value;
+            }
+
+            std::optional<std::string> String()
+            {
+                const uint32_t length = (uint32_t)Integer(4);
+
+                if (length == missingValue)
+                {
+                    return std::nullopt;
+                }
+
+                Require(length);
+                _position += length;
+
+                return _buffer.substr(_position - length, length);
+            }
+
+            void Require(size_t bytes) const
+            {
+                if (bytes > _buffer.size() - _position)
+                {
+                    throw std::runtime_error("unexpected end of file");
+                }
+            }
+
+            // Requires `count` items of at least `bytes` each, without overflowing for corrupt counts
+            void RequireItems(uint64_t count, size_t bytes) const
+            {
+                if (count > (_buffer.size() - _position) / bytes)
+                {
+                    throw std::runtime_error("unexpected end of file");
+                }
+            }
+
+        private:
+            const std::string& _buffer;
+            size_t             _position = 0;
+        };
+
+        std::string Trim(const std::string& text)
+        {
+            const size_t first = text.find_first_not_of(" \t");
+            return first == std::string::npos ? std::string() : text.substr(first, text.find_last_not_of(" \t") - first + 1);
+        }
+
+        std::string NormalizeKeyword(const std::string& keyword)
+        {
+            std::string normalized = Trim(keyword);
+            std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c)
+                           { return (char)std::toupper(c); });
+
+            if (normalized.empty())
+            {
+                throw std::runtime_error("acrion::imagetools::FitsIndex: empty keyword");
+            }
+
+            return normalized;
+        }
+
+        // FITS writes floating point exponents with E or D, e.g. 1.5D+02
+        double ParseNumber(const std::optional<std::string>& value)
+        {
+            if (!value)
+            {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+
+            std::string text = Trim(*value);
+            std::replace(text.begin(), text.end(), 'D', 'E');
+            std::replace(text.begin(), text.end(), 'd', 'e');
+
+            char*        end    = nullptr;
+            const double number = text.empty() ? 0.0 : std::strtod(text.c_str(), &end);
+
+            return !text.empty() && *end == '\0' && std::isfinite(number) ? number : std::numeric_limits<double>::quiet_NaN();
+        }
+
+        int CompareIgnoringCase(const std::string& a, const std::string& b)
+        {
+            const size_t length = std::min(a.size(), b.size());
+
+            for (size_t i = 0; i < length; ++i)
+            {
+                const int difference = std::tolower((unsigned char)a[i]) - std::tolower((unsigned char)b[i]);
+                if (difference)
+                {
+                    return difference;
+                }
+            }
+
+            return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+        }
+
+        bool IsFitsFile(const std::filesystem::path& path)
+        {
+            std::string extension = cbeam::convert::to_lower(path.extension().string());
+
+            if (extension == ".gz") // cfitsio reads gzip-compressed FITS files as well, see io::Read
+            {
+                extension = cbeam::convert::to_lower(path.stem().extension().string());
+            }
+
+            return std::find(std::begin(fitsExtensions), std::end(fitsExtensions), extension) != std::end(fitsExtensions);
+        }
+
+        bool Satisfies(int comparison, FitsIndexOperator op)
+        {
+            switch (op)
+            {
+            case FitsIndexOperator::Equal:
+                return comparison == 0;
+            case FitsIndexOperator::NotEqual:
+                return comparison != 0;
+            case FitsIndexOperator::Less:
+                return comparison < 0;
+            case FitsIndexOperator::LessEqual:
+                return comparison <= 0;
+            case FitsIndexOperator::Greater:
+                return comparison > 0;
+            default:
+                return comparison >= 0;
+            }
+        }
+    }
+
+    FitsIndex::FitsIndex(const std::wstring& indexPath, const std::vector<std::string>& keywords)
+        : _indexPath(indexPath)
+    {
+        for (const std::string& keyword : keywords)
+        {
+            const std::string normalized = NormalizeKeyword(keyword);
+            if (std::find(_keywords.begin(), _keywords.end(), normalized) == _keywords.end())
+            {
+                _keywords.push_back(normalized);
+            }
+        }
+
+        Load(_keywords);
+    }
+
+    void FitsIndex::Load(const std::vector<std::string>& keywords)
+    {
+        std::ifstream file(std::filesystem::path(_indexPath), std::ios::binary);
+
+        if (!file)
+        {
+            if (keywords.empty())
+            {
+                throw std::runtime_error("acrion::imagetools::FitsIndex: index file '" + cbeam::convert::to_string(_indexPath) + "' not found, and no keywords given to create it");
+            }
+
+            return;
+        }
+
+        const std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        std::vector<std::string> storedKeywords;
+        std::vector<Entry>       entries;
+
+        try
+        {
+            IndexReader reader(buffer);
+
+            reader.Require(sizeof(magic));
+            if (!std::equal(std::begin(magic), std::end(magic), buffer.begin()))
+            {
+                throw std::runtime_error("not a FITS index file");
+            }
+            reader.Integer(sizeof(magic));
+
+            const uint64_t keywordCount = reader.Integer(4);
+            reader.RequireItems(keywordCount, 4); // each keyword has at least its length
+            storedKeywords.resize(keywordCount);
+            for (std::string& keyword : storedKeywords)
+            {
+                keyword = reader.String().value_or(std::string());
+            }
+
+            // the smallest entry consists of three integers, so that a corrupt count cannot allocate huge amounts of memory
+            const uint64_t entryCount = reader.Integer(8);
+            reader.RequireItems(entryCount, 20);
+            entries.resize(entryCount);
+
+            for (Entry& entry : entries)
+            {
+                entry.path     = cbeam::convert::from_string<std::wstring>(reader.String().value_or(std::string()));
+                entry.size     = (long long)reader.Integer(8);
+                entry.modified = (long long)reader.Integer(8);
+
+                entry.values.resize(storedKeywords.size());
+                for (std::optional<std::string>& value : entry.values)
+                {
+                    value = reader.String();
+                }
+
+                entry.numbers.resize(entry.values.size());
+                std::transform(entry.values.begin(), entry.values.end(), entry.numbers.begin(), ParseNumber);
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            if (keywords.empty())
+            {
+                throw std::runtime_error("acrion::imagetools::FitsIndex: cannot read index file '" + cbeam::convert::to_string(_indexPath) + "': " + ex.what());
+            }
+
+            CBEAM_LOG("acrion image framework: Ignoring index file '" + cbeam::convert::to_string(_indexPath) + "': " + ex.what());
+            return;
+        }
+
+        if (keywords.empty() || keywords == storedKeywords)
+        {
+            _keywords = std::move(storedKeywords);
+            _entries  = std::move(entries);
+        }
+        else
+        {
+            CBEAM_LOG("acrion image framework: The keywords of index file '" + cbeam::convert::to_string(_indexPath) + "' changed, all headers are read again");
+        }
+    }
+
+    FitsIndexUpdateStatistics FitsIndex::Update(const std::wstring& directory, int threads)
+    {
+        const std::filesystem::path root   = std::filesystem::weakly_canonical(std::filesystem::absolute(std::filesystem::path(directory)));
+        const std::wstring          prefix = (root / "").wstring();
+
+        if (!std::filesystem::is_directory(root))
+        {
+            throw std::runtime_error("acrion::imagetools::FitsIndex::Update: '" + cbeam::convert::to_string(directory) + "' is not a directory");
+        }
+
+        FitsIndexUpdateStatistics statistics;
+        std::vector<Entry>        entries;
+        std::vector<size_t>       pending; // indices into entries of the files whose headers need to be read
+
+        std::unordered_map<std::wstring, const Entry*> known;
+        for (const Entry& entry : _entries)
+        {
+            if (entry.path.compare(0, prefix.size(), prefix) == 0)
+            {
+                known.emplace(entry.path, &entry);
+            }
+            else
+            {
+                entries.push_back(entry); // below another directory
+            }
+        }
+
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec))
+        {
+            std::error_code fileError;
+
+            if (!IsFitsFile(it->path()) || !it->is_regular_file(fileError))
+            {
+                continue;
+            }
+
+            Entry file;
+            file.path     = it->path().wstring();
+            file.size     = (long long)it->file_size(fileError);
+            file.modified = (long long)it->last_write_time(fileError).time_since_epoch().count();
+
+            if (fileError)
+            {
+                continue; // e.g. deleted while scanning
+            }
+
+            ++statistics.files;
+
+            const auto previous = known.find(file.path);
+
+            if (previous != known.end() && previous->second->size == file.size && previous->second->modified == file.modified)
+            {
+                entries.push_back(*previous->second);
+            }
+            else
+            {
+                pending.push_back(entries.size());
+                entries.push_back(std::move(file));
+            }
+
+            if (previous != known.end())
+            {
+                known.erase(previous);
+            }
+        }
+
+        if (ec)
+        {
+            throw std::runtime_error("acrion::imagetools::FitsIndex::Update: cannot scan '" + cbeam::convert::to_string(directory) + "': " + ec.message());
+        }
+
+        statistics.read    = pending.size();
+        statistics.removed = known.size();
+
+        // reading a header is dominated by latency (open, seek, read a few blocks), so even a single core profits from several workers
+        const size_t        workerCount = std::min<size_t>(pending.size(), threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()));
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> failed{0};
+
+        auto worker = [&]
+        {
+            for (size_t index = next++; index < pending.size(); index = next++)
+            {
+                Entry& entry = entries[pending[index]];
+
+                try
+                {
+                    entry.values = ReadFitsKeywords(std::filesystem::path(entry.path), _keywords);
+                }
+                catch (const std::exception& ex)
+                {
+                    entry.values.assign(_keywords.size(), std::nullopt);
+                    ++failed;
+                    CBEAM_LOG("acrion image framework: Cannot index '" + cbeam::convert::to_string(entry.path) + "': " + ex.what());
+                }
+
+                entry.numbers.resize(entry.values.size());
+                std::transform(entry.values.begin(), entry.values.end(), entry.numbers.begin(), ParseNumber);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < workerCount; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+
+        worker();
+
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+
+        statistics.failed = failed;
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+                  { return a.path < b.path; });
+        _entries = std::move(entries);
+
+        Save();
+
+        return statistics;
+    }
+
+    std::vector<std::wstring> FitsIndex::Query(const std::vector<FitsIndexCondition>& conditions) const
+    {
+        struct PreparedCondition
+        {
+            size_t            keyword;
+            FitsIndexOperator op;
+            std::string       value;
+            double            number;
+        };
+
+        std::vector<PreparedCondition> prepared;
+
+        for (const FitsIndexCondition& condition : conditions)
+        {
+            const std::string keyword = NormalizeKeyword(condition.keyword);
+            const auto        found   = std::find(_keywords.begin(), _keywords.end(), keyword);
+
+            if (found == _keywords.end())
+            {
+                throw std::runtime_error("acrion::imagetools::FitsIndex::Query: keyword " + keyword + " is not part of the index");
+            }
+
+            prepared.push_back({(size_t)(found - _keywords.begin()), condition.op, Trim(condition.value), ParseNumber(condition.value)});
+        }
+
+        auto satisfiesAll = [&](const Entry& entry)
+        {
+            for (const PreparedCondition& condition : prepared)
+            {
+                const std::optional<std::string>& value  = entry.values[condition.keyword];
+                const double                      number = entry.numbers[condition.keyword];
+
+                if (!value)
+                {
+                    return false;
+                }
+
+                const int comparison = !std::isnan(number) && !std::isnan(condition.number) ? (number < condition.number ? -1 : number > condition.number ? 1 : 0)
+                                                                                            : CompareIgnoringCase(*value, condition.value);
+
+                if (!Satisfies(comparison, condition.op))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        std::vector<std::wstring> paths;
+
+        for (const Entry& entry : _entries)
+        {
+            if (satisfiesAll(entry))
+            {
+                paths.push_back(entry.path);
+            }
+        }
+
+        return paths;
+    }
+
+    std::vector<FitsIndexCondition> FitsIndex::ParseQuery(const std::string& query)
+    {
+        std::vector<FitsIndexCondition> conditions;
+        size_t                          position = 0;
+
+        auto isSeparator = [&](size_t i)
+        { return i < query.size() && (std::isspace((unsigned char)query[i]) || query[i] == ','); };
+
+        auto error = [&](const std::string& reason)
+        { return std::runtime_error("acrion::imagetools::FitsIndex::ParseQuery: " + reason + " at position " + std::to_string(position) + " of '" + query + "'"); };
+
+        while (true)
+        {
+            while (isSeparator(position))
+            {
+                ++position;
+            }
+
+            if (position == query.size())
+            {
+                break;
+            }
+
+            FitsIndexCondition condition;
+
+            const size_t keywordEnd = query.find_first_of("=!<> \t,", position);
+            condition.keyword       = query.substr(position, keywordEnd == std::string::npos ? std::string::npos : keywordEnd - position);
+            position                = keywordEnd == std::string::npos ? query.size() : keywordEnd;
+
+            if (condition.keyword.empty())
+            {
+                throw error("keyword expected");
+            }
+
+            while (position < query.size() && std::isspace((unsigned char)query[position]))
+            {
+                ++position;
+            }
+
+            const std::string op = query.substr(position, 2);
+
+            if (op == "!=" || op == "<=" || op == ">=" || op == "==")
+            {
+                condition.op = op == "!=" ? FitsIndexOperator::NotEqual : op == "<=" ? FitsIndexOperator::LessEqual
+                                                                      : op == ">=" ? FitsIndexOperator::GreaterEqual
+                                                                                   : FitsIndexOperator::Equal;
+                position += 2;
+            }
+            else if (!op.empty() && (op[0] == '=' || op[0] == '<' || op[0] == '>'))
+            {
+                condition.op = op[0] == '=' ? FitsIndexOperator::Equal : op[0] == '<' ? FitsIndexOperator::Less
+                                                                                      : FitsIndexOperator::Greater;
+                position += 1;
+            }
+            else
+            {
+                throw error("operator expected after " + condition.keyword);
+            }
+
+            while (position < query.size() && std::isspace((unsigned char)query[position]))
+            {
+                ++position;
+            }
+
+            if (position < query.size() && (query[position] == '\'' || query[position] == '"'))
+            {
+                const size_t closing = query.find(query[position], position + 1);
+
+                if (closing == std::string::npos)
+                {
+                    throw error("unterminated quote");
+                }
+
+                condition.value = query.substr(position + 1, closing - position - 1);
+                position        = closing + 1;
+            }
+            else
+            {
+                const size_t start = position;
+
+                while (position < query.size() && !isSeparator(position))
+                {
+                    ++position;
+                }
+
+                condition.value = query.substr(start, position - start);
+
+                if (condition.value.empty())
+                {
+                    throw error("value expected after " + condition.keyword);
+                }
+            }
+
+            conditions.push_back(std::move(condition));
+        }
+
+        return conditions;
+    }
+
+    void FitsIndex::Save() const
+    {
+        std::string buffer(magic, sizeof(magic));
+
+        WriteInteger(buffer, _keywords.size(), 4);
+        for (const std::string& keyword : _keywords)
+        {
+            WriteString(buffer, keyword);
+        }
+
+        WriteInteger(buffer, _entries.size(), 8);
+        for (const Entry& entry : _entries)
+        {
+            WriteString(buffer, cbeam::convert::to_string(entry.path));
+            WriteInteger(buffer, (uint64_t)entry.size, 8);
+            WriteInteger(buffer, (uint64_t)entry.modified, 8);
+
+            for (const std::optional<std::string>& value : entry.values)
+            {
+                if (value)
+                {
+                    WriteString(buffer, *value);
+                }
+                else
+                {
+                    WriteInteger(buffer, missingValue, 4);
+                }
+            }
+        }
+
+        const std::filesystem::path path = std::filesystem::path(_indexPath);
+        std::filesystem::path       temp = path;
+        temp += ".tmp";
+
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            file.write(buffer.data(), (std::streamsize)buffer.size());
+            file.close();
+
+            if (!file)
+            {
+                throw std::runtime_error("acrion::imagetools::FitsIndex::Save: cannot write '" + cbeam::convert::to_string(temp.wstring()) + "'");
+            }
+        }
+
+        std::filesystem::rename(temp, path); // replaces the previous index, so that readers never see a partially written file
+    }
+}
@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "acrion_image_tools_export.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace acrion::imagetools::io
+{
+    enum class FitsIndexOperator
+    {
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual
+    };
+
+    /// One condition of a FitsIndex query, e.g. EXPTIME=300. Values are compared numerically if both sides are numbers,
+    /// otherwise as strings, ignoring case. Files that lack the keyword never match.
+    struct FitsIndexCondition
+    {
+        std::string       keyword;
+        FitsIndexOperator op = FitsIndexOperator::Equal;
+        std::string       value;
+    };
+
+    struct FitsIndexUpdateStatistics
+    {
+        size_t files   = 0; ///< FITS files found below the directory
+        size_t read    = 0; ///< new or modified files whose headers were read
+        size_t removed = 0; ///< entries of files that no longer exist
+        size_t failed  = 0; ///< files whose headers could not be read; they are indexed without values and read again when they change
+    };
+
+    /// Selected header keywords of all FITS files below one or more directories, kept in a compact binary index file, so that
+    /// files can be searched by their header values without opening them. Values are taken from the primary header or, if it
+    /// lacks a keyword, from the first extension, which holds the image of tile-compressed (.fz) files.
+    class ACRION_IMAGE_TOOLS_EXPORT FitsIndex
+    {
+    public:
+        struct Entry
+        {
+            std::wstring                            path;
+            long long                               size     = 0;
+            long long                               modified = 0; ///< last write time in ticks of std::filesystem::file_time_type
+            std::vector<std::optional<std::string>> values;       ///< one per keyword, strings without quotes
+            std::vector<double>                     numbers;      ///< values that are numbers, NaN otherwise
+        };
+
+        /// Loads the index file if it exists. If keywords is empty, the keywords stored in the file are used. If they differ
+        /// from the stored ones, the index starts empty, so that the next Update reads all headers again.
+        explicit FitsIndex(const std::wstring& indexPath, const std::vector<std::string>& keywords = {});
+
+        /// Scans the directory recursively for files ending in .fits, .fit, .fts or .fz (each optionally followed by .gz), reads
+        /// the headers of new files and of files whose size or modification time changed on several threads (0 for one per
+        /// core), removes the entries of deleted files below the directory and saves the index file. Entries of other
+        /// directories are kept.
+        FitsIndexUpdateStatistics Update(const std::wstring& directory, int threads = 0);
+
+        /// Returns the paths of the files that satisfy all conditions, in lexicographic order.
+        std::vector<std::wstring> Query(const std::vector<FitsIndexCondition>& conditions) const;
+
+        /// Parses conditions separated by blanks or commas, like "EXPTIME=300 FILTER=R AIRMASS<1.5". Supported operators are
+        /// =, ==, !=, <, <=, > and >=. Values that contain blanks or commas can be enclosed in single or double quotes.
+        static std::vector<FitsIndexCondition> ParseQuery(const std::string& query);
+
+        /// Writes the index file atomically, replacing it only once the new file is complete.
+        void Save() const;
+
+        const std::wstring&             IndexPath() const { return _indexPath; }
+        const std::vector<std::string>& Keywords() const { return _keywords; }
+        const std::vector<Entry>&       Entries() const { return _entries; } ///< sorted by path
+
+    private:
+        void Load(const std::vector<std::string>& keywords);
+
+        std::wstring             _indexPath;
+        std::vector<std::string> _keywords;
+        std::vector<Entry>       _entries;
+    };
+}
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Command line front end of io::FitsIndex:
+//   acrion_fits_index <index file> update <directory> [keyword...]
+//   acrion_fits_index <index file> query "<conditions>"
+
+#include "fits_index.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    namespace io = acrion::imagetools::io;
+
+    const std::string command = argc > 2 ? argv[2] : "";
+
+    if ((command != "update" || argc < 4) && (command != "query" || argc != 4))
+    {
+        std::fprintf(stderr, "usage: %s <index file> update <directory> [keyword...]\n"
+                             "       %s <index file> query \"EXPTIME=300 FILTER=R AIRMASS<1.5\"\n"
+                             "Keywords are only needed to create the index or to change them.\n",
+                     argv[0], argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        const std::filesystem::path indexPath = argv[1];
+        const auto                  start     = std::chrono::steady_clock::now();
+
+        if (command == "update")
+        {
+            const std::vector<std::string>      keywords(argv + 4, argv + argc);
+            io::FitsIndex                       index(indexPath.wstring(), keywords);
+            const io::FitsIndexUpdateStatistics statistics = index.Update(std::filesystem::path(argv[3]).wstring());
+
+            std::fprintf(stderr, "%zu FITS file(s), %zu header(s) read, %zu removed, %zu unreadable in %.0f ms\n", statistics.files, statistics.read,
+                         statistics.removed, statistics.failed, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        else
+        {
+            const io::FitsIndex             index(indexPath.wstring());
+            const auto                      loaded = std::chrono::steady_clock::now();
+            const std::vector<std::wstring> paths  = index.Query(io::FitsIndex::ParseQuery(argv[3]));
+
+            for (const std::wstring& path : paths)
+            {
+                std::printf("%s\n", std::filesystem::path(path).string().c_str());
+            }
+
+            std::fprintf(stderr, "%zu of %zu file(s), loaded in %.1f ms, queried in %.1f ms\n", paths.size(), index.Entries().size(),
+                         std::chrono::duration<double, std::milli>(loaded - start).count(),
+                         std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loaded).count());
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::fprintf(stderr, "%s\n", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
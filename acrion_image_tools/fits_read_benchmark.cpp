@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Measures the throughput of FITS reads through cfitsio's file driver with and without its large block read mode (io::SetFitsReadBlocks):
+//   acrion_fits_read_benchmark [directory] [megabytes]
+// The test images are written to the directory (default: the temporary directory) and removed afterwards. On Linux, each file is
+// evicted from the page cache before a cold read, so that the reads come from the disk.
+
+#include "io.hpp"
+
+#include "acrion/image/bitmap_data.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    namespace io = acrion::imagetools::io;
+
+    // Removes the file from the page cache, which Linux allows without privileges for pages that are not dirty.
+    bool EvictFromPageCache(const std::filesystem::path& path)
+    {
+#ifdef __linux__
+        const int file = open(path.c_str(), O_RDONLY);
+
+        if (file < 0)
+        {
+            return false;
+        }
+
+        fsync(file);
+        const bool bEvicted = posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(file);
+
+        return bEvicted;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    // returns MB/s of returned pixels for the fastest of three reads
+    double Measure(const std::filesystem::path& path, bool bCold, const std::function<size_t()>& read)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        double best = 0.0;
+
+        for (int repetition = 0; repetition < 3; ++repetition)
+        {
+            if (bCold)
+            {
+                EvictFromPageCache(path);
+            }
+
+            const auto   start   = Clock::now();
+            const size_t bytes   = read();
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            best = std::max(best, bytes / seconds / 1e6);
+        }
+
+        return best;
+    }
+
+    size_t Bytes(const std::shared_ptr<acrion::image::Bitmap>& bitmap)
+    {
+        return (size_t)bitmap->Width() * bitmap->Height() * bitmap->Channels() * std::abs(bitmap->Depth());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const std::filesystem::path directory = std::filesystem::path(argc > 1 ? argv[1] : std::filesystem::temp_directory_path()) / "acrion_fits_read_benchmark";
+    const size_t                megabytes = argc > 2 ? (size_t)std::atoll(argv[2]) : 512;
+    const int                   width     = 8192;
+    const int                   height    = (int)std::max<size_t>(64, megabytes * 1024 * 1024 / (width * sizeof(uint16_t)));
+    const std::filesystem::path plain     = directory / "image.fits";
+    const std::filesystem::path packed    = directory / "image.fz";
+    std::string                 warning;
+
+    try
+    {
+        std::filesystem::create_directories(directory);
+
+        {
+            // a smooth background with noise, which compresses like a typical exposure
+            acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+            uint16_t*                           pixels = (uint16_t*)bitmap.Buffer();
+            uint32_t                            random = 1;
+
+            for (size_t i = 0; i < (size_t)width * height; ++i)
+            {
+                random    = random * 1103515245 + 12345;
+                pixels[i] = (uint16_t)(1000 + i % width / 16 + (random >> 26));
+            }
+
+            io::Write(bitmap, plain.wstring(), warning);
+            io::Write(bitmap, packed.wstring(), warning); // Rice compressed
+        }
+
+        io::SetCacheSize(0);
+
+        const bool bCold = EvictFromPageCache(plain);
+
+        struct Case
+        {
+            const char*                  name;
+            const std::filesystem::path& path;
+            std::function<size_t()>      read;
+        };
+
+        const Case cases[] = {
+            {"region 256 px wide", plain, [&] { return Bytes(io::ReadRegion(plain.wstring(), width / 2, 0, 256, height, warning)); }},
+            {"preview 1024 px", plain, [&] { return Bytes(io::ReadPreview(plain.wstring(), 1024, warning)); }},
+            {"Rice compressed image", packed, [&] { return Bytes(io::Read(packed.wstring(), warning)); }},
+            {"plane (memory mapped)", plain, [&] { return Bytes(io::ReadFitsPlane(plain.wstring(), 0, 0)); }},
+            {"binned 4 x 4", plain, [&] { return Bytes(io::ReadReduced(plain.wstring(), 4, io::Reduction::Bin, warning)); }},
+            {"decimated 4 x 4", plain, [&] { return Bytes(io::ReadReduced(plain.wstring(), 4, io::Reduction::Decimate, warning)); }},
+            {"Rice, binned 4 x 4", packed, [&] { return Bytes(io::ReadReduced(packed.wstring(), 4, io::Reduction::Bin, warning)); }},
+        };
+
+        const io::FitsReadBlocks settings[] = {{0, 4}, {1024 * 1024, 4}, {4 * 1024 * 1024, 4}, {16 * 1024 * 1024, 2}};
+        const io::FitsReadBlocks previous   = io::GetFitsReadBlocks();
+
+        std::printf("%d x %d pixels, 16 bit, %s page cache\n", width, height, bCold ? "cold and warm" : "warm (eviction not supported)");
+        std::printf("%-24s %-16s %12s %12s\n", "read", "blocks", bCold ? "cold MB/s" : "", "warm MB/s");
+
+        for (const Case& c : cases)
+        {
+            for (const io::FitsReadBlocks& blocks : settings)
+            {
+                io::SetFitsReadBlocks(blocks);
+
+                const std::string name = blocks.blockSize ? std::to_string(blocks.blockCount) + " x " + std::to_string(blocks.blockSize >> 20) + " MiB" : "stdio";
+                const double      cold = bCold ? Measure(c.path, true, c.read) : 0.0;
+                const double      warm = Measure(c.path, false, c.read);
+
+                std::printf("%-24s %-16s %12.0f %12.0f\n", c.name, name.c_str(), cold, warm);
+            }
+        }
+
+        io::SetFitsReadBlocks(previous);
+    }
+    catch (const std::exception& ex)
+    {
+        std::fprintf(stderr, "%s\n", ex.what());
+        std::filesystem::remove_all(directory);
+        return 1;
+    }
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,697 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "gzip_index.hpp"
+#include "lru_cache.hpp"
+
+#include "fitsio.h"
+
+#include <cbeam/convert/string.hpp>
+#include <cbeam/logging/log_manager.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+// declared in cfitsio's internal header fitsio2.h
+extern "C" int fits_register_driver(char* prefix, int (*init)(void), int (*shutdown)(void), int (*setoptions)(int option), int (*getoptions)(int* options),
+                                    int (*getversion)(int* version), int (*checkfile)(char* urltype, char* infile, char* outfile),
+                                    int (*open)(char* filename, int rwmode, int* driverhandle), int (*create)(char* filename, int* driverhandle),
+                                    int (*truncate)(int driverhandle, LONGLONG filesize), int (*close)(int driverhandle), int (*fremove)(char* filename),
+                                    int (*size)(int driverhandle, LONGLONG* sizex), int (*flush)(int driverhandle), int (*seek)(int driverhandle, LONGLONG offset),
+                                    int (*read)(int driverhandle, void* buffer, long nbytes), int (*write)(int driverhandle, void* buffer, long nbytes));
+
+namespace acrion::imagetools
+{
+    namespace
+    {
+        constexpr size_t   windowSize = 32768;       // the largest distance deflate refers back to
+        constexpr uint64_t span       = 1024 * 1024; // uncompressed bytes between checkpoints, so at most 1 MiB is inflated in vain per read
+        constexpr size_t   inputSize  = 65536;
+
+        // index file format (native byte order, which the byte order mark verifies): magic, byte order mark, size and modification time
+        // of the gzip file, uncompressed size, checkpoint count, checkpoints (uncompressed and compressed offset, bits, window length),
+        // followed by the windows in the order of the checkpoints
+        constexpr char     magic[8]      = {'A', 'I', 'T', 'G', 'Z', 'I', 'X', '1'};
+        constexpr uint32_t byteOrderMark = 0x01020304;
+
+        LruCache<std::wstring, std::shared_ptr<const GzipIndex>>& IndexCache()
+        {
+            static LruCache<std::wstring, std::shared_ptr<const GzipIndex>> cache(256 * 1024 * 1024);
+            return cache;
+        }
+
+        // Moves the unconsumed input to the front of the buffer and appends data from the file. Returns false at the end of the file.
+        bool Refill(std::ifstream& file, z_stream& stream, std::vector<uint8_t>& input)
+        {
+            std::memmove(input.data(), stream.next_in, stream.avail_in);
+            file.read((char*)input.data() + stream.avail_in, (std::streamsize)(input.size() - stream.avail_in));
+
+            stream.next_in = input.data();
+            stream.avail_in += (uInt)file.gcount();
+
+            return file.gcount() > 0;
+        }
+
+        // Concatenated gzip members form a single stream (RFC 1952). Anything else after a member, e.g. the zero padding that
+        // some archives append to whole tape blocks, ends the stream.
+        bool NextMemberFollows(std::ifstream& file, z_stream& stream, std::vector<uint8_t>& input)
+        {
+            while (stream.avail_in < 2 && Refill(file, stream, input))
+            {
+            }
+
+            return stream.avail_in >= 2 && stream.next_in[0] == 0x1f && stream.next_in[1] == 0x8b;
+        }
+
+        void ThrowZlibError(const z_stream& stream, int result, const std::filesystem::path& file)
+        {
+            throw std::runtime_error("acrion::imagetools::GzipIndex: cannot inflate '" + file.string() + "': " + (stream.msg ? stream.msg : zError(result)));
+        }
+    }
+
+    struct GzipReader::State
+    {
+        z_stream             stream{};
+        std::ifstream        file;
+        std::vector<uint8_t> input   = std::vector<uint8_t>(inputSize);
+        std::vector<uint8_t> discard = std::vector<uint8_t>(inputSize);
+        uint64_t             position    = 0;     // offset in the uncompressed stream of the next byte that inflate returns
+        bool                 active      = false; // the stream continues from position
+        bool                 raw         = false; // inflating raw deflate data, started at a checkpoint within a gzip member
+        bool                 initialized = false;
+    };
+
+    std::shared_ptr<const GzipIndex> GzipIndex::Get(const std::filesystem::path& file)
+    {
+        std::error_code sizeError;
+        std::error_code timeError;
+        const uint64_t  size     = std::filesystem::file_size(file, sizeError);
+        const long long modified = (long long)std::filesystem::last_write_time(file, timeError).time_since_epoch().count();
+
+        if (sizeError || timeError)
+        {
+            throw std::runtime_error("acrion::imagetools::GzipIndex: cannot access '" + file.string() + "': " + (sizeError ? sizeError : timeError).message());
+        }
+
+        const std::wstring key = std::filesystem::absolute(file).wstring();
+
+        if (const auto cached = IndexCache().Get(key); cached && (*cached)->_compressedSize == size && (*cached)->_modified == modified)
+        {
+            return *cached;
+        }
+
+        auto index             = std::shared_ptr<GzipIndex>(new GzipIndex());
+        index->_file           = file;
+        index->_compressedSize = size;
+        index->_modified       = modified;
+
+        std::filesystem::path indexFile = file;
+        indexFile += ".zidx";
+
+        if (!index->Load(indexFile))
+        {
+            index->Build();
+
+            try
+            {
+                index->Save(indexFile);
+            }
+            catch (const std::exception& ex)
+            {
+                CBEAM_LOG("acrion image framework: The gzip index is kept in memory only: " + std::string(ex.what()));
+            }
+        }
+
+        IndexCache().Put(key, index, index->_windows.size() + index->_checkpoints.size() * sizeof(Checkpoint));
+
+        return index;
+    }
+
+    const GzipIndex::Checkpoint& GzipIndex::Find(uint64_t offset) const
+    {
+        const auto next = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), offset, [](uint64_t value, const Checkpoint& checkpoint)
+                                           { return value < checkpoint.uncompressed; });
+        return *(next - 1); // the first checkpoint is at offset 0
+    }
+
+    void GzipIndex::Build()
+    {
+        std::ifstream file(_file, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("acrion::imagetools::GzipIndex: cannot open '" + _file.string() + "'");
+        }
+
+        z_stream             stream{};
+        std::vector<uint8_t> input(inputSize);
+        std::vector<uint8_t> window(windowSize); // circular buffer that receives the uncompressed data, so that the last 32 KiB are at hand
+        uint64_t             totalIn  = 0;
+        uint64_t             totalOut = 0;
+        int                  result   = inflateInit2(&stream, 15 + 16); // gzip header and trailer
+
+        if (result != Z_OK)
+        {
+            ThrowZlibError(stream, result, _file);
+        }
+
+        _checkpoints.assign(1, Checkpoint{}); // the start of the file, where inflating begins with the gzip header
+
+        stream.next_in = input.data();
+
+        while (true)
+        {
+            if (stream.avail_in == 0 && !Refill(file, stream, input))
+            {
+                inflateEnd(&stream);
+                throw std::runtime_error("acrion::imagetools::GzipIndex: '" + _file.string() + "' is truncated");
+            }
+
+            if (stream.avail_out == 0)
+            {
+                stream.next_out  = window.data();
+                stream.avail_out = windowSize;
+            }
+
+            totalIn += stream.avail_in;
+            totalOut += stream.avail_out;
+            result = inflate(&stream, Z_BLOCK); // returns at the end of each deflate block
+            totalIn -= stream.avail_in;
+            totalOut -= stream.avail_out;
+
+            if (result == Z_NEED_DICT || result == Z_DATA_ERROR || result == Z_MEM_ERROR)
+            {
+                inflateEnd(&stream);
+                ThrowZlibError(stream, result, _file);
+            }
+
+            if (result == Z_STREAM_END)
+            {
+                if (!NextMemberFollows(file, stream, input))
+                {
+                    break;
+                }
+
+                inflateReset(&stream);
+                continue;
+            }
+
+            // bit 7 of data_type is set at block boundaries and bit 6 after the last block of a member, where no data follows
+            if ((stream.data_type & 128) && !(stream.data_type & 64) && totalOut - _checkpoints.back().uncompressed >= span)
+            {
+                Checkpoint checkpoint;
+                checkpoint.uncompressed = totalOut;
+                checkpoint.compressed   = totalIn;
+                checkpoint.bits         = stream.data_type & 7;
+                checkpoint.window       = _windows.size();
+                checkpoint.windowLength = (uint32_t)windowSize; // the first checkpoint after the start is at least span bytes in
+
+                const size_t end = windowSize - stream.avail_out; // the most recent byte of the circular buffer is at end - 1
+                _windows.insert(_windows.end(), window.begin() + end, window.end());
+                _windows.insert(_windows.end(), window.begin(), window.begin() + end);
+
+                _checkpoints.push_back(checkpoint);
+            }
+        }
+
+        inflateEnd(&stream);
+
+        _uncompressedSize = totalOut;
+    }
+
+    bool GzipIndex::Load(const std::filesystem::path& indexFile)
+    {
+        std::ifstream file(indexFile, std::ios::binary);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        const std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t            position = 0;
+
+        auto read = [&](void* value, size_t bytes)
+        {
+            if (bytes > buffer.size() - position)
+            {
+                throw std::runtime_error("unexpected end of file");
+            }
+
+            std::memcpy(value, buffer.data() + position, bytes);
+            position += bytes;
+        };
+
+        try
+        {
+            char      fileMagic[sizeof(magic)];
+            uint32_t  mark;
+            uint64_t  compressedSize, count;
+            long long modified;
+
+            read(fileMagic, sizeof(fileMagic));
+            read(&mark, sizeof(mark));
+
+            if (!std::equal(std::begin(magic), std::end(magic), fileMagic) || mark != byteOrderMark)
+            {
+                throw std::runtime_error("not a gzip index of this platform");
+            }
+
+            read(&compressedSize, sizeof(compressedSize));
+            read(&modified, sizeof(modified));
+
+            if (compressedSize != _compressedSize || modified != _modified)
+            {
+                return false; // the gzip file changed since the index was built
+            }
+
+            read(&_uncompressedSize, sizeof(_uncompressedSize));
+            read(&count, sizeof(count));
+
+            if (count == 0 || count > (buffer.size() - position) / 24)
+            {
+                throw std::runtime_error("invalid number of checkpoints");
+            }
+
+            _checkpoints.resize(count);
+            uint64_t windowOffset = 0;
+
+            for (Checkpoint& checkpoint : _checkpoints)
+            {
+                uint32_t bits;
+
+                read(&checkpoint.uncompressed, sizeof(checkpoint.uncompressed));
+                read(&checkpoint.compressed, sizeof(checkpoint.compressed));
+                read(&bits, sizeof(bits));
+                read(&checkpoint.windowLength, sizeof(checkpoint.windowLength));
+
+                checkpoint.bits   = (int)(bits & 7);
+                checkpoint.window = windowOffset;
+                windowOffset += checkpoint.windowLength;
+            }
+
+            if (windowOffset != buffer.size() - position)
+            {
+                throw std::runtime_error("invalid window size");
+            }
+
+            _windows.assign(buffer.begin() + (std::ptrdiff_t)position, buffer.end());
+        }
+        catch (const std::exception& ex)
+        {
+            CBEAM_LOG("acrion image framework: Ignoring gzip index '" + indexFile.string() + "': " + ex.what());
+            _checkpoints.clear();
+            _windows.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    void GzipIndex::Save(const std::filesystem::path& indexFile) const
+    {
+        std::string buffer(magic, sizeof(magic));
+
+        auto write = [&](const void* value, size_t bytes)
+        { buffer.append((const char*)value, bytes); };
+
+        const uint64_t count = _checkpoints.size();
+
+        write(&byteOrderMark, sizeof(byteOrderMark));
+        write(&_compressedSize, sizeof(_compressedSize));
+        write(&_modified, sizeof(_modified));
+        write(&_uncompressedSize, sizeof(_uncompressedSize));
+        write(&count, sizeof(count));
+
+        for (const Checkpoint& checkpoint : _checkpoints)
+        {
+            const uint32_t bits = (uint32_t)checkpoint.bits;
+
+            write(&checkpoint.uncompressed, sizeof(checkpoint.uncompressed));
+            write(&checkpoint.compressed, sizeof(checkpoint.compressed));
+            write(&bits, sizeof(bits));
+            write(&checkpoint.windowLength, sizeof(checkpoint.windowLength));
+        }
+
+        write(_windows.data(), _windows.size());
+
+        std::filesystem::path temp = indexFile;
+        temp += ".tmp";
+
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            file.write(buffer.data(), (std::streamsize)buffer.size());
+            file.close();
+
+            if (!file)
+            {
+                std::error_code error;
+                std::filesystem::remove(temp, error);
+                throw std::runtime_error("cannot write '" + indexFile.string() + "'");
+            }
+        }
+
+        std::filesystem::rename(temp, indexFile); // concurrent readers see either no index or a complete one
+    }
+
+    GzipReader::GzipReader(std::shared_ptr<const GzipIndex> index)
+        : _index(std::move(index))
+        , _state(std::make_unique<State>())
+    {
+        _state->file.open(_index->File(), std::ios::binary);
+
+        if (!_state->file)
+        {
+            throw std::runtime_error("acrion::imagetools::GzipReader: cannot open '" + _index->File().string() + "'");
+        }
+
+        if (inflateInit2(&_state->stream, -15) != Z_OK)
+        {
+            throw std::runtime_error("acrion::imagetools::GzipReader: cannot initialize zlib");
+        }
+
+        _state->initialized = true;
+    }
+
+    GzipReader::~GzipReader()
+    {
+        if (_state->initialized)
+        {
+            inflateEnd(&_state->stream);
+        }
+    }
+
+    void GzipReader::Start(const GzipIndex::Checkpoint& checkpoint)
+    {
+        State& state = *_state;
+
+        state.file.clear();
+        state.file.seekg((std::streamoff)(checkpoint.compressed - (checkpoint.bits ? 1 : 0)));
+        state.stream.avail_in = 0;
+        state.stream.next_in  = state.input.data();
+        state.active          = false;
+
+        if (checkpoint.windowLength == 0)
+        {
+            inflateReset2(&state.stream, 15 + 16);
+            state.raw = false;
+        }
+        else
+        {
+            inflateReset2(&state.stream, -15);
+            state.raw = true;
+
+            if (checkpoint.bits)
+            {
+                // the checkpoint lies within this byte; its remaining high bits are the first bits of the next block
+                const int byte = state.file.get();
+
+                if (byte == EOF)
+                {
+                    throw std::runtime_error("acrion::imagetools::GzipReader: '" + _index->File().string() + "' is shorter than its index");
+                }
+
+                inflatePrime(&state.stream, checkpoint.bits, byte >> (8 - checkpoint.bits));
+            }
+
+            inflateSetDictionary(&state.stream, _index->Window(checkpoint), checkpoint.windowLength);
+        }
+
+        state.position = checkpoint.uncompressed;
+        state.active   = true;
+    }
+
+    size_t GzipReader::Inflate(uint8_t* destination, size_t length)
+    {
+        State&    state  = *_state;
+        z_stream& stream = state.stream;
+
+        stream.next_out  = destination;
+        stream.avail_out = (uInt)length;
+
+        while (stream.avail_out > 0)
+        {
+            if (stream.avail_in == 0 && !Refill(state.file, stream, state.input))
+            {
+                throw std::runtime_error("acrion::imagetools::GzipReader: '" + _index->File().string() + "' is truncated");
+            }
+
+            const int result = inflate(&stream, Z_NO_FLUSH);
+
+            if (result == Z_NEED_DICT || result == Z_DATA_ERROR || result == Z_MEM_ERROR)
+            {
+                state.active = false;
+                ThrowZlibError(stream, result, _index->File());
+            }
+
+            if (result == Z_STREAM_END)
+            {
+                // raw inflating leaves the member's trailer (CRC-32 and size) in the input
+                for (size_t trailer = state.raw ? 8 : 0; trailer > 0;)
+                {
+                    if (stream.avail_in == 0 && !Refill(state.file, stream, state.input))
+                    {
+                        break;
+                    }
+
+                    const size_t skip = std::min<size_t>(trailer, stream.avail_in);
+                    stream.next_in += skip;
+                    stream.avail_in -= (uInt)skip;
+                    trailer -= skip;
+                }
+
+                if (!NextMemberFollows(state.file, stream, state.input))
+                {
+                    break;
+                }
+
+                inflateReset2(&stream, 15 + 16);
+                state.raw = false;
+            }
+        }
+
+        const size_t produced = length - stream.avail_out;
+        state.position += produced;
+        return produced;
+    }
+
+    void GzipReader::Read(uint64_t offset, void* destination, size_t length)
+    {
+        if (offset > _index->UncompressedSize() || length > _index->UncompressedSize() - offset)
+        {
+            throw std::out_of_range("acrion::imagetools::GzipReader: read beyond the end of '" + _index->File().string() + "'");
+        }
+
+        const GzipIndex::Checkpoint& checkpoint = _index->Find(offset);
+        State&                       state      = *_state;
+
+        // continue the current stream unless the data lies behind it or a checkpoint is closer
+        if (!state.active || state.position > offset || state.position < checkpoint.uncompressed)
+        {
+            Start(checkpoint);
+        }
+
+        while (state.position < offset)
+        {
+            const size_t skip = (size_t)std::min<uint64_t>(offset - state.position, state.discard.size());
+
+            if (Inflate(state.discard.data(), skip) != skip)
+            {
+                throw std::runtime_error("acrion::imagetools::GzipReader: '" + _index->File().string() + "' is shorter than its index");
+            }
+        }
+
+        for (uint8_t* target = (uint8_t*)destination; length > 0;)
+        {
+            const size_t chunk = std::min<size_t>(length, 1u << 30); // z_stream counts in 32 bit
+
+            if (Inflate(target, chunk) != chunk)
+            {
+                throw std::runtime_error("acrion::imagetools::GzipReader: '" + _index->File().string() + "' is shorter than its index");
+            }
+
+            target += chunk;
+            length -= chunk;
+        }
+    }
+
+    bool IsIndexableGzip(const std::filesystem::path& file)
+    {
+        std::error_code error;
+        return cbeam::convert::to_lower(file.extension().string()) == ".gz" && std::filesystem::is_regular_file(file, error);
+    }
+
+    // cfitsio I/O driver that reads gzip files through GzipReader. cfitsio identifies open files by an integer handle and calls the
+    // driver's open function with the table of drivers locked, so the index is built beforehand by GetIndexedGzipUrl and handed over
+    // through a thread-local variable, as open is called on the same thread.
+    namespace
+    {
+        constexpr char driverPrefix[] = "gzipindex://";
+
+        struct DriverHandle
+        {
+            std::unique_ptr<GzipReader> reader;
+            uint64_t                    position = 0;
+        };
+
+        std::mutex                  driverMutex;
+        std::map<int, DriverHandle> driverHandles; // nodes stay in place, so a handle can be used while others are opened or closed
+        int                         nextDriverHandle = 0;
+
+        thread_local std::shared_ptr<const GzipIndex> indexBeingOpened;
+
+        DriverHandle* FindDriverHandle(int handle)
+        {
+            std::lock_guard<std::mutex> lock(driverMutex);
+            const auto                  found = driverHandles.find(handle);
+            return found == driverHandles.end() ? nullptr : &found->second;
+        }
+
+        int DriverOpen(char* filename, int rwmode, int* handle)
+        {
+            if (rwmode != READONLY)
+            {
+                return READONLY_FILE;
+            }
+
+            try
+            {
+                std::shared_ptr<const GzipIndex> index = std::move(indexBeingOpened);
+
+                if (!index || index->File() != std::filesystem::path(filename))
+                {
+                    index = GzipIndex::Get(filename); // e.g. a second handle opened by cfitsio itself
+                }
+
+                auto reader = std::make_unique<GzipReader>(std::move(index));
+
+                std::lock_guard<std::mutex> lock(driverMutex);
+                *handle                       = nextDriverHandle++;
+                driverHandles[*handle].reader = std::move(reader);
+            }
+            catch (const std::exception& ex)
+            {
+                CBEAM_LOG("acrion image framework: " + std::string(ex.what()));
+                return FILE_NOT_OPENED;
+            }
+
+            return 0;
+        }
+
+        int DriverClose(int handle)
+        {
+            std::lock_guard<std::mutex> lock(driverMutex);
+            driverHandles.erase(handle);
+            return 0;
+        }
+
+        // the handles come from cfitsio, which only passes those that DriverOpen returned, unless its table of open files is corrupt
+        int DriverSize(int handle, LONGLONG* size)
+        {
+            const DriverHandle* driverHandle = FindDriverHandle(handle);
+
+            if (!driverHandle)
+            {
+                return READ_ERROR;
+            }
+
+            *size = (LONGLONG)driverHandle->reader->Index().UncompressedSize();
+            return 0;
+        }
+
+        int DriverSeek(int handle, LONGLONG offset)
+        {
+            DriverHandle* driverHandle = FindDriverHandle(handle);
+
+            if (!driverHandle)
+            {
+                return SEEK_ERROR;
+            }
+
+            driverHandle->position = (uint64_t)offset;
+            return 0;
+        }
+
+        int DriverRead(int handle, void* buffer, long bytes)
+        {
+            DriverHandle* driverHandle = FindDriverHandle(handle);
+
+            if (!driverHandle)
+            {
+                return READ_ERROR;
+            }
+
+            try
+            {
+                driverHandle->reader->Read(driverHandle->position, buffer, (size_t)bytes);
+                driverHandle->position += (uint64_t)bytes;
+            }
+            catch (const std::out_of_range&)
+            {
+                return END_OF_FILE;
+            }
+            catch (const std::exception& ex)
+            {
+                CBEAM_LOG("acrion image framework: " + std::string(ex.what()));
+                return READ_ERROR;
+            }
+
+            return 0;
+        }
+
+        void RegisterDriver()
+        {
+            static std::once_flag registered;
+
+            std::call_once(registered, []
+                           {
+                fits_init_cfitsio(); // registers the built-in drivers, which must precede ours
+
+                const int status = fits_register_driver((char*)driverPrefix, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, DriverOpen, nullptr, nullptr, DriverClose,
+                                                        nullptr, DriverSize, nullptr, DriverSeek, DriverRead, nullptr);
+
+                if (status)
+                {
+                    throw std::runtime_error("acrion::imagetools: cannot register the gzip index driver with cfitsio, status " + std::to_string(status));
+                } });
+        }
+    }
+
+    std::string GetIndexedGzipUrl(const std::filesystem::path& file)
+    {
+        RegisterDriver();
+
+        indexBeingOpened = GzipIndex::Get(file);
+
+        return driverPrefix + file.string();
+    }
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace acrion::imagetools
+{
+    /// Checkpoints in the deflate stream of a gzip file, so that data at any offset of the uncompressed stream can be inflated
+    /// starting from the preceding checkpoint instead of the beginning of the file (the method of zlib's examples/zran.c).
+    /// Each checkpoint stores the 32 KiB of uncompressed data that precede it, which deflate may refer to.
+    class GzipIndex
+    {
+    public:
+        struct Checkpoint
+        {
+            uint64_t uncompressed = 0;  ///< offset in the uncompressed stream
+            uint64_t compressed   = 0;  ///< offset of the first byte of the file that lies entirely after the checkpoint
+            int      bits         = 0;  ///< number of bits of the preceding byte that belong to the data after the checkpoint
+            uint64_t window       = 0;  ///< offset of the dictionary in the window buffer
+            uint32_t windowLength = 0;  ///< 0 at the start of the gzip stream, where inflating starts with the gzip header
+        };
+
+        /// Returns the index of the file, from memory, from the index file next to it (<file>.zidx), or built by inflating the
+        /// file once. A new index is saved next to the file if the directory is writable. Indexes whose file changed are rebuilt.
+        static std::shared_ptr<const GzipIndex> Get(const std::filesystem::path& file);
+
+        const std::filesystem::path&   File() const { return _file; }
+        uint64_t                       UncompressedSize() const { return _uncompressedSize; }
+        const std::vector<Checkpoint>& Checkpoints() const { return _checkpoints; }
+        const uint8_t*                 Window(const Checkpoint& checkpoint) const { return _windows.data() + checkpoint.window; }
+
+        /// The last checkpoint at or before the given offset of the uncompressed stream.
+        const Checkpoint& Find(uint64_t offset) const;
+
+    private:
+        GzipIndex() = default;
+
+        void Build();
+        bool Load(const std::filesystem::path& indexFile);
+        void Save(const std::filesystem::path& indexFile) const;
+
+        std::filesystem::path   _file;
+        uint64_t                _compressedSize   = 0;
+        long long               _modified         = 0;
+        uint64_t                _uncompressedSize = 0;
+        std::vector<Checkpoint> _checkpoints;
+        std::vector<uint8_t>    _windows;
+    };
+
+    /// Reads arbitrary ranges of the uncompressed stream of a gzip file with the help of its index. Consecutive reads continue
+    /// inflating where the previous one stopped. Not thread-safe; use one reader per thread.
+    class GzipReader
+    {
+    public:
+        explicit GzipReader(std::shared_ptr<const GzipIndex> index);
+        ~GzipReader();
+
+        GzipReader(const GzipReader&)            = delete;
+        GzipReader& operator=(const GzipReader&) = delete;
+
+        /// Copies length bytes starting at offset into destination; throws if they exceed the uncompressed size.
+        void Read(uint64_t offset, void* destination, size_t length);
+
+        const GzipIndex& Index() const { return *_index; }
+
+    private:
+        void   Start(const GzipIndex::Checkpoint& checkpoint);
+        size_t Inflate(uint8_t* destination, size_t length);
+
+        struct State;
+
+        std::shared_ptr<const GzipIndex> _index;
+        std::unique_ptr<State>           _state;
+    };
+
+    /// True for local files ending in .gz, which cfitsio would otherwise uncompress completely into memory when opening them.
+    bool IsIndexableGzip(const std::filesystem::path& file);
+
+    /// Returns the name under which cfitsio opens the given gzip-compressed FITS file through its index, so that only the parts
+    /// that cfitsio actually reads are inflated. Builds the index first if necessary.
+    std::string GetIndexedGzipUrl(const std::filesystem::path& file);
+}
@@ -25,19 +25,73 @@ along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 
 #include "io.hpp"
 
+#include "display_range.hpp"
 #include "fits.hpp"
+#include "lru_cache.hpp"
+#include "parallel.hpp"
+#include "quantum.hpp"
+#include "reduce.hpp"
 
 #include <cbeam/convert/string.hpp>
 #include <cbeam/logging/log_manager.hpp>
 #include <cbeam/platform/system_folders.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "imagemagick.hpp" // needs to be included after <cassert>, otherwise assert macro is messed up
 
 namespace acrion::imagetools::io
 {
+    namespace
+    {
+        constexpr size_t      exportBandSize = 16 * 1024 * 1024;
+        std::atomic<ReadMode> readMode{ReadMode::PixelCache};
+
+        std::mutex             fitsCompressionMutex;
+        FitsCompressionOptions fitsCompression;
+
+        struct CacheKey
+        {
+            std::filesystem::path path; // canonical
+            uintmax_t             size     = 0;
+            long long             modified = 0;
+            int                   hdu      = -1; // -1 for images returned by Read, otherwise the HDU and plane of ReadFitsPlane
+            long long             plane    = 0;
+
+            bool operator==(const CacheKey& other) const = default;
+        };
+
+        struct CacheKeyHash
+        {
+            size_t operator()(const CacheKey& key) const
+            {
+                return std::filesystem::hash_value(key.path) ^ (std::hash<uintmax_t>()(key.size) * 31) ^ (std::hash<long long>()(key.modified) * 131)
+                     ^ (std::hash<int>()(key.hdu) * 1031) ^ (std::hash<long long>()(key.plane) * 8191);
+            }
+        };
+
+        struct CachedImage
+        {
+            std::shared_ptr<const acrion::image::Bitmap> bitmap;
+            std::string                                  warning;
+        };
+
+        LruCache<CacheKey, CachedImage, CacheKeyHash>& GetImageCache()
+        {
+            static LruCache<CacheKey, CachedImage, CacheKeyHash> cache(512 * 1024 * 1024);
+            return cache;
+        }
+    }
+
     void ensure_magick_initialized()
     {
         static bool once = []{
@@ -69,6 +123,15 @@ namespace acrion::imagetools::io
     void CopyFromImageMagickData(const acrion::image::Bitmap& bitmap, const U* pixels)
     {
         T* dest = (T*)bitmap.Buffer();
+
+        if constexpr (std::is_same_v<U, uint32_t>) // Q32 without HDRI
+        {
+            const size_t rowSamples = (size_t)bitmap.Width() * bitmap.Channels();
+
+            parallel::ForEachBand(bitmap.Height(), rowSamples * sizeof(T), [&](size_t firstRow, size_t rowCount)
+                                  { ConvertQuantum(pixels + firstRow * rowSamples, dest + firstRow * rowSamples, rowCount * rowSamples); });
+        }
+        else
         {
 #ifdef DBG
     #if defined(__clang__) || defined(__GNUC__)
@@ -91,7 +154,202 @@ namespace acrion::imagetools::io
         }
     }
 
-    std::shared_ptr<acrion::image::Bitmap> Read(const std::wstring& pathToImage, std::string& warning)
+    // Calls an ImageMagick read operation, storing a warning in `warning` and converting errors to std::runtime_error
+    template <typename Operation>
+    void InvokeImageMagick(Operation&& operation, std::string& warning)
+    {
+        try
+        {
+            operation();
+            CBEAM_LOG("acrion image framework: Successfully read the image");
+        }
+        catch (Magick::Warning& warningException)
+        {
+            warning = warningException.what();
+            CBEAM_LOG("acrion image framework: Successfully read the image, but ImageMagick reported a warning: '" + warning + "'");
+        }
+        catch (std::exception& errorException)
+        {
+            const std::string error(errorException.what());
+            CBEAM_LOG("acrion image framework: " + error);
+            throw std::runtime_error("Failed to read the image: '" + error + "'");
+        }
+        catch (...)
+        {
+            throw std::runtime_error("Unknown error while reading image");
+        }
+    }
+
+    bool IsFits(const std::filesystem::path& path)
+    {
+        std::string extension = cbeam::convert::to_lower(path.extension().string());
+
+        if (extension == ".gz") // gzip-compressed FITS files are read by cfitsio as well
+        {
+            extension = cbeam::convert::to_lower(path.stem().extension().string());
+        }
+
+        return extension == ".fits" || extension == ".fit" || extension == ".fz"; // .fz is the extension of tile-compressed FITS files written by fpack
+    }
+
+    // Returns the ImageMagick channel map that yields the same sample layout as a Magick::Pixels view, or an empty string if there is none.
+    std::string GetExportMap(const Magick::Image& img)
+    {
+        const bool cmyk = img.colorSpace() == Magick::CMYKColorspace;
+
+        switch (img.channels())
+        {
+        case 1:
+            return "R"; // ImageMagick addresses the gray channel also as red channel
+        case 2:
+            return "RA";
+        case 3:
+            return "RGB";
+        case 4:
+            return cmyk ? "CMYK" : "RGBA";
+        case 5:
+            return cmyk ? "CMYKA" : "";
+        default:
+            return "";
+        }
+    }
+
+    // Lets ImageMagick write the pixels of the given image region directly into the bitmap buffer, converting them to the bitmap's storage type.
+    // The region is processed in bands of rows, so ImageMagick never needs to materialise more than one band in a temporary buffer.
+    void ExportPixels(Magick::Image& img, ssize_t x, ssize_t y, const acrion::image::Bitmap& bitmap, const std::string& map)
+    {
+        Magick::StorageType storageType;
+
+        switch (bitmap.Depth())
+        {
+        case 1:
+            storageType = Magick::CharPixel;
+            break;
+        case 2:
+            storageType = Magick::ShortPixel;
+            break;
+        case 4:
+            storageType = Magick::LongPixel;
+            break;
+        default:
+            throw std::runtime_error("acrion::imagetools::io::ExportPixels(): Unsupported image depth " + std::to_string(bitmap.Depth()));
+        }
+
+        const size_t height   = bitmap.Height();
+        const size_t rowBytes = (size_t)bitmap.Width() * bitmap.Channels() * bitmap.Depth();
+        const size_t bandRows = std::max<size_t>(1, exportBandSize / rowBytes);
+        uint8_t*     dest     = (uint8_t*)bitmap.Buffer();
+
+        for (size_t row = 0; row < height; row += bandRows)
+        {
+            const size_t rows = std::min(bandRows, height - row);
+            img.write(x, y + (ssize_t)row, bitmap.Width(), rows, map, storageType, dest + row * rowBytes);
+        }
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> CopyFromImageMagick(Magick::Image& img)
+    {
+        CBEAM_LOG("acrion image framework: Depth    = " + std::to_string(img.depth())); // 8, 16, 32, 64
+
+        const int channels = static_cast<int>(img.channels());
+        const int width    = static_cast<int>(img.columns());
+        const int height   = static_cast<int>(img.rows());
+
+        CBEAM_LOG("acrion image framework: Width    = " + std::to_string(width));
+        CBEAM_LOG("acrion image framework: Height   = " + std::to_string(height));
+        CBEAM_LOG("acrion image framework: Channels = " + std::to_string(channels));
+
+        if (img.depth() != 8 && img.depth() != 16 && img.depth() != 32 && img.depth() != 64)
+        {
+            throw std::runtime_error("acrion::imagetools::io::Read(): Unsupported ImageMagick image depth " + std::to_string(img.depth()));
+        }
+
+        std::shared_ptr<acrion::image::Bitmap> bitmap = std::make_shared<acrion::image::Bitmap>(width, height, channels, img.depth() / 8);
+
+        // ImageMagick scales to 64 bit storage by replicating the Q32 value, which would differ from the pixel cache path
+        const std::string exportMap = readMode == ReadMode::DirectExport && img.depth() != 64 ? GetExportMap(img) : std::string();
+
+        if (!exportMap.empty())
+        {
+            ExportPixels(img, 0, 0, *bitmap, exportMap);
+            CBEAM_LOG("acrion image framework: Successfully exported image from ImageMagick");
+            ApplyDisplayRange(*bitmap);
+            return bitmap;
+        }
+
+        // img.modifyImage();
+        Magick::Pixels         view(img);
+        const Magick::Quantum* pixels = view.getConst(0, 0, width, height);
+
+        if (!pixels)
+        {
+            throw std::runtime_error("Unknown error in scope of Magick::Pixels::getConst");
+        }
+
+        switch (img.depth())
+        {
+        case 8:
+        {
+            CopyFromImageMagickData<uint8_t>(*bitmap, pixels);
+            break;
+        }
+        case 16:
+        {
+            CopyFromImageMagickData<uint16_t>(*bitmap, pixels);
+            break;
+        }
+        case 32:
+        {
+            CopyFromImageMagickData<uint32_t>(*bitmap, pixels);
+            break;
+        }
+        case 64:
+        {
+            CopyFromImageMagickData<uint64_t>(*bitmap, pixels);
+            break;
+        }
+        default:
+            throw std::runtime_error("acrion::image::Bitmap::Read(): Unsupported image depth " + std::to_string(img.modulusDepth()) + " bits.");
+        }
+
+        CBEAM_LOG("acrion image framework: Successfully copied image from ImageMagick buffer");
+        ApplyDisplayRange(*bitmap);
+        return bitmap;
+    }
+
+    void SetReadMode(ReadMode mode)
+    {
+        readMode = mode;
+    }
+
+    ReadMode GetReadMode()
+    {
+        return readMode;
+    }
+
+    void SetFitsCompression(const FitsCompressionOptions& options)
+    {
+        if (options.ditherSeed < 0 || options.ditherSeed > 10000)
+        {
+            throw std::runtime_error("acrion::imagetools::io::SetFitsCompression: the dither seed must be between 1 and 10000, or 0");
+        }
+
+        if (options.quantizeLevel < 0.0f || options.hcompressScale < 0.0f || options.tileRows < 0)
+        {
+            throw std::runtime_error("acrion::imagetools::io::SetFitsCompression: the quantize level, Hcompress scale and tile rows must not be negative");
+        }
+
+        std::lock_guard<std::mutex> lock(fitsCompressionMutex);
+        fitsCompression = options;
+    }
+
+    FitsCompressionOptions GetFitsCompression()
+    {
+        std::lock_guard<std::mutex> lock(fitsCompressionMutex);
+        return fitsCompression;
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadUncached(const std::wstring& pathToImage, std::string& warning)
     {
         ensure_magick_initialized();
         std::filesystem::path inputPath(pathToImage);
@@ -101,108 +359,505 @@ namespace acrion::imagetools::io
         }
         CBEAM_LOG(L"acrion image framework: Reading '" + pathToImage + L"'...");
 
-        const std::string extension = cbeam::convert::to_lower(inputPath.extension().string());
-        const bool        bFits     = extension == ".fits" || extension == ".fit";
+        const bool bFits = IsFits(inputPath);
 
 #pragma warning(suppress : 4244)
         std::string utf8(inputPath.string()); // TODO pin_ptr<Byte> byteArrayPtr = &(gcnew UTF8Encoding())->GetBytes(s + "\0")[0];
 
         if (bFits)
         {
-            return std::make_shared<acrion::image::Bitmap>(ReadFits(utf8));
+            return ReadFits(utf8);
         }
         else
         {
             Magick::Image img;
+            InvokeImageMagick([&]
+                              { img.read(utf8); },
+                              warning);
+
+            return CopyFromImageMagick(img);
+
+            // if (channels > 1 && !ContainsColors())
+            // {
+            //     // TODO: reduce channels to 1
+            // }
+        }
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFromMemory(const void* data, size_t size, const std::string& formatHint, std::string& warning)
+    {
+        ensure_magick_initialized();
+
+        if (!data || size == 0)
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadFromMemory: the buffer is empty");
+        }
 
-            try
+        std::string format = cbeam::convert::to_lower(formatHint);
+        if (!format.empty() && format.front() == '.')
+        {
+            format.erase(0, 1);
+        }
+
+        CBEAM_LOG("acrion image framework: Reading " + std::to_string(size) + " bytes from memory" + (format.empty() ? std::string() : " as " + format) + "...");
+
+        if (format == "fits" || format == "fit" || format == "fts" || (format.empty() && IsFitsData(data, size)))
+        {
+            return ReadFitsFromMemory(data, size);
+        }
+
+        // Magick::Blob always copies (or takes ownership of) its data, so the image is decoded with MagickCore directly from the caller's buffer
+        Magick::Image img;
+        InvokeImageMagick([&]
+                          {
+                              MagickCore::ImageInfo*     imageInfo = MagickCore::AcquireImageInfo();
+                              MagickCore::ExceptionInfo* exception = MagickCore::AcquireExceptionInfo();
+
+                              if (!format.empty())
+                              {
+                                  // the "format:" prefix makes ImageMagick use the given coder instead of guessing it from the data
+                                  MagickCore::CopyMagickString(imageInfo->filename, (format + ":").c_str(), sizeof(imageInfo->filename));
+                              }
+
+                              MagickCore::Image* image = MagickCore::BlobToImage(imageInfo, data, size, exception);
+                              MagickCore::DestroyImageInfo(imageInfo);
+
+                              if (image)
+                              {
+                                  img = Magick::Image(image);
+                              }
+
+                              // throws Magick::Warning or Magick::Error, if ImageMagick reported anything
+                              try
+                              {
+                                  Magick::throwException(exception);
+                              }
+                              catch (...)
+                              {
+                                  MagickCore::DestroyExceptionInfo(exception);
+                                  throw;
+                              }
+                              MagickCore::DestroyExceptionInfo(exception);
+
+                              if (!image)
+                              {
+                                  throw std::runtime_error("ImageMagick could not decode the buffer");
+                              } },
+                          warning);
+
+        return CopyFromImageMagick(img);
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadRegion(const std::wstring& pathToImage, int x, int y, int width, int height, std::string& warning)
+    {
+        ensure_magick_initialized();
+        std::filesystem::path inputPath(pathToImage);
+        if (!std::filesystem::exists(pathToImage))
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadRegion: input file does not exist: '" + inputPath.string() + "'");
+        }
+
+        if (x < 0 || y < 0 || width <= 0 || height <= 0)
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadRegion: invalid region " + std::to_string(width) + "x" + std::to_string(height) + "+" + std::to_string(x) + "+" + std::to_string(y));
+        }
+
+        CBEAM_LOG(L"acrion image framework: Reading region of '" + pathToImage + L"'...");
+
+        if (IsFits(inputPath))
+        {
+            return ReadFitsRegion(inputPath, x, y, width, height);
+        }
+
+        // ImageMagick crops a region that exceeds the image to the intersection, so the region is checked against the size in the header
+        const std::string geometry = std::to_string(width) + "x" + std::to_string(height) + "+" + std::to_string(x) + "+" + std::to_string(y);
+        const ImageInfo   info     = Probe(pathToImage);
+
+        if (info.width < (long long)x + width || info.height < (long long)y + height)
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadRegion: region " + geometry + " exceeds the image size " + std::to_string(info.width) + "x" + std::to_string(info.height));
+        }
+
+        // The extract geometry in the file name is applied by coders that can decode a region (e.g. the raw formats),
+        // and otherwise by ImageMagick cropping the image right after decoding.
+        Magick::Image img;
+        InvokeImageMagick([&]
+                          { img.read(inputPath.string() + "[" + geometry + "]"); },
+                          warning);
+
+        if (img.columns() == (size_t)width && img.rows() == (size_t)height)
+        {
+            return CopyFromImageMagick(img);
+        }
+
+        if (img.columns() < (size_t)x + width || img.rows() < (size_t)y + height)
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadRegion: ImageMagick decoded " + std::to_string(img.columns()) + "x" + std::to_string(img.rows()) + " pixels for the region " + geometry);
+        }
+
+        // The extract hint was ignored and the whole frame has been decoded, so at least only the region is exported, band by band
+        const std::string exportMap = img.depth() != 64 ? GetExportMap(img) : std::string();
+
+        if (exportMap.empty())
+        {
+            img.crop(Magick::Geometry(width, height, x, y));
+            return CopyFromImageMagick(img);
+        }
+
+        auto bitmap = std::make_shared<acrion::image::Bitmap>(width, height, static_cast<int>(img.channels()), static_cast<int>(img.depth() / 8));
+        ExportPixels(img, x, y, *bitmap, exportMap);
+        ApplyDisplayRange(*bitmap);
+        return bitmap;
+    }
+
+    // Decodes the JPEG thumbnail that cameras embed in the EXIF profile. Returns false if there is none.
+    bool ReadExifThumbnail(const Magick::Image& img, Magick::Image& thumbnail)
+    {
+        try
+        {
+            const std::string offset = img.attribute("exif:JPEGInterchangeFormat");
+            const std::string length = img.attribute("exif:JPEGInterchangeFormatLength");
+
+            if (offset.empty() || length.empty())
             {
-                img.read(utf8);
-                CBEAM_LOG("acrion image framework: Successfully read the image");
+                return false;
             }
-            catch (Magick::Warning& warningException)
+
+            // the offset is relative to the TIFF header, which follows the APP1 identifier if ImageMagick kept it
+            const Magick::Blob exif       = img.profile("exif");
+            const char*        data       = (const char*)exif.data();
+            const size_t       tiffHeader = exif.length() >= 6 && std::memcmp(data, "Exif\0\0", 6) == 0 ? 6 : 0;
+            const size_t       begin      = tiffHeader + std::stoul(offset);
+            const size_t       size       = std::stoul(length);
+
+            if (size == 0 || begin + size > exif.length())
             {
-                warning = warningException.what();
-                CBEAM_LOG("acrion image framework: Successfully read the image, but ImageMagick reported a warning: '" + warning + "'");
+                return false;
             }
-            catch (std::exception& errorException)
+
+            thumbnail.read(Magick::Blob(data + begin, size));
+            return true;
+        }
+        catch (const std::exception& ex)
+        {
+            CBEAM_LOG("acrion image framework: Ignoring EXIF thumbnail: " + std::string(ex.what()));
+            return false;
+        }
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadPreview(const std::wstring& pathToImage, int maxEdge, std::string& warning)
+    {
+        ensure_magick_initialized();
+        std::filesystem::path inputPath(pathToImage);
+        if (!std::filesystem::exists(pathToImage))
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadPreview: input file does not exist: '" + inputPath.string() + "'");
+        }
+
+        if (maxEdge <= 0)
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadPreview: invalid preview size " + std::to_string(maxEdge));
+        }
+
+        CBEAM_LOG(L"acrion image framework: Reading preview of '" + pathToImage + L"'...");
+
+        if (IsFits(inputPath))
+        {
+            return std::make_shared<acrion::image::Bitmap>(ReadFitsPreview(inputPath, maxEdge));
+        }
+
+        const std::string extension = cbeam::convert::to_lower(inputPath.extension().string());
+        const bool        jpeg      = extension == ".jpg" || extension == ".jpeg";
+        const bool        tiff      = extension == ".tif" || extension == ".tiff";
+        const std::string path      = inputPath.string();
+        size_t            frame     = 0;
+        Magick::Image     img;
+        bool              decoded = false;
+
+        if (jpeg || tiff)
+        {
+            Magick::Image header;
+            InvokeImageMagick([&]
+                              { header.ping(path); },
+                              warning);
+
+            Magick::Image thumbnail;
+            if (ReadExifThumbnail(header, thumbnail) && std::max(thumbnail.columns(), thumbnail.rows()) >= (size_t)maxEdge)
             {
-                const std::string error(errorException.what());
-                CBEAM_LOG("acrion image framework: " + error);
-                throw std::runtime_error("Failed to read the image: '" + error + "'");
+                img     = thumbnail;
+                decoded = true;
             }
-            catch (...)
+        }
+
+        if (!decoded && tiff)
+        {
+            // Further frames of a TIFF file may be reduced resolution versions of the first one. Use the smallest that is still large enough.
+            std::vector<Magick::Image> frames;
+            InvokeImageMagick([&]
+                              { Magick::pingImages(&frames, path); },
+                              warning);
+
+            for (size_t i = 1; i < frames.size(); ++i)
             {
-                throw std::runtime_error("Unknown error while reading image");
+                const size_t edge = std::max(frames[i].columns(), frames[i].rows());
+
+                if (edge >= (size_t)maxEdge && edge < std::max(frames[frame].columns(), frames[frame].rows()))
+                {
+                    frame = i;
+                }
             }
+        }
 
-            CBEAM_LOG("acrion image framework: Depth    = " + std::to_string(img.depth())); // 8, 16, 32, 64
+        if (!decoded)
+        {
+            if (jpeg)
+            {
+                // lets libjpeg scale the DCT blocks by 1/2, 1/4 or 1/8 while keeping the image at least this large
+                img.defineValue("jpeg", "size", std::to_string(maxEdge) + "x" + std::to_string(maxEdge));
+            }
 
-            const int channels = static_cast<int>(img.channels());
-            const int width    = static_cast<int>(img.columns());
-            const int height   = static_cast<int>(img.rows());
+            InvokeImageMagick([&]
+                              { img.read(path + "[" + std::to_string(frame) + "]"); },
+                              warning);
+        }
 
-            CBEAM_LOG("acrion image framework: Width    = " + std::to_string(width));
-            CBEAM_LOG("acrion image framework: Height   = " + std::to_string(height));
-            CBEAM_LOG("acrion image framework: Channels = " + std::to_string(channels));
-            {
-                // img.modifyImage();
-                Magick::Pixels         view(img);
-                const Magick::Quantum* pixels = view.getConst(0, 0, width, height);
+        if (std::max(img.columns(), img.rows()) > (size_t)maxEdge)
+        {
+            img.thumbnail(Magick::Geometry(maxEdge, maxEdge));
+        }
 
-                using namespace Magick;
+        if (img.colorSpace() == Magick::CMYKColorspace)
+        {
+            img.colorSpace(Magick::sRGBColorspace);
+        }
 
-                if (!pixels)
-                {
-                    throw std::runtime_error("Unknown error in scope of Magick::Pixels::getConst");
-                }
+        // exporting as CharPixel scales to 8 bit, independent of the depth of the decoded image
+        const bool gray   = img.channels() - (img.alpha() ? 1 : 0) == 1;
+        auto       bitmap = std::make_shared<acrion::image::Bitmap>(static_cast<int>(img.columns()), static_cast<int>(img.rows()), gray ? 1 : 3, 1);
+        ExportPixels(img, 0, 0, *bitmap, gray ? "R" : "RGB");
+        return bitmap;
+    }
 
-                if (img.depth() != 8 && img.depth() != 16 && img.depth() != 32 && img.depth() != 64)
-                {
-                    throw std::runtime_error("acrion::imagetools::io::Read(): Unsupported ImageMagick image depth " + std::to_string(img.depth()));
-                }
+    std::shared_ptr<acrion::image::Bitmap> ReadReduced(const std::wstring& pathToImage, int factor, Reduction reduction, std::string& warning)
+    {
+        std::filesystem::path inputPath(pathToImage);
+        if (!std::filesystem::exists(pathToImage))
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadReduced: input file does not exist: '" + inputPath.string() + "'");
+        }
 
-                std::shared_ptr<acrion::image::Bitmap> bitmap = std::make_shared<acrion::image::Bitmap>(width, height, channels, img.depth() / 8);
-                switch (img.depth())
-                {
-                case 8:
-                {
-                    CopyFromImageMagickData<uint8_t>(*bitmap, pixels);
-                    break;
-                }
-                case 16:
-                {
-                    CopyFromImageMagickData<uint16_t>(*bitmap, pixels);
-                    break;
-                }
-                case 32:
-                {
-                    CopyFromImageMagickData<uint32_t>(*bitmap, pixels);
-                    break;
-                }
-                case 64:
-                {
-                    CopyFromImageMagickData<uint64_t>(*bitmap, pixels);
-                    break;
-                }
-                default:
-                    throw std::runtime_error("acrion::image::Bitmap::Read(): Unsupported image depth " + std::to_string(img.modulusDepth()) + " bits.");
-                }
+        if (factor <= 0)
+        {
+            throw std::runtime_error("acrion::imagetools::io::ReadReduced: invalid factor " + std::to_string(factor));
+        }
 
-                CBEAM_LOG("acrion image framework: Successfully copied image from ImageMagick buffer");
-                return bitmap;
-            }
+        CBEAM_LOG(L"acrion image framework: Reading '" + pathToImage + L"' reduced by " + std::to_wstring(factor) + L"...");
 
-            // if (channels > 1 && !ContainsColors())
-            // {
-            //     // TODO: reduce channels to 1
-            // }
+        if (IsFits(inputPath))
+        {
+            return ReadFitsReduced(inputPath, factor, reduction);
+        }
+
+        auto bitmap = ReduceBitmap(*Read(pathToImage, warning), factor, reduction);
+        ApplyDisplayRange(*bitmap);
+        return bitmap;
+    }
+
+    ImageInfo Probe(const std::wstring& pathToImage)
+    {
+        ensure_magick_initialized();
+        std::filesystem::path inputPath(pathToImage);
+        if (!std::filesystem::exists(pathToImage))
+        {
+            throw std::runtime_error("acrion::imagetools::io::Probe: input file does not exist: '" + inputPath.string() + "'");
+        }
+
+        if (IsFits(inputPath))
+        {
+            return ProbeFits(inputPath);
+        }
+
+        // ping only decodes the header and does not allocate the pixel cache
+        Magick::Image img;
+        std::string   warning;
+        InvokeImageMagick([&]
+                          { img.ping(inputPath.string()); },
+                          warning);
+
+        ImageInfo info;
+        info.width    = static_cast<int>(img.columns());
+        info.height   = static_cast<int>(img.rows());
+        info.channels = static_cast<int>(img.channels());
+        info.depth    = static_cast<int>(img.depth() / 8);
+        return info;
+    }
+
+    size_t GetBitmapSize(const acrion::image::Bitmap& bitmap)
+    {
+        return (size_t)bitmap.Width() * bitmap.Height() * bitmap.Channels() * std::abs(bitmap.Depth());
+    }
+
+    // Returns a deep copy including the brightness range for display, so that the copy can be modified independently
+    std::shared_ptr<acrion::image::Bitmap> CopyBitmap(const acrion::image::Bitmap& bitmap)
+    {
+        auto copy = std::make_shared<acrion::image::Bitmap>(bitmap.Width(), bitmap.Height(), bitmap.Channels(), bitmap.Depth());
+        std::memcpy(copy->Buffer(), bitmap.Buffer(), GetBitmapSize(bitmap));
+
+        const auto container = (acrion::image::BitmapContainer)bitmap;
+        copy->SetBrightnessRangeForDisplay(container.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::minBrightnessKey)),
+                                           container.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::maxBrightnessKey)));
+
+        if (const auto* scaled = dynamic_cast<const ScaledBitmap*>(&bitmap))
+        {
+            return std::make_shared<ScaledBitmap>(*copy, scaled->Scale(), scaled->Zero());
+        }
+
+        return copy;
+    }
+
+    CacheKey MakeCacheKey(const std::filesystem::path& path)
+    {
+        CacheKey key;
+        key.path     = std::filesystem::canonical(path);
+        key.size     = std::filesystem::file_size(key.path);
+        key.modified = std::filesystem::last_write_time(key.path).time_since_epoch().count();
+        return key;
+    }
+
+    void AddToCache(const CacheKey& key, const std::shared_ptr<acrion::image::Bitmap>& bitmap, const std::string& warning)
+    {
+        auto&        cache = GetImageCache();
+        const size_t size  = GetBitmapSize(*bitmap);
+
+        // entries of previous versions of the file are outdated
+        cache.EraseIf([&](const CacheKey& cachedKey)
+                      { return cachedKey.path == key.path && (cachedKey.size != key.size || cachedKey.modified != key.modified); });
+
+        // The cache keeps a copy of its own, because callers may modify the returned bitmap in place
+        if (size <= cache.GetByteBudget())
+        {
+            cache.Put(key, CachedImage{CopyBitmap(*bitmap), warning}, size);
+        }
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> Read(const std::wstring& pathToImage, std::string& warning)
+    {
+        auto& cache = GetImageCache();
+
+        if (cache.GetByteBudget() == 0 || !std::filesystem::exists(pathToImage))
+        {
+            return ReadUncached(pathToImage, warning);
+        }
+
+        const CacheKey key = MakeCacheKey(pathToImage);
+
+        if (const auto cached = cache.Get(key))
+        {
+            CBEAM_LOG(L"acrion image framework: Copying '" + pathToImage + L"' from the image cache");
+            warning = cached->warning;
+            return CopyBitmap(*cached->bitmap);
+        }
+
+        auto bitmap = ReadUncached(pathToImage, warning);
+        AddToCache(key, bitmap, warning);
+        return bitmap;
+    }
+
+    std::vector<FitsHduInfo> ListFitsHdus(const std::wstring& pathToImage)
+    {
+        return acrion::imagetools::ListFitsHdus(pathToImage);
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReadFitsPlane(const std::wstring& pathToImage, int hdu, long long plane)
+    {
+        auto& cache = GetImageCache();
+
+        if (cache.GetByteBudget() == 0)
+        {
+            return acrion::imagetools::ReadFitsPlane(pathToImage, hdu, plane);
+        }
+
+        CacheKey key = MakeCacheKey(pathToImage);
+        key.hdu      = hdu;
+        key.plane    = plane;
+
+        if (const auto cached = cache.Get(key))
+        {
+            return CopyBitmap(*cached->bitmap);
+        }
+
+        CBEAM_LOG(L"acrion image framework: Reading plane " + std::to_wstring(plane) + L" of HDU " + std::to_wstring(hdu) + L" of '" + pathToImage + L"'");
+
+        auto bitmap = acrion::imagetools::ReadFitsPlane(pathToImage, hdu, plane);
+        AddToCache(key, bitmap, std::string());
+        return bitmap;
+    }
+
+    void SetCacheSize(size_t bytes)
+    {
+        GetImageCache().SetByteBudget(bytes);
+    }
+
+    CacheStatistics GetCacheStatistics()
+    {
+        auto&           cache      = GetImageCache();
+        const auto      statistics = cache.GetStatistics();
+        CacheStatistics result;
+        result.hits       = statistics.hits;
+        result.misses     = statistics.misses;
+        result.evictions  = statistics.evictions;
+        result.entries    = statistics.entries;
+        result.bytes      = statistics.bytes;
+        result.byteBudget = cache.GetByteBudget();
+        return result;
+    }
+
+    void InvalidateCache(const std::wstring& pathToImage)
+    {
+        auto& cache = GetImageCache();
+
+        if (pathToImage.empty())
+        {
+            cache.Clear();
+            return;
         }
+
+        std::error_code       error;
+        std::filesystem::path path = std::filesystem::weakly_canonical(pathToImage, error);
+        if (error)
+        {
+            path = pathToImage;
+        }
+
+        cache.EraseIf([&](const CacheKey& key)
+                      { return key.path == path; });
     }
 
     void Write(const acrion::image::Bitmap& bitmap, std::wstring pathToImage, std::string& warning)
     {
+        InvalidateCache(pathToImage);
+
+        warning                     = "";
+        const std::string extension = cbeam::convert::to_lower(std::filesystem::path(pathToImage).extension().string());
+        const bool        bFits     = extension == ".fits" || extension == ".fit" || extension == ".fz";
+
+        if (bFits)
+        {
+            FitsCompressionOptions compression = GetFitsCompression();
+
+            if (extension == ".fz" && compression.compression == FitsCompression::None)
+            {
+                compression.compression = FitsCompression::Rice;
+            }
+
+            // cfitsio writes all depths including floating point directly from the bitmap buffer
+            CBEAM_LOG(L"acrion image framework: Writing FITS image '" + pathToImage + L"'");
+            WriteFits(bitmap, pathToImage, compression);
+            return;
+        }
+
         ensure_magick_initialized();
+
         if (bitmap.Depth() < 0)
         {
             throw std::runtime_error("acrion::image::Bitmap::Write: Please use FITS format for images with floating point type");
@@ -213,24 +868,13 @@ namespace acrion::imagetools::io
             throw std::runtime_error("acrion::image::Bitmap::Write: Unsupported image depth " + std::to_string(bitmap.Depth()));
         }
 
-        warning                     = "";
-        const std::string extension = cbeam::convert::to_lower(std::filesystem::path(pathToImage).extension().string());
-        const bool        bFits     = extension == ".fits" || extension == ".fit";
-
         CBEAM_LOG(L"acrion image framework: Writing image '" + pathToImage + L"'");
 
         try
         {
             bool bContainsColors = bitmap.ContainsColors();
 
-            if (bContainsColors)
-            {
-                if (bFits)
-                {
-                    throw std::runtime_error("acrion_image_tools::io::Write: Creating colored FITS image files is not supported. Please use TIFF format for this.");
-                }
-            }
-            else if (bitmap.Channels() > 1)
+            if (!bContainsColors && bitmap.Channels() > 1)
             {
                 // TODO: reduce channels to 1
             }
@@ -267,10 +911,6 @@ namespace acrion::imagetools::io
             {
                 out.magick("TIFF");
             }
-            else if (ext == ".fit" || ext == ".fits")
-            {
-                out.magick("FITS");
-            }
             else if (ext == ".png")
             {
                 out.magick("PNG");
@@ -296,4 +936,108 @@ namespace acrion::imagetools::io
             CBEAM_LOG("acrion image framework: Writing was successful, though ImageMagick reported a warning: '" + warning + "'");
         }
     }
+
+    size_t EstimateBitmapSize(const std::wstring& pathToImage)
+    {
+        if (IsFits(pathToImage))
+        {
+            return EstimateFitsBitmapSize(pathToImage);
+        }
+
+        const ImageInfo info = Probe(pathToImage);
+        return (size_t)info.width * info.height * info.channels * std::abs(info.depth);
+    }
+
+    void ReadMany(const std::vector<std::wstring>& filePaths, const ReadManyOptions& options, const ReadManyCallback& callback)
+    {
+        ensure_magick_initialized(); // before the workers start, so they do not race for it
+
+        const int threads = (int)std::min<size_t>(filePaths.size(), options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency()));
+
+        std::atomic<size_t>     next{0};
+        std::mutex              callbackMutex;
+        std::mutex              budgetMutex;
+        std::condition_variable budgetReleased;
+        size_t                  bytesInFlight = 0;
+
+        auto worker = [&]
+        {
+            // one file per core is already parallel enough, nested kernel threads would only compete with the other workers
+            parallel::SerialScope serialScope;
+
+            for (size_t index = next++; index < filePaths.size(); index = next++)
+            {
+                std::shared_ptr<acrion::image::Bitmap> bitmap;
+                std::string                            warning;
+                std::string                            error;
+                size_t                                 reserved = 0;
+
+                try
+                {
+                    if (options.memoryBudget > 0)
+                    {
+                        const size_t estimate = EstimateBitmapSize(filePaths[index]);
+
+                        // a file larger than the whole budget is read as soon as nothing else is in flight
+                        std::unique_lock<std::mutex> lock(budgetMutex);
+                        budgetReleased.wait(lock, [&]
+                                            { return bytesInFlight == 0 || bytesInFlight + estimate <= options.memoryBudget; });
+                        bytesInFlight += estimate;
+                        reserved = estimate;
+                    }
+
+                    bitmap = Read(filePaths[index], warning);
+                }
+                catch (const std::exception& ex)
+                {
+                    error = ex.what();
+                }
+                catch (...)
+                {
+                    error = "Unknown error while reading image";
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(callbackMutex);
+                    try
+                    {
+                        callback(index, bitmap, warning, error);
+                    }
+                    catch (const std::exception& ex)
+                    {
+                        CBEAM_LOG("acrion image framework: ReadMany callback failed: " + std::string(ex.what()));
+                    }
+                    catch (...)
+                    {
+                        // an exception escaping a worker thread would terminate the host process
+                        CBEAM_LOG("acrion image framework: ReadMany callback failed with an unknown exception");
+                    }
+                }
+
+                bitmap.reset();
+
+                if (reserved > 0)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(budgetMutex);
+                        bytesInFlight -= reserved;
+                    }
+                    budgetReleased.notify_all();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+
+        worker();
+
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+    }
 }
@@ -29,11 +29,253 @@ along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 
 #include "acrion/image/bitmap.hpp"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace acrion::imagetools::io
 {
+    /// Selects how Read transfers the pixels of images decoded by ImageMagick into the bitmap.
+    enum class ReadMode
+    {
+        PixelCache,  ///< Copy from a view of ImageMagick's Q32 pixel cache (default).
+        DirectExport ///< Let ImageMagick write band by band directly into the bitmap buffer with the bitmap's storage type. This needs less memory and one pass less. 64 bit images always use PixelCache.
+    };
+
+    ACRION_IMAGE_TOOLS_EXPORT void     SetReadMode(ReadMode mode);
+    ACRION_IMAGE_TOOLS_EXPORT ReadMode GetReadMode();
+
+    /// A bitmap whose samples are stored values that map linearly to physical values: physical = zero + scale * stored.
+    /// Read returns this for FITS images with BSCALE/BZERO scaling, so that the samples stay integers of the stored size.
+    /// Write stores the scaling in the BSCALE and BZERO keywords of FITS files.
+    class ACRION_IMAGE_TOOLS_EXPORT ScaledBitmap : public acrion::image::Bitmap
+    {
+    public:
+        static constexpr const char* scaleKey = "bscale";
+        static constexpr const char* zeroKey  = "bzero";
+
+        ScaledBitmap(const acrion::image::Bitmap& bitmap, double scale, double zero)
+            : acrion::image::Bitmap(bitmap)
+            , _scale(scale)
+            , _zero(zero)
+        {
+        }
+
+        double Scale() const { return _scale; }
+        double Zero() const { return _zero; }
+
+        double PhysicalValue(double storedValue) const { return _zero + _scale * storedValue; }
+
+    private:
+        double _scale;
+        double _zero;
+    };
+
+    /// How Read determines the brightness range for display (see acrion::image::Bitmap::SetBrightnessRangeForDisplay).
+    enum class DisplayRangeMode
+    {
+        Exact,      ///< Minimum and maximum of FITS images, computed while reading; other formats keep the full range of their sample type (default).
+        Percentile, ///< The given percentiles of a sample of the pixels, which excludes hot pixels and cosmic rays.
+        ZScale      ///< IRAF's zscale algorithm on a sample of the pixels, which concentrates on the values around the median, e.g. the sky background.
+    };
+
+    struct DisplayRangeOptions
+    {
+        DisplayRangeMode mode           = DisplayRangeMode::Exact;
+        size_t           samples        = 100000; ///< maximum number of pixels taken into account, on a regular grid over the whole image
+        double           lowPercentile  = 0.5;    ///< Percentile mode: lower end of the range, in percent
+        double           highPercentile = 99.5;   ///< Percentile mode: upper end of the range, in percent
+        double           contrast       = 0.25;   ///< ZScale mode: smaller values widen the range
+    };
+
+    /// Changes how all readers determine the display range. Clears the cache, because cached images carry the range of the previous options.
+    ACRION_IMAGE_TOOLS_EXPORT void                SetDisplayRangeOptions(const DisplayRangeOptions& options);
+    ACRION_IMAGE_TOOLS_EXPORT DisplayRangeOptions GetDisplayRangeOptions();
+    /// Computes the display range of the samples of all channels of a bitmap. Unlike Read, Exact mode scans all samples of any format.
+    ACRION_IMAGE_TOOLS_EXPORT std::pair<double, double> ComputeDisplayRange(const acrion::image::Bitmap& bitmap, const DisplayRangeOptions& options);
+
+    /// Image properties that are available from the file header, without decoding the pixels.
+    struct ImageInfo
+    {
+        int width    = 0;
+        int height   = 0;
+        int channels = 0;
+        int depth    = 0; ///< bytes per sample as stored in the file, negative for floating point (same convention as acrion::image::Bitmap::Depth())
+    };
+
+    enum class FitsHduType
+    {
+        Image,
+        AsciiTable,
+        BinaryTable
+    };
+
+    /// Describes one header data unit (HDU) of a FITS file. Images with more than two axes consist of `planes` 2D planes.
+    struct FitsHduInfo
+    {
+        int         index = 0; ///< 0 for the primary HDU, followed by the extensions
+        FitsHduType type  = FitsHduType::Image;
+        std::string name;      ///< EXTNAME, if present
+        ImageInfo   image;     ///< all zero for tables and HDUs without data
+        long long   planes = 0;
+    };
+
+    ACRION_IMAGE_TOOLS_EXPORT ImageInfo Probe(const std::wstring& filePath);
+
+    /// Lists the HDUs of a FITS file by reading their headers only.
+    ACRION_IMAGE_TOOLS_EXPORT std::vector<FitsHduInfo> ListFitsHdus(const std::wstring& filePath);
+
+    /// Reads a single 2D plane of a FITS image HDU, reading only that plane from disk. Planes count through all axes beyond
+    /// the second, with the third axis varying fastest. Read returns the first plane of the first HDU that contains an image.
+    /// Planes are kept in the same LRU cache as the images returned by Read.
+    ACRION_IMAGE_TOOLS_EXPORT std::shared_ptr<acrion::image::Bitmap> ReadFitsPlane(const std::wstring& filePath, int hdu, long long plane);
+    /// Read-only view of the data of an uncompressed FITS image, mapped from the file without copying. The samples are exactly as
+    /// stored in the file: big-endian, rows from bottom to top, and not scaled by Scale() and Zero(). 8 bit samples can be used directly.
+    /// The file stays mapped as long as a copy of the view exists.
+    class ACRION_IMAGE_TOOLS_EXPORT MappedFitsImage
+    {
+    public:
+        /// Maps the given HDU, or the first HDU that contains an image like Read if hdu is negative. Throws if the image is tile-compressed.
+        explicit MappedFitsImage(const std::wstring& filePath, int hdu = -1);
+
+        const void* Data() const { return _data; } ///< first sample of the first plane
+        const void* Plane(long long plane) const { return _data + plane * PlaneBytes(); }
+
+        int       Width() const { return _width; }
+        int       Height() const { return _height; }
+        long long Planes() const { return _planes; }
+        int       Bitpix() const { return _bitpix; } ///< FITS sample type: 8, 16, 32 or 64 for integers, -32 or -64 for floating point
+        size_t    RowBytes() const { return (size_t)_width * (_bitpix < 0 ? -_bitpix : _bitpix) / 8; }
+        size_t    PlaneBytes() const { return RowBytes() * _height; }
+        double    Scale() const { return _scale; }
+        double    Zero() const { return _zero; }
+
+    private:
+        std::shared_ptr<const void> _map;
+        const uint8_t*              _data   = nullptr;
+        int                         _width  = 0;
+        int                         _height = 0;
+        long long                   _planes = 0;
+        int                         _bitpix = 0;
+        double                      _scale  = 1.0;
+        double                      _zero   = 0.0;
+    };
+
     ACRION_IMAGE_TOOLS_EXPORT std::shared_ptr<acrion::image::Bitmap> Read(const std::wstring& filePath, std::string& warning);
+    /// Decodes an image that is already in memory, e.g. received via IPC, without writing it to a file. The buffer is read in place.
+    /// formatHint is an ImageMagick format name or file extension like "PNG" or ".fits"; if it is empty, FITS data is recognized by
+    /// its header and other formats are detected by ImageMagick.
+    ACRION_IMAGE_TOOLS_EXPORT std::shared_ptr<acrion::image::Bitmap> ReadFromMemory(const void* data, size_t size, const std::string& formatHint, std::string& warning);
+    /// Reads the given rectangle of an image, with x and y counted from the top left corner. For FITS files, only the rows
+    /// of the rectangle are read from disk. For other formats, ImageMagick is asked to extract the rectangle while decoding;
+    /// coders that ignore this hint still decode the whole frame first, so their memory use scales with the image, not the
+    /// rectangle. Throws if the rectangle exceeds the image.
+    ACRION_IMAGE_TOOLS_EXPORT std::shared_ptr<acrion::image::Bitmap> ReadRegion(const std::wstring& filePath, int x, int y, int width, int height, std::string& warning);
+    /// Reads an 8 bit version of the image for display, with its longer edge reduced to at most maxEdge pixels, as cheaply as the format allows:
+    /// JPEG files are scaled while decoding, embedded EXIF thumbnails and reduced resolution TIFF frames are used if they are large enough,
+    /// and FITS files are decimated while reading.
+    ACRION_IMAGE_TOOLS_EXPORT std::shared_ptr<acrion::image::Bitmap> ReadPreview(const std::wstring& filePath, int maxEdge, std::string& warning);
+
+    /// How ReadReduced combines each block of factor x factor pixels into one
+    enum class Reduction
+    {
+        Bin,     ///< average of the block, rounded to the nearest integer for integer samples
+        Decimate ///< bottom left pixel of the block, like cfitsio's image section file.fits[1:width:factor,1:height:factor]
+    };
+
+    /// Reads an image with its width and height divided by factor (e.g. 2, 4 or 8), in the sample type that Read returns. Blocks start
+    /// at the bottom left corner, where FITS images have their origin; rows and columns left over at the top and right are dropped.
+    /// Uncompressed FITS images are reduced on all cores while the rows are converted from the memory mapped file, without holding the
+    /// image at full resolution, and decimation only touches the rows it picks. Other images are read completely and reduced afterwards.
+    ACRION_IMAGE_TOOLS_EXPORT std::shared_ptr<acrion::image::Bitmap> ReadReduced(const std::wstring& filePath, int factor, Reduction reduction, std::string& warning);
     ACRION_IMAGE_TOOLS_EXPORT void                                   Write(const acrion::image::Bitmap& bitmap, std::wstring pathToImage, std::string& warning);
+
+    /// Tile compression of FITS images written by Write. Tiles span the whole width of the image.
+    enum class FitsCompression
+    {
+        None,     ///< uncompressed (default for .fits and .fit)
+        Rice,     ///< Rice coding, lossless for integers (default for .fz)
+        Gzip,     ///< lossless for integers
+        Hcompress ///< lossless for integers with hcompressScale 0
+    };
+
+    struct FitsCompressionOptions
+    {
+        FitsCompression compression    = FitsCompression::None;
+        float           quantizeLevel  = 4.0f; ///< floating point images are quantized to steps of the noise sigma of each tile divided by this value; 0 stores them losslessly, which only Gzip supports
+        int             ditherSeed     = 0;    ///< 1 to 10000 selects the offset into the dither sequence of the quantization, 0 derives it from the first row of the image
+        float           hcompressScale = 0.0f; ///< Hcompress: values above 0 are lossy
+        long            tileRows       = 0;    ///< rows per tile, 0 for the cfitsio default (1 row, 16 for Hcompress)
+    };
+
+    /// Changes the compression of FITS images written by Write to .fits and .fit files. Rice and Gzip tiles are compressed on all cores
+    /// and written in order, Hcompress tiles one after another. 64 bit integer images cannot be compressed.
+    ACRION_IMAGE_TOOLS_EXPORT void                   SetFitsCompression(const FitsCompressionOptions& options);
+    ACRION_IMAGE_TOOLS_EXPORT FitsCompressionOptions GetFitsCompression();
+
+    /// DATASUM and CHECKSUM keywords of the FITS checksum convention. With `write`, Write adds them to FITS images; the data unit of an
+    /// uncompressed image is summed while its samples are written, that of a compressed image is read back after its tiles are written.
+    /// With `verify`, Read checks the FITS images that have these keywords and throws if an image does not match them. Memory mapped
+    /// images are summed while they are converted, on all cores; regions, previews and planes are not verified. Turning `verify` on
+    /// clears the image cache, which holds unverified images.
+    struct FitsChecksums
+    {
+        bool write  = false;
+        bool verify = false;
+    };
+
+    ACRION_IMAGE_TOOLS_EXPORT void          SetFitsChecksums(const FitsChecksums& options);
+    ACRION_IMAGE_TOOLS_EXPORT FitsChecksums GetFitsChecksums();
+
+    /// Large block read mode of cfitsio's file driver for FITS files that are opened afterwards. Reads smaller than a block, e.g. the rows
+    /// of a region or the tiles of a compressed image, are served from a cache of aligned blocks per open file, and the operating system is
+    /// told that the file will be read sequentially, so that it reads further ahead. Uncompressed images returned by Read are memory mapped
+    /// and not affected. Reading just the headers of many files is faster without it, so it is disabled by default.
+    struct FitsReadBlocks
+    {
+        size_t blockSize  = 0; ///< bytes per block, rounded up to a multiple of 64 KiB; 0 reads through stdio
+        int    blockCount = 4; ///< blocks per open file, so that interleaved reads, e.g. of the tile table and the heap of a compressed image, do not evict each other
+    };
+
+    ACRION_IMAGE_TOOLS_EXPORT void           SetFitsReadBlocks(const FitsReadBlocks& options);
+    ACRION_IMAGE_TOOLS_EXPORT FitsReadBlocks GetFitsReadBlocks();
+
+    struct CacheStatistics
+    {
+        size_t hits       = 0;
+        size_t misses     = 0;
+        size_t evictions  = 0;
+        size_t entries    = 0;
+        size_t bytes      = 0;
+        size_t byteBudget = 0;
+    };
+
+    /// Read keeps copies of decoded images in an LRU cache, keyed by canonical path, file size and modification time, so that
+    /// opening the same file again only costs a memcpy. The default budget is 512 MiB; 0 disables the cache.
+    ACRION_IMAGE_TOOLS_EXPORT void            SetCacheSize(size_t bytes);
+    ACRION_IMAGE_TOOLS_EXPORT CacheStatistics GetCacheStatistics();
+
+    /// Removes the given file from the cache, or all files if filePath is empty.
+    ACRION_IMAGE_TOOLS_EXPORT void InvalidateCache(const std::wstring& filePath = std::wstring());
+
+    struct ReadManyOptions
+    {
+        int    threads      = 0; ///< number of files decoded concurrently, 0 for one per core
+        size_t memoryBudget = 0; ///< maximum estimated size in bytes of all bitmaps being decoded or passed to the callback, 0 for no limit
+    };
+
+    /// Receives the result for the file filePaths[index]. On failure, bitmap is null and error describes the reason.
+    using ReadManyCallback = std::function<void(size_t index, std::shared_ptr<acrion::image::Bitmap> bitmap, const std::string& warning, const std::string& error)>;
+
+    /// Reads the given files concurrently and passes each result to the callback in completion order. The callback is never called
+    /// concurrently, so it does not need to be thread-safe. Returns after the last callback has returned.
+    ACRION_IMAGE_TOOLS_EXPORT void ReadMany(const std::vector<std::wstring>& filePaths, const ReadManyOptions& options, const ReadManyCallback& callback);
+
+    /// Estimates the size in bytes of the bitmap Read will return for the given file from its header, without decoding it. This is what
+    /// ReadMany charges against its memory budget.
+    ACRION_IMAGE_TOOLS_EXPORT size_t EstimateBitmapSize(const std::wstring& filePath);
 }
@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace acrion::imagetools
+{
+    /// Thread-safe least recently used cache with a budget on the total size of its values.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class LruCache
+    {
+    public:
+        struct Statistics
+        {
+            size_t hits      = 0;
+            size_t misses    = 0;
+            size_t evictions = 0;
+            size_t entries   = 0;
+            size_t bytes     = 0;
+        };
+
+        explicit LruCache(size_t byteBudget)
+            : _byteBudget(byteBudget)
+        {
+        }
+
+        /// Returns the cached value and marks it as most recently used, or std::nullopt if the key is not cached.
+        std::optional<Value> Get(const Key& key)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto                  it = _index.find(key);
+
+            if (it == _index.end())
+            {
+                ++_statistics.misses;
+                return std::nullopt;
+            }
+
+            ++_statistics.hits;
+            _entries.splice(_entries.begin(), _entries, it->second);
+            return it->second->value;
+        }
+
+        /// Stores a value of the given size, evicting the least recently used values until the budget is met.
+        /// Values larger than the whole budget are not stored.
+        void Put(const Key& key, Value value, size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            EraseLocked(key);
+
+            if (bytes > _byteBudget)
+            {
+                return;
+            }
+
+            _entries.push_front(Entry{key, std::move(value), bytes});
+            _index[key] = _entries.begin();
+            _statistics.bytes += bytes;
+
+            Shrink();
+        }
+
+        /// Removes all values whose key satisfies the predicate.
+        template <typename Predicate>
+        void EraseIf(Predicate predicate)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (auto it = _entries.begin(); it != _entries.end();)
+            {
+                if (predicate(it->key))
+                {
+                    _statistics.bytes -= it->bytes;
+                    _index.erase(it->key);
+                    it = _entries.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        void Clear()
+        {
+            EraseIf([](const Key&)
+                    { return true; });
+        }
+
+        void SetByteBudget(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _byteBudget = bytes;
+            Shrink();
+        }
+
+        size_t GetByteBudget() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _byteBudget;
+        }
+
+        Statistics GetStatistics() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Statistics                  statistics = _statistics;
+            statistics.entries                     = _entries.size();
+            return statistics;
+        }
+
+    private:
+        struct Entry
+        {
+            Key    key;
+            Value  value;
+            size_t bytes;
+        };
+
+        void EraseLocked(const Key& key)
+        {
+            const auto it = _index.find(key);
+
+            if (it != _index.end())
+            {
+                _statistics.bytes -= it->second->bytes;
+                _entries.erase(it->second);
+                _index.erase(it);
+            }
+        }
+
+        void Shrink()
+        {
+            while (_statistics.bytes > _byteBudget && !_entries.empty())
+            {
+                _statistics.bytes -= _entries.back().bytes;
+                _index.erase(_entries.back().key);
+                _entries.pop_back();
+                ++_statistics.evictions;
+            }
+        }
+
+        mutable std::mutex                                                 _mutex;
+        size_t                                                             _byteBudget;
+        std::list<Entry>                                                   _entries; // most recently used first
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> _index;
+        Statistics                                                         _statistics;
+    };
+}
@@ -35,16 +35,26 @@ along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 #include <cbeam/container/xpod.hpp>
 #include <cbeam/serialization/direct.hpp>
 
+#include "arithmetic.hpp"
+#include "fits_index.hpp"
 #include "io.hpp"
 
 #include "acrion/image/bitmap.hpp"
 
 #include <cbeam/convert/string.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
@@ -136,6 +146,33 @@ void SubtractReferenceFromWorkingImage(T* right, T* left, const T* left_end, con
     }
 }
 
+// Converts a bitmap read by io to a container, including the scaling of stored to physical values if it has one
+acrion::image::BitmapContainer ToContainer(const acrion::image::Bitmap& bitmap)
+{
+    auto image = (acrion::image::BitmapContainer)bitmap;
+
+    if (const auto* scaled = dynamic_cast<const io::ScaledBitmap*>(&bitmap))
+    {
+        image.data[io::ScaledBitmap::scaleKey] = scaled->Scale();
+        image.data[io::ScaledBitmap::zeroKey]  = scaled->Zero();
+    }
+
+    return image;
+}
+
+// keys of the scaling of the reference image, passed along with the scaling of the working image (io::ScaledBitmap::scaleKey, zeroKey)
+constexpr const char* referenceScaleKey = "referenceBscale";
+constexpr const char* referenceZeroKey  = "referenceBzero";
+
+// Scaling of stored to physical values (see io::ScaledBitmap) passed with the given keys, or the identity if the image has none
+std::pair<double, double> GetScaling(const acrion::image::BitmapContainer& parameters, const std::string& scaleKey, const std::string& zeroKey)
+{
+    const double scale = parameters.data.find(scaleKey) != parameters.data.end() ? parameters.get_mapped_value_or_throw<double>(scaleKey) : 1.0;
+    const double zero  = parameters.data.find(zeroKey) != parameters.data.end() ? parameters.get_mapped_value_or_throw<double>(zeroKey) : 0.0;
+
+    return {scale, zero};
+}
+
 extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer OpenImageFile(const char* fileName)
 {
     acrion::image::BitmapContainer image;
@@ -145,7 +182,91 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Op
         std::string        warning;
         const std::wstring fileName16 = cbeam::convert::from_string<std::wstring>(fileName);
 
-        image = (acrion::image::BitmapContainer)*io::Read(fileName16, warning);
+        image = ToContainer(*io::Read(fileName16, warning));
+
+        if (!warning.empty())
+        {
+            image.data["message"] = warning;
+        }
+
+        image.data["path"] = std::string(fileName);
+    }
+    catch (const std::exception& ex)
+    {
+        image.data["error"] = (std::string)ex.what();
+    }
+
+    auto buffer = cbeam::serialization::serialize(image);
+    assert(buffer.use_count() > 1 && "Create an instance of cbeam::container::stable_reference_buffer::delay_deallocation prior using this function.");
+    return buffer.get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer OpenImageFileRegion(const char* fileName, long long x, long long y, long long width, long long height)
+{
+    acrion::image::BitmapContainer image;
+
+    try
+    {
+        std::string        warning;
+        const std::wstring fileName16 = cbeam::convert::from_string<std::wstring>(fileName);
+
+        image = ToContainer(*io::ReadRegion(fileName16, (int)x, (int)y, (int)width, (int)height, warning));
+
+        if (!warning.empty())
+        {
+            image.data["message"] = warning;
+        }
+
+        image.data["path"] = std::string(fileName);
+    }
+    catch (const std::exception& ex)
+    {
+        image.data["error"] = (std::string)ex.what();
+    }
+
+    auto buffer = cbeam::serialization::serialize(image);
+    assert(buffer.use_count() > 1 && "Create an instance of cbeam::container::stable_reference_buffer::delay_deallocation prior using this function.");
+    return buffer.get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer OpenImagePreview(const char* fileName, long long maxEdge)
+{
+    acrion::image::BitmapContainer image;
+
+    try
+    {
+        std::string        warning;
+        const std::wstring fileName16 = cbeam::convert::from_string<std::wstring>(fileName);
+
+        image = (acrion::image::BitmapContainer)*io::ReadPreview(fileName16, (int)maxEdge, warning);
+
+        if (!warning.empty())
+        {
+            image.data["message"] = warning;
+        }
+
+        image.data["path"] = std::string(fileName);
+    }
+    catch (const std::exception& ex)
+    {
+        image.data["error"] = (std::string)ex.what();
+    }
+
+    auto buffer = cbeam::serialization::serialize(image);
+    assert(buffer.use_count() > 1 && "Create an instance of cbeam::container::stable_reference_buffer::delay_deallocation prior using this function.");
+    return buffer.get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer OpenImageFileReduced(const char* fileName, long long factor, long long average)
+{
+    acrion::image::BitmapContainer image;
+
+    try
+    {
+        std::string        warning;
+        const std::wstring fileName16 = cbeam::convert::from_string<std::wstring>(fileName);
+
+        image = ToContainer(*io::ReadReduced(fileName16, (int)factor, average ? io::Reduction::Bin : io::Reduction::Decimate, warning));
 
         if (!warning.empty())
         {
@@ -164,6 +285,396 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Op
     return buffer.get();
 }
 
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer ProbeImageFile(const char* fileName)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        const io::ImageInfo info = io::Probe(cbeam::convert::from_string<std::wstring>(fileName));
+
+        result.data[std::string(acrion::image::Bitmap::widthKey)]    = (long long)info.width;
+        result.data[std::string(acrion::image::Bitmap::heightKey)]   = (long long)info.height;
+        result.data[std::string(acrion::image::Bitmap::channelsKey)] = (long long)info.channels;
+        result.data[std::string(acrion::image::Bitmap::depthKey)]    = (long long)info.depth;
+        result.data["path"]                                          = std::string(fileName);
+        result.data["message"]                                       = std::to_string(info.width) + " x " + std::to_string(info.height) + ", "
+                                   + std::to_string(info.channels) + " channel(s), "
+                                   + std::to_string(std::abs(info.depth) * 8) + (info.depth < 0 ? " bit floating point" : " bit");
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer ListImageHdus(const char* fileName)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        const std::vector<io::FitsHduInfo> hdus = io::ListFitsHdus(cbeam::convert::from_string<std::wstring>(fileName));
+        std::string                        message;
+
+        for (const io::FitsHduInfo& hdu : hdus)
+        {
+            message += (message.empty() ? "" : "\n") + std::to_string(hdu.index) + (hdu.name.empty() ? "" : " (" + hdu.name + ")") + ": ";
+
+            if (hdu.type != io::FitsHduType::Image)
+            {
+                message += hdu.type == io::FitsHduType::AsciiTable ? "ASCII table" : "binary table";
+            }
+            else if (hdu.planes == 0)
+            {
+                message += "no data";
+            }
+            else
+            {
+                message += std::to_string(hdu.image.width) + " x " + std::to_string(hdu.image.height) + ", " + std::to_string(hdu.planes) + " plane(s), "
+                         + std::to_string(std::abs(hdu.image.depth) * 8) + (hdu.image.depth < 0 ? " bit floating point" : " bit");
+            }
+        }
+
+        result.data["hduCount"] = (long long)hdus.size();
+        result.data["path"]     = std::string(fileName);
+        result.data["message"]  = message;
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer OpenImagePlane(const char* fileName, long long hdu, long long plane)
+{
+    acrion::image::BitmapContainer image;
+
+    try
+    {
+        image = ToContainer(*io::ReadFitsPlane(cbeam::convert::from_string<std::wstring>(fileName), (int)hdu, plane));
+
+        image.data["path"] = std::string(fileName);
+    }
+    catch (const std::exception& ex)
+    {
+        image.data["error"] = (std::string)ex.what();
+    }
+
+    auto buffer = cbeam::serialization::serialize(image);
+    assert(buffer.use_count() > 1 && "Create an instance of cbeam::container::stable_reference_buffer::delay_deallocation prior using this function.");
+    return buffer.get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer InvalidateImageCache(const char* fileName)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        io::InvalidateCache(cbeam::convert::from_string<std::wstring>(fileName));
+        result.data["message"] = *fileName ? "Removed " + std::string(fileName) + " from the image cache" : "Cleared the image cache"s;
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer SetImageCacheSize(long long byteBudget)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        if (byteBudget < 0)
+        {
+            throw std::runtime_error("acrion::imagetools::SetImageCacheSize(): invalid cache size " + std::to_string(byteBudget));
+        }
+
+        io::SetCacheSize((size_t)byteBudget);
+
+        result.data["message"] = byteBudget ? "The image cache now holds up to " + std::to_string(byteBudget >> 20) + " MiB" : std::string("The image cache is disabled");
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer GetImageCacheStatistics(const acrion::image::SerializedBitmapContainer)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        const io::CacheStatistics statistics = io::GetCacheStatistics();
+
+        result.data["hits"]       = (long long)statistics.hits;
+        result.data["misses"]     = (long long)statistics.misses;
+        result.data["evictions"]  = (long long)statistics.evictions;
+        result.data["entries"]    = (long long)statistics.entries;
+        result.data["bytes"]      = (long long)statistics.bytes;
+        result.data["byteBudget"] = (long long)statistics.byteBudget;
+        result.data["message"]    = std::to_string(statistics.entries) + " image(s), " + std::to_string(statistics.bytes >> 20) + " of "
+                                 + std::to_string(statistics.byteBudget >> 20) + " MiB, " + std::to_string(statistics.hits) + " hit(s), "
+                                 + std::to_string(statistics.misses) + " miss(es), " + std::to_string(statistics.evictions) + " eviction(s)";
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer SetImageDisplayRange(const acrion::image::SerializedBitmapContainer serializedParameters)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        acrion::image::BitmapContainer parameters = cbeam::serialization::deserialize<acrion::image::BitmapContainer>(serializedParameters);
+        const std::string              mode       = cbeam::convert::to_lower(parameters.get_mapped_value_or_throw<std::string>("mode", "acrion::imagetools::SetImageDisplayRange()"));
+        io::DisplayRangeOptions        options;
+
+        if (mode == "exact")
+        {
+            options.mode = io::DisplayRangeMode::Exact;
+        }
+        else if (mode == "percentile")
+        {
+            options.mode = io::DisplayRangeMode::Percentile;
+        }
+        else if (mode == "zscale")
+        {
+            options.mode = io::DisplayRangeMode::ZScale;
+        }
+        else
+        {
+            throw std::runtime_error("acrion::imagetools::SetImageDisplayRange(): unknown mode '" + mode + "', expected exact, percentile or zscale");
+        }
+
+        options.samples        = (size_t)std::max(1LL, parameters.get_mapped_value_or_throw<long long>("samples", "acrion::imagetools::SetImageDisplayRange()"));
+        options.lowPercentile  = parameters.get_mapped_value_or_throw<double>("lowPercentile", "acrion::imagetools::SetImageDisplayRange()");
+        options.highPercentile = parameters.get_mapped_value_or_throw<double>("highPercentile", "acrion::imagetools::SetImageDisplayRange()");
+        options.contrast       = parameters.get_mapped_value_or_throw<double>("contrast", "acrion::imagetools::SetImageDisplayRange()");
+
+        io::SetDisplayRangeOptions(options);
+
+        result.data["message"] = "Images are now read with the " + mode + " display range";
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer SetFitsCompression(const acrion::image::SerializedBitmapContainer serializedParameters)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        acrion::image::BitmapContainer parameters  = cbeam::serialization::deserialize<acrion::image::BitmapContainer>(serializedParameters);
+        const std::string              compression = cbeam::convert::to_lower(parameters.get_mapped_value_or_throw<std::string>("compression", "acrion::imagetools::SetFitsCompression()"));
+        io::FitsCompressionOptions     options;
+
+        if (compression == "none")
+        {
+            options.compression = io::FitsCompression::None;
+        }
+        else if (compression == "rice")
+        {
+            options.compression = io::FitsCompression::Rice;
+        }
+        else if (compression == "gzip")
+        {
+            options.compression = io::FitsCompression::Gzip;
+        }
+        else if (compression == "hcompress")
+        {
+            options.compression = io::FitsCompression::Hcompress;
+        }
+        else
+        {
+            throw std::runtime_error("acrion::imagetools::SetFitsCompression(): unknown compression '" + compression + "', expected none, rice, gzip or hcompress");
+        }
+
+        options.quantizeLevel  = (float)parameters.get_mapped_value_or_throw<double>("quantizeLevel", "acrion::imagetools::SetFitsCompression()");
+        options.ditherSeed     = (int)parameters.get_mapped_value_or_throw<long long>("ditherSeed", "acrion::imagetools::SetFitsCompression()");
+        options.hcompressScale = (float)parameters.get_mapped_value_or_throw<double>("hcompressScale", "acrion::imagetools::SetFitsCompression()");
+        options.tileRows       = (long)parameters.get_mapped_value_or_throw<long long>("tileRows", "acrion::imagetools::SetFitsCompression()");
+
+        io::SetFitsCompression(options);
+
+        result.data["message"] = "FITS images are now written with " + compression + " compression";
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer SetFitsChecksums(const acrion::image::SerializedBitmapContainer serializedParameters)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        acrion::image::BitmapContainer parameters = cbeam::serialization::deserialize<acrion::image::BitmapContainer>(serializedParameters);
+        io::FitsChecksums              options;
+
+        options.write  = parameters.get_mapped_value_or_throw<long long>("write", "acrion::imagetools::SetFitsChecksums()") != 0;
+        options.verify = parameters.get_mapped_value_or_throw<long long>("verify", "acrion::imagetools::SetFitsChecksums()") != 0;
+
+        io::SetFitsChecksums(options);
+
+        result.data["message"] = std::string("FITS checksums are ") + (options.write ? "written" : "not written") + " and " + (options.verify ? "verified" : "not verified");
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer SetFitsReadBlocks(const acrion::image::SerializedBitmapContainer serializedParameters)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        acrion::image::BitmapContainer parameters = cbeam::serialization::deserialize<acrion::image::BitmapContainer>(serializedParameters);
+        const long long                blockSize  = parameters.get_mapped_value_or_throw<long long>("blockSize", "acrion::imagetools::SetFitsReadBlocks()");
+        const long long                blockCount = parameters.get_mapped_value_or_throw<long long>("blockCount", "acrion::imagetools::SetFitsReadBlocks()");
+
+        if (blockSize < 0 || blockCount < 1 || blockCount > std::numeric_limits<int>::max())
+        {
+            throw std::runtime_error("acrion::imagetools::SetFitsReadBlocks(): invalid block size " + std::to_string(blockSize) + " or count " + std::to_string(blockCount));
+        }
+
+        io::SetFitsReadBlocks({(size_t)blockSize, (int)blockCount});
+
+        const io::FitsReadBlocks blocks = io::GetFitsReadBlocks();
+        result.data["message"]          = blocks.blockSize ? "FITS files are now read in " + std::to_string(blocks.blockCount) + " blocks of " + std::to_string(blocks.blockSize) + " bytes"
+                                                           : std::string("FITS files are now read through the stdio buffer");
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+// Loaded FITS indexes, so that repeated queries do not parse the index file again. An index is loaded again when its file changed.
+std::mutex                                                                                                 fitsIndexMutex;
+std::map<std::wstring, std::pair<std::filesystem::file_time_type, std::shared_ptr<const io::FitsIndex>>> fitsIndexes;
+
+void RememberFitsIndex(const std::shared_ptr<const io::FitsIndex>& index)
+{
+    std::error_code ec;
+    fitsIndexes[index->IndexPath()] = {std::filesystem::last_write_time(std::filesystem::path(index->IndexPath()), ec), index};
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer UpdateFitsIndex(const char* indexPath, const char* directory, const char* keywords)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        std::vector<std::string> keywordList;
+        std::string              keywordText = keywords;
+
+        std::replace(keywordText.begin(), keywordText.end(), ',', ' ');
+        for (size_t start = keywordText.find_first_not_of(' '); start != std::string::npos; start = keywordText.find_first_not_of(' ', start))
+        {
+            const size_t end = keywordText.find(' ', start);
+            keywordList.push_back(keywordText.substr(start, end - start));
+            start = end;
+        }
+
+        const auto                          index      = std::make_shared<io::FitsIndex>(cbeam::convert::from_string<std::wstring>(indexPath), keywordList);
+        const io::FitsIndexUpdateStatistics statistics = index->Update(cbeam::convert::from_string<std::wstring>(directory));
+
+        {
+            std::lock_guard<std::mutex> lock(fitsIndexMutex);
+            RememberFitsIndex(index);
+        }
+
+        result.data["files"]   = (long long)statistics.files;
+        result.data["read"]    = (long long)statistics.read;
+        result.data["removed"] = (long long)statistics.removed;
+        result.data["failed"]  = (long long)statistics.failed;
+        result.data["message"] = std::to_string(statistics.files) + " FITS file(s), " + std::to_string(statistics.read) + " header(s) read, "
+                               + std::to_string(statistics.removed) + " removed, " + std::to_string(statistics.failed) + " unreadable";
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
+extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer QueryFitsIndex(const char* indexPath, const char* query)
+{
+    acrion::image::BitmapContainer result;
+
+    try
+    {
+        const std::wstring                   indexPath16 = cbeam::convert::from_string<std::wstring>(indexPath);
+        std::shared_ptr<const io::FitsIndex> index;
+
+        {
+            std::lock_guard<std::mutex> lock(fitsIndexMutex);
+            std::error_code             ec;
+            const auto                  cached = fitsIndexes.find(indexPath16);
+
+            if (cached != fitsIndexes.end() && cached->second.first == std::filesystem::last_write_time(std::filesystem::path(indexPath16), ec))
+            {
+                index = cached->second.second;
+            }
+            else
+            {
+                index = std::make_shared<const io::FitsIndex>(indexPath16);
+                RememberFitsIndex(index);
+            }
+        }
+
+        const std::vector<std::wstring> paths = index->Query(io::FitsIndex::ParseQuery(query));
+        std::string                     message;
+
+        for (const std::wstring& path : paths)
+        {
+            message += (message.empty() ? "" : "\n") + cbeam::convert::to_string(path);
+        }
+
+        result.data["count"]   = (long long)paths.size();
+        result.data["message"] = paths.empty() ? "No matching files among " + std::to_string(index->Entries().size()) : message;
+    }
+    catch (const std::exception& ex)
+    {
+        result.data["error"] = (std::string)ex.what();
+    }
+
+    return cbeam::serialization::serialize(result).safe_get();
+}
+
 extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer SaveImageFile(const acrion::image::SerializedBitmapContainer serializedImage)
 {
     acrion::image::BitmapContainer result;
@@ -175,9 +686,19 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Sa
         acrion::image::Bitmap          bitmap(image);
         std::string                    warning;
         std::string                    error;
-        io::Write(bitmap,
-                  cbeam::convert::from_string<std::wstring>(savePath),
-                  warning);
+        const std::wstring             savePath16 = cbeam::convert::from_string<std::wstring>(savePath);
+
+        const auto [scale, zero] = GetScaling(image, io::ScaledBitmap::scaleKey, io::ScaledBitmap::zeroKey);
+
+        if (scale != 1.0 || zero != 0.0)
+        {
+            // keep the stored samples and their scaling to physical values, e.g. BSCALE and BZERO of a FITS file
+            io::Write(io::ScaledBitmap(bitmap, scale, zero), savePath16, warning);
+        }
+        else
+        {
+            io::Write(bitmap, savePath16, warning);
+        }
 
         if (!error.empty())
         {
@@ -229,12 +750,24 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Sw
         case 8:
             Swap((uint64_t*)workingImage, (uint64_t*)referenceImage, (uint64_t*)referenceImage + size);
             break;
+        case -4:
+            Swap((float*)workingImage, (float*)referenceImage, (float*)referenceImage + size);
+            break;
         case -8:
             Swap((double*)workingImage, (double*)referenceImage, (double*)referenceImage + size);
             break;
         default:
             throw std::runtime_error("acrion image tools: unsupported depth " + std::to_string(depth) + "in function Swap");
         }
+
+        // the scaling of stored to physical values belongs to the samples and moves with them
+        const auto [workingScale, workingZero]     = GetScaling(parameters, io::ScaledBitmap::scaleKey, io::ScaledBitmap::zeroKey);
+        const auto [referenceScale, referenceZero] = GetScaling(parameters, referenceScaleKey, referenceZeroKey);
+
+        result.data[io::ScaledBitmap::scaleKey] = referenceScale;
+        result.data[io::ScaledBitmap::zeroKey]  = referenceZero;
+        result.data[referenceScaleKey]          = workingScale;
+        result.data[referenceZeroKey]           = workingZero;
     }
     catch (const std::exception& ex)
     {
@@ -275,12 +808,21 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Co
         case 8:
             CopyLeftToRight((uint64_t*)workingImage, (uint64_t*)referenceImage, (uint64_t*)referenceImage + size);
             break;
+        case -4:
+            CopyLeftToRight((float*)workingImage, (float*)referenceImage, (float*)referenceImage + size);
+            break;
         case -8:
             CopyLeftToRight((double*)workingImage, (double*)referenceImage, (double*)referenceImage + size);
             break;
         default:
             throw std::runtime_error("acrion image tools: unsupported depth " + std::to_string(depth) + "in function CopyLeftToRight");
         }
+
+        // the scaling of stored to physical values belongs to the samples and is copied with them
+        const auto [referenceScale, referenceZero] = GetScaling(parameters, referenceScaleKey, referenceZeroKey);
+
+        result.data[io::ScaledBitmap::scaleKey] = referenceScale;
+        result.data[io::ScaledBitmap::zeroKey]  = referenceZero;
     }
     catch (const std::exception& ex)
     {
@@ -320,12 +862,21 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Co
         case 8:
             CopyRightToLeft((uint64_t*)workingImage, (uint64_t*)referenceImage, (uint64_t*)referenceImage + size);
             break;
+        case -4:
+            CopyRightToLeft((float*)workingImage, (float*)referenceImage, (float*)referenceImage + size);
+            break;
         case -8:
             CopyRightToLeft((double*)workingImage, (double*)referenceImage, (double*)referenceImage + size);
             break;
         default:
             throw std::runtime_error("acrion image tools: unsupported depth " + std::to_string(depth) + "in function CopyRightToLeft");
         }
+
+        // the scaling of stored to physical values belongs to the samples and is copied with them
+        const auto [workingScale, workingZero] = GetScaling(parameters, io::ScaledBitmap::scaleKey, io::ScaledBitmap::zeroKey);
+
+        result.data[referenceScaleKey] = workingScale;
+        result.data[referenceZeroKey]  = workingZero;
     }
     catch (const std::exception& ex)
     {
@@ -353,6 +904,8 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer In
 
         const size_t size = width * height * channels;
 
+        // Inverting maps [minBrightness, maxBrightness] linearly onto itself, so inverting the stored samples of a scaled image
+        // (see io::ScaledBitmap) inverts its physical values within their range as well, and the scaling stays valid.
         switch (depth)
         {
         case 1:
@@ -367,6 +920,9 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer In
         case 8:
             InvertImage((uint64_t*)workingImage, (uint64_t*)workingImage + size, (uint64_t)minBrightness, (uint64_t)maxBrightness);
             break;
+        case -4:
+            InvertImage((float*)workingImage, (float*)workingImage + size, (float)minBrightness, (float)maxBrightness);
+            break;
         case -8:
             InvertImage((double*)workingImage, (double*)workingImage + size, minBrightness, maxBrightness);
             break;
@@ -397,6 +953,28 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Su
         const auto channels       = parameters.get_mapped_value_or_throw<long long>(std::string(acrion::image::Bitmap::channelsKey));
         const auto depth          = parameters.get_mapped_value_or_throw<long long>(std::string(acrion::image::Bitmap::depthKey));
 
+        const auto [workingScale, workingZero]     = GetScaling(parameters, io::ScaledBitmap::scaleKey, io::ScaledBitmap::zeroKey);
+        const auto [referenceScale, referenceZero] = GetScaling(parameters, referenceScaleKey, referenceZeroKey);
+
+        if (workingScale != 1.0 || workingZero != 0.0 || referenceScale != 1.0 || referenceZero != 0.0)
+        {
+            // The stored samples of scaled images can't hold the physical difference, so it replaces the working image as doubles.
+            auto image = ToContainer(SubtractPhysical({referenceImage, referenceScale, referenceZero},
+                                                      {workingImage, workingScale, workingZero},
+                                                      (int)width,
+                                                      (int)height,
+                                                      (int)channels,
+                                                      (int)depth,
+                                                      (SubtractMode)mode));
+
+            image.data[io::ScaledBitmap::scaleKey] = 1.0;
+            image.data[io::ScaledBitmap::zeroKey]  = 0.0;
+
+            auto buffer = cbeam::serialization::serialize(image);
+            assert(buffer.use_count() > 1 && "Create an instance of cbeam::container::stable_reference_buffer::delay_deallocation prior using this function.");
+            return buffer.get();
+        }
+
         const size_t size = width * height * channels;
 
         switch (depth)
@@ -413,6 +991,9 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Su
         case 8:
             SubtractWorkingImageFromReference((uint64_t*)workingImage, (uint64_t*)referenceImage, (uint64_t*)referenceImage + size, mode);
             break;
+        case -4:
+            SubtractWorkingImageFromReference((float*)workingImage, (float*)referenceImage, (float*)referenceImage + size, mode);
+            break;
         case -8:
             SubtractWorkingImageFromReference((double*)workingImage, (double*)referenceImage, (double*)referenceImage + size, mode);
             break;
@@ -443,6 +1024,28 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Su
         const auto channels       = parameters.get_mapped_value_or_throw<long long>(std::string(acrion::image::Bitmap::channelsKey));
         const auto depth          = parameters.get_mapped_value_or_throw<long long>(std::string(acrion::image::Bitmap::depthKey));
 
+        const auto [workingScale, workingZero]     = GetScaling(parameters, io::ScaledBitmap::scaleKey, io::ScaledBitmap::zeroKey);
+        const auto [referenceScale, referenceZero] = GetScaling(parameters, referenceScaleKey, referenceZeroKey);
+
+        if (workingScale != 1.0 || workingZero != 0.0 || referenceScale != 1.0 || referenceZero != 0.0)
+        {
+            // The stored samples of scaled images can't hold the physical difference, so it replaces the working image as doubles.
+            auto image = ToContainer(SubtractPhysical({workingImage, workingScale, workingZero},
+                                                      {referenceImage, referenceScale, referenceZero},
+                                                      (int)width,
+                                                      (int)height,
+                                                      (int)channels,
+                                                      (int)depth,
+                                                      (SubtractMode)mode));
+
+            image.data[io::ScaledBitmap::scaleKey] = 1.0;
+            image.data[io::ScaledBitmap::zeroKey]  = 0.0;
+
+            auto buffer = cbeam::serialization::serialize(image);
+            assert(buffer.use_count() > 1 && "Create an instance of cbeam::container::stable_reference_buffer::delay_deallocation prior using this function.");
+            return buffer.get();
+        }
+
         const size_t size = width * height * channels;
 
         switch (depth)
@@ -459,6 +1062,9 @@ extern "C" ACRION_IMAGE_TOOLS_EXPORT acrion::image::SerializedBitmapContainer Su
         case 8:
             SubtractReferenceFromWorkingImage((uint64_t*)workingImage, (uint64_t*)referenceImage, (uint64_t*)referenceImage + size, mode);
             break;
+        case -4:
+            SubtractReferenceFromWorkingImage((float*)workingImage, (float*)referenceImage, (float*)referenceImage + size, mode);
+            break;
         case -8:
             SubtractReferenceFromWorkingImage((double*)workingImage, (double*)referenceImage, (double*)referenceImage + size, mode);
             break;
@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "memory_map.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace acrion::imagetools
+{
+#ifdef _WIN32
+    MemoryMap::MemoryMap(const std::filesystem::path& path)
+    {
+        _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (_file == INVALID_HANDLE_VALUE)
+        {
+            _file = nullptr;
+            throw std::runtime_error("acrion::imagetools::MemoryMap: cannot open '" + path.string() + "'");
+        }
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(_file, &size);
+        _size = (size_t)size.QuadPart;
+
+        if (_size == 0)
+        {
+            return; // empty files cannot be mapped
+        }
+
+        _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        _data    = _mapping ? (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        if (!_data)
+        {
+            if (_mapping)
+            {
+                CloseHandle(_mapping);
+            }
+            CloseHandle(_file);
+            throw std::runtime_error("acrion::imagetools::MemoryMap: cannot map '" + path.string() + "'");
+        }
+    }
+
+    MemoryMap::~MemoryMap()
+    {
+        if (_data)
+        {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping)
+        {
+            CloseHandle(_mapping);
+        }
+        if (_file)
+        {
+            CloseHandle(_file);
+        }
+    }
+
+    void MemoryMap::WillReadSequentially(size_t, size_t) const
+    {
+        // FILE_FLAG_SEQUENTIAL_SCAN already enables read-ahead for the whole file
+    }
+#else
+    MemoryMap::MemoryMap(const std::filesystem::path& path)
+    {
+        const int file = open(path.c_str(), O_RDONLY);
+
+        if (file < 0)
+        {
+            throw std::runtime_error("acrion::imagetools::MemoryMap: cannot open '" + path.string() + "'");
+        }
+
+        struct stat status;
+
+        if (fstat(file, &status) != 0)
+        {
+            close(file);
+            throw std::runtime_error("acrion::imagetools::MemoryMap: cannot determine the size of '" + path.string() + "'");
+        }
+
+        _size = (size_t)status.st_size;
+
+        if (_size > 0) // empty files cannot be mapped
+        {
+            void* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, file, 0);
+
+            if (data == MAP_FAILED)
+            {
+                close(file);
+                throw std::runtime_error("acrion::imagetools::MemoryMap: cannot map '" + path.string() + "'");
+            }
+
+            _data = (const uint8_t*)data;
+        }
+
+        close(file); // the mapping keeps its own reference to the file
+    }
+
+    MemoryMap::~MemoryMap()
+    {
+        if (_data)
+        {
+            munmap((void*)_data, _size);
+        }
+    }
+
+    void MemoryMap::WillReadSequentially(size_t offset, size_t length) const
+    {
+        if (!_data || offset >= _size)
+        {
+            return;
+        }
+
+        // madvise needs a page aligned start address
+        const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        const size_t start    = offset / pageSize * pageSize;
+        length                = std::min(length + (offset - start), _size - start);
+
+        madvise((void*)(_data + start), length, MADV_SEQUENTIAL);
+        madvise((void*)(_data + start), length, MADV_WILLNEED);
+    }
+#endif
+}
@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace acrion::imagetools
+{
+    // Maps a whole file read-only into memory, for as long as the object exists.
+    class MemoryMap
+    {
+    public:
+        explicit MemoryMap(const std::filesystem::path& path);
+        ~MemoryMap();
+
+        MemoryMap(const MemoryMap&)            = delete;
+        MemoryMap& operator=(const MemoryMap&) = delete;
+
+        const uint8_t* Data() const { return _data; }
+        size_t         Size() const { return _size; }
+
+        // Tells the operating system that the given range will be read sequentially soon, so it can read ahead aggressively.
+        void WillReadSequentially(size_t offset, size_t length) const;
+
+    private:
+        const uint8_t* _data = nullptr;
+        size_t         _size = 0;
+#ifdef _WIN32
+        void* _file    = nullptr;
+        void* _mapping = nullptr;
+#endif
+    };
+}
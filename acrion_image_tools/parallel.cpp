@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "parallel.hpp"
+
+#include <omp.h>
+
+#include <atomic>
+
+namespace acrion::imagetools::parallel
+{
+    namespace
+    {
+        std::atomic<int>    threadCount{0};
+        std::atomic<size_t> minimumParallelSize{4 * 1024 * 1024};
+        thread_local bool   serial = false;
+    }
+
+    void SetThreadCount(int count)
+    {
+        threadCount = std::max(count, 0);
+    }
+
+    int GetThreadCount()
+    {
+        return threadCount;
+    }
+
+    void SetMinimumParallelSize(size_t bytes)
+    {
+        minimumParallelSize = bytes;
+    }
+
+    size_t GetMinimumParallelSize()
+    {
+        return minimumParallelSize;
+    }
+
+    int ThreadsFor(size_t bytes)
+    {
+        if (serial || bytes < minimumParallelSize)
+        {
+            return 1;
+        }
+
+        const int configured = threadCount;
+        return configured > 0 ? configured : omp_get_max_threads();
+    }
+
+    SerialScope::SerialScope()
+        : _previous(serial)
+    {
+        serial = true;
+    }
+
+    SerialScope::~SerialScope()
+    {
+        serial = _previous;
+    }
+}
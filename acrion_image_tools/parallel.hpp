@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "acrion_image_tools_export.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace acrion::imagetools::parallel
+{
+    /// Sets the maximum number of threads used by the multi-threaded image kernels. 0 (the default) uses OpenMP's default, i.e. one thread per core.
+    ACRION_IMAGE_TOOLS_EXPORT void SetThreadCount(int threadCount);
+    ACRION_IMAGE_TOOLS_EXPORT int  GetThreadCount();
+
+    /// Sets the workload size in bytes below which the image kernels stay single-threaded, because the thread start-up would cost more than it saves.
+    ACRION_IMAGE_TOOLS_EXPORT void   SetMinimumParallelSize(size_t bytes);
+    ACRION_IMAGE_TOOLS_EXPORT size_t GetMinimumParallelSize();
+
+    /// Returns the number of threads to use for a workload of the given size, considering the settings above.
+    int ThreadsFor(size_t bytes);
+
+    /// Keeps the image kernels called by the current thread single-threaded while it exists, for callers that already run one task per core.
+    class SerialScope
+    {
+    public:
+        SerialScope();
+        ~SerialScope();
+
+        SerialScope(const SerialScope&)            = delete;
+        SerialScope& operator=(const SerialScope&) = delete;
+
+    private:
+        bool _previous;
+    };
+
+    /// Splits `rows` into one contiguous band per thread and calls `function(firstRow, rowCount)` for each band concurrently.
+    /// `function` must not throw.
+    template <typename Function>
+    void ForEachBand(size_t rows, size_t bytesPerRow, Function&& function)
+    {
+        const int threads = rows > 1 ? ThreadsFor(rows * bytesPerRow) : 1;
+
+        if (threads <= 1)
+        {
+            function((size_t)0, rows);
+            return;
+        }
+
+        const int bands = (int)std::min<size_t>(threads, rows);
+
+#pragma omp parallel for num_threads(bands) schedule(static)
+        for (int band = 0; band < bands; ++band)
+        {
+            const size_t firstRow = rows * band / bands;
+            const size_t lastRow  = rows * (band + 1) / bands;
+            function(firstRow, lastRow - firstRow);
+        }
+    }
+}
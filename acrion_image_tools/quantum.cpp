@@ -0,0 +1,264 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "quantum.hpp"
+
+#include "cpu.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef ACRION_IMAGE_TOOLS_X86
+    #include <immintrin.h>
+#endif
+
+namespace acrion::imagetools
+{
+    namespace
+    {
+        template <typename T>
+        void ConvertScalar(const uint32_t* source, T* destination, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                destination[i] = (T)source[i];
+            }
+        }
+
+#ifdef ACRION_IMAGE_TOOLS_X86
+        ACRION_IMAGE_TOOLS_TARGET("sse2")
+        void ConvertSse2(const uint32_t* source, uint8_t* destination, size_t count)
+        {
+            const __m128i lowByte = _mm_set1_epi32(0xff);
+            size_t        i       = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+                // masked values are <= 255, so the saturating packs cannot alter them
+                const __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*)(source + i)), lowByte);
+                const __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*)(source + i + 4)), lowByte);
+                const __m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i*)(source + i + 8)), lowByte);
+                const __m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i*)(source + i + 12)), lowByte);
+                _mm_storeu_si128((__m128i*)(destination + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+            }
+
+            ConvertScalar(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("sse2")
+        void ConvertSse2(const uint32_t* source, uint16_t* destination, size_t count)
+        {
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                // sign-extend the low 16 bits, so that the signed saturating pack passes them through unchanged
+                const __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i*)(source + i)), 16), 16);
+                const __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i*)(source + i + 4)), 16), 16);
+                _mm_storeu_si128((__m128i*)(destination + i), _mm_packs_epi32(a, b));
+            }
+
+            ConvertScalar(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("sse2")
+        void ConvertSse2(const uint32_t* source, uint64_t* destination, size_t count)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            size_t        i    = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+                const __m128i a = _mm_loadu_si128((const __m128i*)(source + i));
+                _mm_storeu_si128((__m128i*)(destination + i), _mm_unpacklo_epi32(a, zero));
+                _mm_storeu_si128((__m128i*)(destination + i + 2), _mm_unpackhi_epi32(a, zero));
+            }
+
+            ConvertScalar(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("avx2")
+        void ConvertAvx2(const uint32_t* source, uint8_t* destination, size_t count)
+        {
+            const __m256i lowByte = _mm256_set1_epi32(0xff);
+            const __m256i order   = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            size_t        i       = 0;
+
+            for (; i + 32 <= count; i += 32)
+            {
+                const __m256i a = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(source + i)), lowByte);
+                const __m256i b = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(source + i + 8)), lowByte);
+                const __m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(source + i + 16)), lowByte);
+                const __m256i d = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(source + i + 24)), lowByte);
+
+                // the packs operate per 128 bit lane, so the resulting groups of four bytes need to be put back in order
+                const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+                _mm256_storeu_si256((__m256i*)(destination + i), _mm256_permutevar8x32_epi32(packed, order));
+            }
+
+            ConvertSse2(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("avx2")
+        void ConvertAvx2(const uint32_t* source, uint16_t* destination, size_t count)
+        {
+            size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m256i a = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(source + i)), 16), 16);
+                const __m256i b = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(source + i + 8)), 16), 16);
+                _mm256_storeu_si256((__m256i*)(destination + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+            }
+
+            ConvertSse2(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("avx2")
+        void ConvertAvx2(const uint32_t* source, uint64_t* destination, size_t count)
+        {
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                _mm256_storeu_si256((__m256i*)(destination + i), _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(source + i))));
+                _mm256_storeu_si256((__m256i*)(destination + i + 4), _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(source + i + 4))));
+            }
+
+            ConvertSse2(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("avx512f,avx512bw")
+        void ConvertAvx512(const uint32_t* source, uint8_t* destination, size_t count)
+        {
+            size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+                _mm_storeu_si128((__m128i*)(destination + i), _mm512_cvtepi32_epi8(_mm512_loadu_si512(source + i)));
+            }
+
+            ConvertScalar(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("avx512f,avx512bw")
+        void ConvertAvx512(const uint32_t* source, uint16_t* destination, size_t count)
+        {
+            size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+                _mm256_storeu_si256((__m256i*)(destination + i), _mm512_cvtepi32_epi16(_mm512_loadu_si512(source + i)));
+            }
+
+            ConvertScalar(source + i, destination + i, count - i);
+        }
+
+        ACRION_IMAGE_TOOLS_TARGET("avx512f,avx512bw")
+        void ConvertAvx512(const uint32_t* source, uint64_t* destination, size_t count)
+        {
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                _mm512_storeu_si512(destination + i, _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)(source + i))));
+            }
+
+            ConvertScalar(source + i, destination + i, count - i);
+        }
+#endif
+
+        template <typename T>
+        using Kernel = void (*)(const uint32_t*, T*, size_t);
+
+        template <typename T>
+        Kernel<T> SelectKernel(cpu::InstructionSet instructionSet)
+        {
+#ifdef ACRION_IMAGE_TOOLS_X86
+            switch (instructionSet)
+            {
+            case cpu::InstructionSet::Avx512:
+                return static_cast<Kernel<T>>(&ConvertAvx512);
+            case cpu::InstructionSet::Avx2:
+                return static_cast<Kernel<T>>(&ConvertAvx2);
+            case cpu::InstructionSet::Sse2:
+                return static_cast<Kernel<T>>(&ConvertSse2);
+            default:
+                break;
+            }
+#endif
+            return &ConvertScalar<T>;
+        }
+
+        template <typename T>
+        Kernel<T> SelectSupportedKernel(cpu::InstructionSet instructionSet)
+        {
+            if (instructionSet > cpu::Detect())
+            {
+                throw std::invalid_argument("acrion::imagetools::ConvertQuantum: the instruction set is not supported by this CPU");
+            }
+
+            return SelectKernel<T>(instructionSet);
+        }
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint8_t* destination, size_t count)
+    {
+        static const Kernel<uint8_t> kernel = SelectKernel<uint8_t>(cpu::Detect());
+        kernel(source, destination, count);
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint16_t* destination, size_t count)
+    {
+        static const Kernel<uint16_t> kernel = SelectKernel<uint16_t>(cpu::Detect());
+        kernel(source, destination, count);
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint32_t* destination, size_t count)
+    {
+        std::memcpy(destination, source, count * sizeof(uint32_t));
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint64_t* destination, size_t count)
+    {
+        static const Kernel<uint64_t> kernel = SelectKernel<uint64_t>(cpu::Detect());
+        kernel(source, destination, count);
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint8_t* destination, size_t count, cpu::InstructionSet instructionSet)
+    {
+        SelectSupportedKernel<uint8_t>(instructionSet)(source, destination, count);
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint16_t* destination, size_t count, cpu::InstructionSet instructionSet)
+    {
+        SelectSupportedKernel<uint16_t>(instructionSet)(source, destination, count);
+    }
+
+    void ConvertQuantum(const uint32_t* source, uint64_t* destination, size_t count, cpu::InstructionSet instructionSet)
+    {
+        SelectSupportedKernel<uint64_t>(instructionSet)(source, destination, count);
+    }
+}
@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "reduce.hpp"
+#include "parallel.hpp"
+
+#include "acrion/image/bitmap_data.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace acrion::imagetools
+{
+    namespace
+    {
+        template <typename T>
+        std::shared_ptr<acrion::image::Bitmap> ReduceBitmap(const acrion::image::Bitmap& bitmap, int factor, io::Reduction reduction)
+        {
+            const int    channels   = bitmap.Channels();
+            const size_t width      = (size_t)bitmap.Width() / factor;
+            const size_t height     = (size_t)bitmap.Height() / factor;
+            const size_t rowSamples = (size_t)bitmap.Width() * channels;
+            const size_t firstRow   = (size_t)bitmap.Height() % factor; // blocks start at the bottom, so left over rows are at the top
+            const T*     source     = (const T*)bitmap.Buffer() + firstRow * rowSamples;
+            auto         result     = std::make_shared<acrion::image::BitmapData<T>>((int)width, (int)height, channels);
+            T*           pixels     = (T*)result->Buffer();
+            std::mutex   mutex;
+            double       min = std::numeric_limits<double>::max();
+            double       max = std::numeric_limits<double>::lowest();
+
+            parallel::ForEachBand(height,
+                                  rowSamples * sizeof(T) * (reduction == io::Reduction::Bin ? factor : 1),
+                                  [&](size_t first, size_t count)
+                                  {
+                                      std::vector<BinSum<T>> sums(reduction == io::Reduction::Bin ? width * channels : 0);
+                                      T                      bandMin = std::numeric_limits<T>::max();
+                                      T                      bandMax = std::numeric_limits<T>::lowest();
+
+                                      for (size_t row = first; row < first + count; ++row)
+                                      {
+                                          const T* in  = source + row * factor * rowSamples;
+                                          T*       out = pixels + row * width * channels;
+
+                                          if (reduction == io::Reduction::Bin)
+                                          {
+                                              std::fill(sums.begin(), sums.end(), BinSum<T>());
+
+                                              for (int line = 0; line < factor; ++line)
+                                              {
+                                                  AddBinnedRow(in + line * rowSamples, width, channels, factor, sums.data());
+                                              }
+
+                                              StoreBinnedRow(sums.data(), width * channels, factor, out);
+                                          }
+                                          else
+                                          {
+                                              // the bottom row of the block, which is the first one in FITS order
+                                              DecimateRow(in + (factor - 1) * rowSamples, width, channels, factor, out);
+                                          }
+
+                                          for (size_t i = 0; i < width * channels; ++i)
+                                          {
+                                              bandMin = std::min(bandMin, out[i]);
+                                              bandMax = std::max(bandMax, out[i]);
+                                          }
+                                      }
+
+                                      std::lock_guard<std::mutex> lock(mutex);
+                                      min = std::min(min, (double)bandMin);
+                                      max = std::max(max, (double)bandMax);
+                                  });
+
+            result->SetBrightnessRangeForDisplay(min, max);
+            return result;
+        }
+    }
+
+    std::shared_ptr<acrion::image::Bitmap> ReduceBitmap(const acrion::image::Bitmap& bitmap, int factor, io::Reduction reduction)
+    {
+        if (factor < 1 || factor > bitmap.Width() || factor > bitmap.Height())
+        {
+            throw std::runtime_error("acrion::imagetools::ReduceBitmap: invalid factor " + std::to_string(factor) + " for an image of " + std::to_string(bitmap.Width()) + "x" + std::to_string(bitmap.Height()) + " pixels");
+        }
+
+        std::shared_ptr<acrion::image::Bitmap> result;
+
+        switch (bitmap.Depth())
+        {
+        case 1:
+            result = ReduceBitmap<uint8_t>(bitmap, factor, reduction);
+            break;
+        case 2:
+            result = ReduceBitmap<uint16_t>(bitmap, factor, reduction);
+            break;
+        case 4:
+            result = ReduceBitmap<uint32_t>(bitmap, factor, reduction);
+            break;
+        case 8:
+            result = ReduceBitmap<uint64_t>(bitmap, factor, reduction);
+            break;
+        case -4:
+            result = ReduceBitmap<float>(bitmap, factor, reduction);
+            break;
+        case -8:
+            result = ReduceBitmap<double>(bitmap, factor, reduction);
+            break;
+        default:
+            throw std::runtime_error("acrion::imagetools::ReduceBitmap: unsupported image depth " + std::to_string(bitmap.Depth()));
+        }
+
+        // averages and picked samples of the stored values have the same scaling
+        if (const auto* scaled = dynamic_cast<const io::ScaledBitmap*>(&bitmap))
+        {
+            return std::make_shared<io::ScaledBitmap>(*result, scaled->Scale(), scaled->Zero());
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2025 acrion innovations GmbH
+Authors: Stefan Zipproth, s.zipproth@acrion.ch
+
+This file is part of acrion image tools, see https://github.com/acrion/image-tools
+
+acrion image tools is offered under a commercial and under the AGPL license.
+For commercial licensing, contact us at https://acrion.ch/sales. For AGPL licensing, see below.
+
+AGPL licensing:
+
+acrion image tools is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+acrion image tools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "io.hpp"
+
+#include "acrion/image/bitmap.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace acrion::imagetools
+{
+    // Type in which the samples of a block are summed for binning: integers of up to 32 bits exactly, all others as double
+    template <typename T>
+    using BinSum = std::conditional_t<std::is_integral_v<T> && sizeof(T) < 8, std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>, double>;
+
+    // Adds the samples of each block of `factor` neighbouring pixels of `row` to the `width` x `channels` sums of the blocks
+    template <typename T>
+    void AddBinnedRow(const T* row, size_t width, int channels, int factor, BinSum<T>* sums)
+    {
+        const size_t blockSamples = (size_t)factor * channels;
+
+        for (size_t column = 0; column < width; ++column, row += blockSamples, sums += channels)
+        {
+            for (size_t sample = 0; sample < blockSamples; sample += channels)
+            {
+                for (int channel = 0; channel < channels; ++channel)
+                {
+                    sums[channel] += row[sample + channel];
+                }
+            }
+        }
+    }
+
+    // Stores the averages of `count` blocks of `factor` x `factor` pixels, rounded to the nearest integer for integer samples
+    template <typename T>
+    void StoreBinnedRow(const BinSum<T>* sums, size_t count, int factor, T* out)
+    {
+        const double pixels = (double)factor * factor;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if constexpr (std::is_integral_v<T>)
+            {
+                out[i] = (T)std::round((double)sums[i] / pixels);
+            }
+            else
+            {
+                out[i] = (T)(sums[i] / pixels);
+            }
+        }
+    }
+
+    // Copies the first pixel of each block of `factor` neighbouring pixels of `row`
+    template <typename T>
+    void DecimateRow(const T* row, size_t width, int channels, int factor, T* out)
+    {
+        const size_t blockSamples = (size_t)factor * channels;
+
+        for (size_t column = 0; column < width; ++column, row += blockSamples, out += channels)
+        {
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                out[channel] = row[channel];
+            }
+        }
+    }
+
+    // Reduces the width and height of a bitmap by `factor` (see io::ReadReduced) on all cores and sets the brightness range of
+    // the result to its exact value range. io::ScaledBitmap keeps its scaling.
+    std::shared_ptr<acrion::image::Bitmap> ReduceBitmap(const acrion::image::Bitmap& bitmap, int factor, io::Reduction reduction);
+}
@@ -23,12 +23,139 @@ You should have received a copy of the GNU Affero General Public License
 along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include "arithmetic.hpp"
+#include "byteswap.hpp"
+#include "fits_index.hpp"
+#include "io.hpp"
+#include "parallel.hpp"
+#include "quantum.hpp"
+
+#include "acrion/image/bitmap_data.hpp"
+
 #include <cbeam/lifecycle/singleton.hpp>
 
 #include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 // using namespace acrion::imagetools;
 
+// cfitsio's byte swapping routines, implemented by byteswap.cpp
+extern "C"
+{
+    void ffswap2(short* values, long count);
+    void ffswap4(int* values, long count);
+    void ffswap8(double* values, long count);
+}
+
+namespace
+{
+    // Reverses the byte order of each sample and XORs it with the low bytes of `flip`, as SwapBytes specifies
+    std::vector<uint8_t> SwapReference(const uint8_t* source, size_t count, int sampleSize, uint64_t flip)
+    {
+        std::vector<uint8_t> swapped(count * sampleSize);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (int byte = 0; byte < sampleSize; ++byte)
+            {
+                // on little-endian hosts, byte n of `flip` belongs to the byte at offset n of the native sample
+                swapped[i * sampleSize + byte] = source[i * sampleSize + sampleSize - 1 - byte] ^ (uint8_t)(flip >> (8 * byte));
+            }
+        }
+
+        return swapped;
+    }
+
+    // A header card with a value, e.g. FitsCard("BZERO", "32768")
+    std::string FitsCard(const std::string& keyword, const std::string& value)
+    {
+        std::string card = keyword;
+        card.resize(8, ' ');
+        card += "= ";
+        card += std::string(value.size() < 20 ? 20 - value.size() : 0, ' ') + value;
+        card.resize(80, ' ');
+        return card;
+    }
+
+    // Appends an image HDU with the given samples (rows from bottom to top, as in FITS files) and additional header cards to `file`,
+    // for files that io::Write does not produce, e.g. with signed integers, scaling, several HDUs or more than two axes.
+    template <typename T>
+    void AppendFitsImage(std::string& file, int bitpix, const std::vector<long>& axes, const std::vector<T>& samples, const std::vector<std::string>& cards = {})
+    {
+        std::string header = file.empty() ? FitsCard("SIMPLE", "T") : FitsCard("XTENSION", "'IMAGE   '");
+        header += FitsCard("BITPIX", std::to_string(bitpix));
+        header += FitsCard("NAXIS", std::to_string(axes.size()));
+
+        for (size_t axis = 0; axis < axes.size(); ++axis)
+        {
+            header += FitsCard("NAXIS" + std::to_string(axis + 1), std::to_string(axes[axis]));
+        }
+
+        header += file.empty() ? FitsCard("EXTEND", "T") : FitsCard("PCOUNT", "0") + FitsCard("GCOUNT", "1");
+
+        for (const std::string& card : cards)
+        {
+            header += card;
+        }
+
+        header += "END";
+        header.resize((header.size() + 2879) / 2880 * 2880, ' ');
+        file += header;
+
+        const size_t dataStart = file.size();
+
+        for (const T& sample : samples)
+        {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, &sample, sizeof(T));
+            file.append(std::make_reverse_iterator(bytes + sizeof(T)), std::make_reverse_iterator(bytes)); // FITS is big-endian
+        }
+
+        file.resize(dataStart + (file.size() - dataStart + 2879) / 2880 * 2880, '\0');
+    }
+
+    void WriteFile(const std::filesystem::path& path, const std::string& content)
+    {
+        std::ofstream output(path, std::ios::binary);
+        output.write(content.data(), (std::streamsize)content.size());
+    }
+
+    // Compares the samples of a bitmap, whose rows are from top to bottom, with samples in the order of a FITS file
+    template <typename T>
+    bool MatchesFitsSamples(const acrion::image::Bitmap& bitmap, const std::vector<T>& samples)
+    {
+        const T*     pixels = (const T*)bitmap.Buffer();
+        const size_t width  = bitmap.Width();
+
+        for (size_t row = 0; row < (size_t)bitmap.Height(); ++row)
+        {
+            if (std::memcmp(pixels + (bitmap.Height() - 1 - row) * width, samples.data() + row * width, width * sizeof(T)) != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
 class ImageToolsTest : public ::testing::Test
 {
 protected:
@@ -46,3 +173,2413 @@ protected:
 TEST_F(ImageToolsTest, BasicAssertions)
 {
 }
+
+TEST_F(ImageToolsTest, ConcurrentFitsReads)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int fileCount  = 8;
+    constexpr int width      = 257;
+    constexpr int height     = 131;
+    constexpr int iterations = 40;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_fits";
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0); // every read has to go through cfitsio
+
+    std::vector<std::wstring>          paths;
+    std::vector<std::vector<uint16_t>> expected;
+
+    for (int file = 0; file < fileCount; ++file)
+    {
+        acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+        uint16_t*                           pixels = (uint16_t*)bitmap.Buffer();
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            pixels[i] = (uint16_t)(file * 7919 + i * 31);
+        }
+
+        std::string warning;
+        paths.push_back((directory / ("image" + std::to_string(file) + ".fits")).wstring());
+        expected.emplace_back(pixels, pixels + width * height);
+        io::Write(bitmap, paths.back(), warning);
+    }
+
+    std::atomic<int>         failures{0};
+    std::vector<std::thread> threads;
+    const int                threadCount = (int)std::max(8u, std::thread::hardware_concurrency());
+
+    for (int thread = 0; thread < threadCount; ++thread)
+    {
+        threads.emplace_back(
+            [&, thread]
+            {
+                for (int iteration = 0; iteration < iterations; ++iteration)
+                {
+                    const int file = (thread * 13 + iteration) % fileCount;
+
+                    try
+                    {
+                        std::string warning;
+
+                        if (iteration % 2)
+                        {
+                            const auto bitmap = io::Read(paths[file], warning);
+
+                            if (bitmap->Depth() != 2 || std::memcmp(bitmap->Buffer(), expected[file].data(), expected[file].size() * sizeof(uint16_t)) != 0)
+                            {
+                                ++failures;
+                            }
+                        }
+                        else
+                        {
+                            const auto region = io::ReadRegion(paths[file], 10, 20, 100, 50, warning);
+
+                            for (int row = 0; row < 50; ++row)
+                            {
+                                if (std::memcmp((const uint16_t*)region->Buffer() + row * 100, expected[file].data() + (20 + row) * width + 10, 100 * sizeof(uint16_t)) != 0)
+                                {
+                                    ++failures;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                    catch (const std::exception&)
+                    {
+                        ++failures;
+                    }
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+
+    EXPECT_EQ(failures, 0);
+}
+
+TEST_F(ImageToolsTest, DisplayRangeIgnoresHotPixels)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 640;
+    constexpr int height = 480;
+
+    // a flat background of 1000 +- 50 with every 500th pixel saturated
+    acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+    uint16_t*                           pixels = (uint16_t*)bitmap.Buffer();
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        pixels[i] = i % 500 == 0 ? 65535 : (uint16_t)(950 + (i * 37) % 101);
+    }
+
+    io::DisplayRangeOptions options;
+
+    options.mode                    = io::DisplayRangeMode::Exact;
+    const auto [exactMin, exactMax] = io::ComputeDisplayRange(bitmap, options);
+    EXPECT_EQ(exactMin, 950);
+    EXPECT_EQ(exactMax, 65535);
+
+    options.mode                              = io::DisplayRangeMode::Percentile;
+    const auto [percentileMin, percentileMax] = io::ComputeDisplayRange(bitmap, options);
+    EXPECT_GE(percentileMin, 950);
+    EXPECT_LE(percentileMax, 1050);
+
+    options.mode                      = io::DisplayRangeMode::ZScale;
+    const auto [zscaleMin, zscaleMax] = io::ComputeDisplayRange(bitmap, options);
+    EXPECT_GE(zscaleMin, 950);
+    EXPECT_LE(zscaleMax, 1050);
+    EXPECT_LT(zscaleMin, zscaleMax);
+}
+
+TEST_F(ImageToolsTest, FitsIndexQueriesHeaders)
+{
+    namespace io = acrion::imagetools::io;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_index";
+    const std::filesystem::path indexPath = std::filesystem::temp_directory_path() / "acrion_image_tools_test_index.bin";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "night2");
+
+    // header only FITS files, padded to one block of 36 cards with 80 characters each
+    auto writeHeader = [](const std::filesystem::path& path, const std::vector<std::string>& cards)
+    {
+        std::string header;
+        for (const std::string& card : cards)
+        {
+            header += (card + std::string(80, ' ')).substr(0, 80);
+        }
+        header += "END" + std::string(77, ' ');
+        header.resize(2880, ' ');
+
+        std::ofstream(path, std::ios::binary) << header;
+    };
+
+    const std::vector<std::string> base = {"SIMPLE  =                    T", "BITPIX  =                   16", "NAXIS   =                    0"};
+
+    auto card = [](const std::string& keyword, const std::string& value)
+    { return (keyword + std::string(8, ' ')).substr(0, 8) + "= " + value; };
+
+    std::vector<std::string> cards = base;
+    cards.insert(cards.end(), {card("EXPTIME", "300."), card("FILTER", "'R       '"), card("AIRMASS", "1.2")});
+    writeHeader(directory / "a.fits", cards);
+
+    cards = base;
+    cards.insert(cards.end(), {card("EXPTIME", "3.0D+02"), card("FILTER", "'V'"), card("AIRMASS", "1.8")});
+    writeHeader(directory / "night2" / "b.fit", cards);
+
+    cards = base;
+    cards.insert(cards.end(), {card("EXPTIME", "60"), card("FILTER", "'r'")});
+    writeHeader(directory / "night2" / "c.fits", cards);
+
+    cards = base;
+    cards.insert(cards.end(), {card("EXPTIME", "120"), card("FILTER", "'B'")});
+    writeHeader(directory / "night2" / "d.fits", cards);
+    {
+        std::ifstream     input(directory / "night2" / "d.fits", std::ios::binary);
+        const std::string header((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        gzFile            output = gzopen((directory / "night2" / "d.fits.gz").string().c_str(), "wb1");
+        ASSERT_NE(output, nullptr);
+        gzwrite(output, header.data(), (unsigned)header.size());
+        gzclose(output);
+    }
+    std::filesystem::remove(directory / "night2" / "d.fits");
+
+    writeHeader(directory / "notes.txt", base);
+
+    {
+        io::FitsIndex                       index(indexPath.wstring(), {"EXPTIME", "FILTER", "AIRMASS"});
+        const io::FitsIndexUpdateStatistics statistics = index.Update(directory.wstring());
+
+        EXPECT_EQ(statistics.files, 4);
+        EXPECT_EQ(statistics.read, 4);
+        EXPECT_EQ(statistics.failed, 0);
+    }
+
+    io::FitsIndex index(indexPath.wstring()); // keywords from the index file
+    ASSERT_EQ(index.Entries().size(), 4);
+
+    auto query = [&](const std::string& conditions)
+    {
+        std::vector<std::string> names;
+        for (const std::wstring& path : index.Query(io::FitsIndex::ParseQuery(conditions)))
+        {
+            names.push_back(std::filesystem::path(path).filename().string());
+        }
+        return names;
+    };
+
+    EXPECT_EQ(query("EXPTIME=300"), (std::vector<std::string>{"a.fits", "b.fit"}));
+    EXPECT_EQ(query("EXPTIME=300, FILTER=r"), std::vector<std::string>{"a.fits"});
+    EXPECT_EQ(query("FILTER='R' AIRMASS<1.5"), std::vector<std::string>{"a.fits"});
+    EXPECT_EQ(query("AIRMASS>=1"), (std::vector<std::string>{"a.fits", "b.fit"})); // c.fits lacks AIRMASS
+    EXPECT_EQ(query("EXPTIME!=300"), (std::vector<std::string>{"c.fits", "d.fits.gz"}));
+    EXPECT_EQ(query("FILTER=b"), std::vector<std::string>{"d.fits.gz"});
+    EXPECT_THROW(query("GAIN=1"), std::runtime_error);
+    EXPECT_THROW(query("EXPTIME 300"), std::runtime_error);
+
+    std::filesystem::remove(directory / "night2" / "c.fits");
+    const io::FitsIndexUpdateStatistics statistics = index.Update(directory.wstring());
+
+    EXPECT_EQ(statistics.files, 3);
+    EXPECT_EQ(statistics.read, 0); // unchanged files are not opened again
+    EXPECT_EQ(statistics.removed, 1);
+    EXPECT_EQ(query("FILTER=r"), std::vector<std::string>{"a.fits"});
+
+    // an entry count whose product with the minimal entry size wraps around to 4 must not pass the size check
+    std::string corrupt = "AITFIDX1";
+    corrupt += std::string(4, '\0'); // no keywords
+    for (int i = 0; i < 8; ++i)
+    {
+        corrupt.push_back((char)(0x0CCCCCCCCCCCCCCDull >> (8 * i)));
+    }
+    corrupt += std::string(4, '\0');
+    std::ofstream(indexPath, std::ios::binary | std::ios::trunc) << corrupt;
+
+    try
+    {
+        io::FitsIndex corruptIndex(indexPath.wstring());
+        ADD_FAILURE() << "corrupt index file was accepted";
+    }
+    catch (const std::runtime_error& ex)
+    {
+        EXPECT_NE(std::string(ex.what()).find("unexpected end of file"), std::string::npos) << ex.what();
+    }
+
+    std::filesystem::remove_all(directory);
+    std::filesystem::remove(indexPath);
+}
+
+TEST_F(ImageToolsTest, GzipFitsRegionsReadThroughIndex)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 1024;
+    constexpr int height = 1536; // 3 MiB, so that the index has checkpoints within the image
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_gzip";
+    const std::filesystem::path plain     = directory / "image.fits";
+    const std::filesystem::path packed    = directory / "image.fits.gz";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+    uint16_t*                           pixels = (uint16_t*)bitmap.Buffer();
+    uint32_t                            random = 1;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        random    = random * 1103515245 + 12345;
+        pixels[i] = (uint16_t)(random >> 16);
+    }
+
+    std::string warning;
+    io::Write(bitmap, plain.wstring(), warning);
+
+    {
+        std::ifstream     input(plain, std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        gzFile            output = gzopen(packed.string().c_str(), "wb1");
+        ASSERT_NE(output, nullptr);
+        EXPECT_EQ(gzwrite(output, content.data(), (unsigned)content.size()), (int)content.size());
+        gzclose(output);
+    }
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0);
+
+    for (const auto& [x, y, w, h] : std::vector<std::tuple<int, int, int, int>>{{0, 0, 16, 16}, {100, 1400, 300, 136}, {500, 700, 10, 400}, {0, 0, width, height}})
+    {
+        const auto expected = io::ReadRegion(plain.wstring(), x, y, w, h, warning);
+        const auto region   = io::ReadRegion(packed.wstring(), x, y, w, h, warning);
+
+        ASSERT_EQ(region->Width(), w);
+        ASSERT_EQ(region->Height(), h);
+        EXPECT_EQ(std::memcmp(region->Buffer(), expected->Buffer(), (size_t)w * h * sizeof(uint16_t)), 0);
+    }
+
+    EXPECT_TRUE(std::filesystem::exists(directory / "image.fits.gz.zidx"));
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, CompressedFitsRoundTrip)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 512;
+    constexpr int height = 301;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_compressed";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    uint16_t*                           integerPixels = (uint16_t*)integers.Buffer();
+    float*                              floatPixels   = (float*)floats.Buffer();
+    uint32_t                            random        = 1;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        random           = random * 1103515245 + 12345;
+        integerPixels[i] = (uint16_t)(1000 + (random >> 24));
+        floatPixels[i]   = 100.0f + (float)(random >> 16) / 6553.6f;
+    }
+
+    floatPixels[7]                  = NAN;
+    floatPixels[width * height - 1] = NAN;
+
+    const io::FitsCompressionOptions previous  = io::GetFitsCompression();
+    const size_t                     cacheSize = io::GetCacheStatistics().byteBudget;
+    const int                        threads   = acrion::imagetools::parallel::GetThreadCount();
+    std::string                      warning;
+
+    io::SetCacheSize(0);
+
+    // .fz files are Rice compressed by default, which is lossless for integers
+    io::Write(integers, (directory / "integers.fz").wstring(), warning);
+    const auto integersRead = io::Read((directory / "integers.fz").wstring(), warning);
+    ASSERT_EQ(integersRead->Depth(), 2);
+    EXPECT_EQ(std::memcmp(integersRead->Buffer(), integerPixels, (size_t)width * height * sizeof(uint16_t)), 0);
+
+    io::FitsCompressionOptions options;
+    options.compression = io::FitsCompression::Rice;
+    options.ditherSeed  = 42;
+    options.tileRows    = 4;
+    io::SetFitsCompression(options);
+
+    // tiles compressed in bands on several threads continue the dither sequence, so they decompress to the same values as a single band
+    acrion::imagetools::parallel::SetThreadCount(1);
+    io::Write(floats, (directory / "serial.fits").wstring(), warning);
+    acrion::imagetools::parallel::SetThreadCount(4);
+    io::Write(floats, (directory / "parallel.fits").wstring(), warning);
+
+    const auto serial   = io::Read((directory / "serial.fits").wstring(), warning);
+    const auto parallel = io::Read((directory / "parallel.fits").wstring(), warning);
+    ASSERT_EQ(parallel->Depth(), -4);
+
+    const float* serialPixels   = (const float*)serial->Buffer();
+    const float* parallelPixels = (const float*)parallel->Buffer();
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        ASSERT_EQ(std::isnan(parallelPixels[i]), std::isnan(floatPixels[i])) << i;
+
+        if (!std::isnan(floatPixels[i]))
+        {
+            ASSERT_EQ(parallelPixels[i], serialPixels[i]) << i;
+            ASSERT_NEAR(parallelPixels[i], floatPixels[i], 1.0f) << i;
+        }
+    }
+
+    EXPECT_LT(std::filesystem::file_size(directory / "parallel.fits"), (uintmax_t)width * height * sizeof(float) / 2);
+
+    acrion::imagetools::parallel::SetThreadCount(threads);
+    io::SetFitsCompression(previous);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsReadBlocksMatchStdioReads)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 1000;
+    constexpr int height = 700;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_read_blocks";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> image(width, height, 1);
+    uint16_t*                           pixels = (uint16_t*)image.Buffer();
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        pixels[i] = (uint16_t)(i * 7919);
+    }
+
+    const std::wstring       path      = (directory / "image.fits").wstring();
+    const io::FitsReadBlocks previous  = io::GetFitsReadBlocks();
+    const size_t             cacheSize = io::GetCacheStatistics().byteBudget;
+    std::string              warning;
+
+    io::SetCacheSize(0);
+    io::Write(image, path, warning);
+
+    const auto region  = io::ReadRegion(path, 333, 17, 101, 650, warning);
+    const auto preview = io::ReadPreview(path, 200, warning);
+
+    // the block size is rounded up to 64 KiB; two blocks of a file of 1.4 MB are replaced many times by the column reads of a region
+    io::SetFitsReadBlocks({1, 2});
+    EXPECT_EQ(io::GetFitsReadBlocks().blockSize, 65536u);
+
+    const auto blockRegion  = io::ReadRegion(path, 333, 17, 101, 650, warning);
+    const auto blockPreview = io::ReadPreview(path, 200, warning);
+
+    io::SetFitsReadBlocks(previous);
+    io::SetCacheSize(cacheSize);
+
+    ASSERT_EQ(blockRegion->Width(), region->Width());
+    ASSERT_EQ(blockRegion->Height(), region->Height());
+    EXPECT_EQ(std::memcmp(blockRegion->Buffer(), region->Buffer(), (size_t)region->Width() * region->Height() * sizeof(uint16_t)), 0);
+    ASSERT_EQ(blockPreview->Width(), preview->Width());
+    EXPECT_EQ(std::memcmp(blockPreview->Buffer(), preview->Buffer(), (size_t)preview->Width() * preview->Height() * preview->Channels()), 0);
+
+    const uint16_t* regionPixels = (const uint16_t*)blockRegion->Buffer();
+    EXPECT_EQ(regionPixels[0], pixels[17 * width + 333]);
+    EXPECT_EQ(regionPixels[101 * 650 - 1], pixels[(17 + 649) * width + 333 + 100]);
+
+    // Some editors append a single end-of-file character, which reads past the last HDU ignore. This reaches the end of the
+    // file when the search for an image HDU moves past the header of this file, which has no image.
+    std::string file;
+    AppendFitsImage(file, 8, {}, std::vector<uint8_t>());
+    WriteFile(directory / "trailing.fits", file + "\n");
+
+    for (const size_t blockSize : {(size_t)0, (size_t)1})
+    {
+        io::SetFitsReadBlocks({blockSize, 2});
+
+        try
+        {
+            io::Probe((directory / "trailing.fits").wstring());
+            ADD_FAILURE() << blockSize;
+        }
+        catch (const std::runtime_error& ex)
+        {
+            EXPECT_NE(std::string(ex.what()).find("does not contain an image"), std::string::npos) << blockSize << ": " << ex.what();
+        }
+    }
+
+    io::SetFitsReadBlocks(previous);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsChecksumsWrittenAndVerified)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 333; // odd, so that rows do not start at word boundaries
+    constexpr int height = 201;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_checksums";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> image(width, height, 1);
+    uint16_t*                           pixels = (uint16_t*)image.Buffer();
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        pixels[i] = (uint16_t)(i * 40503);
+    }
+
+    const io::FitsChecksums previous  = io::GetFitsChecksums();
+    const size_t            cacheSize = io::GetCacheStatistics().byteBudget;
+    const std::wstring      plain     = (directory / "image.fits").wstring();
+    const std::wstring      packed    = (directory / "image.fz").wstring();
+    std::string             warning;
+
+    io::SetCacheSize(0);
+    io::SetFitsChecksums({true, true});
+    io::Write(image, plain, warning);
+    io::Write(image, packed, warning);
+
+    // the words of an HDU with a valid CHECKSUM sum to negative zero in ones' complement arithmetic
+    std::ifstream        file(std::filesystem::path(plain), std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    uint64_t             sum = 0;
+    file.close();
+
+    ASSERT_EQ(bytes.size() % 2880, 0u);
+    EXPECT_NE(std::string(bytes.begin(), bytes.begin() + 2880).find("DATASUM = '"), std::string::npos);
+
+    for (size_t i = 0; i < bytes.size(); i += 4)
+    {
+        sum += (uint32_t)bytes[i] << 24 | (uint32_t)bytes[i + 1] << 16 | (uint32_t)bytes[i + 2] << 8 | bytes[i + 3];
+    }
+
+    while (sum >> 32)
+    {
+        sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    }
+
+    EXPECT_EQ(sum, 0xFFFFFFFFu);
+
+    // memory mapped and compressed images are verified on different paths
+    for (const std::wstring& path : {plain, packed})
+    {
+        const auto read = io::Read(path, warning);
+        ASSERT_EQ(read->Width(), width);
+        EXPECT_EQ(std::memcmp(read->Buffer(), pixels, (size_t)width * height * sizeof(uint16_t)), 0);
+    }
+
+    // a flipped bit in the data unit of the uncompressed image
+    {
+        std::fstream corrupted(std::filesystem::path(plain), std::ios::in | std::ios::out | std::ios::binary);
+        corrupted.seekp(2880 + 1000);
+        corrupted.put((char)(bytes[2880 + 1000] ^ 0x04));
+    }
+
+    EXPECT_THROW(io::Read(plain, warning), std::runtime_error);
+
+    io::SetFitsChecksums({false, false});
+    EXPECT_NO_THROW(io::Read(plain, warning));
+
+    // the image is cached without verification, so turning the verification on must not return it from the cache
+    io::SetCacheSize(1024 * 1024);
+    EXPECT_NO_THROW(io::Read(plain, warning));
+    io::SetFitsChecksums({false, true});
+    EXPECT_THROW(io::Read(plain, warning), std::runtime_error);
+
+    io::InvalidateCache();
+    io::SetFitsChecksums(previous);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsReducedReadsMatchReducedPixels)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 333; // neither width nor height are multiples of the factors, so the blocks must start at the bottom left
+    constexpr int height = 201;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_reduced";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        ((uint16_t*)integers.Buffer())[i] = (uint16_t)(i * 40503);
+        ((float*)floats.Buffer())[i]      = std::sin(i * 0.001f) * 1000.0f;
+    }
+
+    const size_t              cacheSize = io::GetCacheStatistics().byteBudget;
+    std::vector<std::wstring> paths;
+    std::string               warning;
+
+    io::SetCacheSize(0);
+
+    // memory mapped images are reduced while they are converted, compressed ones after they have been read
+    for (const char* name : {"integers.fits", "integers.fz", "floats.fits", "floats.fz"})
+    {
+        paths.push_back((directory / name).wstring());
+        io::Write(name[0] == 'i' ? (const acrion::image::Bitmap&)integers : floats, paths.back(), warning);
+    }
+
+    for (const std::wstring& path : paths)
+    {
+        const auto full = io::Read(path, warning);
+
+        for (int factor : {1, 2, 4, 8})
+        {
+            for (io::Reduction reduction : {io::Reduction::Bin, io::Reduction::Decimate})
+            {
+                const auto reduced = io::ReadReduced(path, factor, reduction, warning);
+                const int  first   = height % factor;
+
+                ASSERT_EQ(reduced->Width(), width / factor);
+                ASSERT_EQ(reduced->Height(), height / factor);
+                ASSERT_EQ(reduced->Depth(), full->Depth());
+
+                for (int y = 0; y < reduced->Height(); ++y)
+                {
+                    for (int x = 0; x < reduced->Width(); ++x)
+                    {
+                        double expected = 0;
+
+                        for (int row = 0; row < factor; ++row)
+                        {
+                            for (int column = 0; column < factor; ++column)
+                            {
+                                const size_t index = (size_t)(first + y * factor + row) * width + x * factor + column;
+                                expected += full->Depth() == 2 ? ((const uint16_t*)full->Buffer())[index] : ((const float*)full->Buffer())[index];
+                            }
+                        }
+
+                        const size_t bottomLeft = (size_t)(first + y * factor + factor - 1) * width + x * factor;
+                        const size_t index      = (size_t)y * reduced->Width() + x;
+
+                        if (full->Depth() == 2)
+                        {
+                            expected = reduction == io::Reduction::Bin ? std::round(expected / (factor * factor)) : ((const uint16_t*)full->Buffer())[bottomLeft];
+                            ASSERT_EQ(((const uint16_t*)reduced->Buffer())[index], expected);
+                        }
+                        else
+                        {
+                            expected = reduction == io::Reduction::Bin ? expected / (factor * factor) : ((const float*)full->Buffer())[bottomLeft];
+                            ASSERT_FLOAT_EQ(((const float*)reduced->Buffer())[index], (float)expected);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    EXPECT_THROW(io::ReadReduced(paths[0], 0, io::Reduction::Bin, warning), std::runtime_error);
+    EXPECT_THROW(io::ReadReduced(paths[0], height + 1, io::Reduction::Bin, warning), std::runtime_error);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsBitmapSizeEstimate)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 333;
+    constexpr int height = 201;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_estimate";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    const std::wstring                  integerPath = (directory / "integers.fits").wstring();
+    const std::wstring                  floatPath   = (directory / "floats.fz").wstring();
+    std::string                         warning;
+
+    io::Write(integers, integerPath, warning);
+    io::Write(floats, floatPath, warning);
+
+    // unsigned 16 bit integers are stored with BZERO = 32768 and read at their native size
+    EXPECT_EQ(io::EstimateBitmapSize(integerPath), (size_t)width * height * sizeof(uint16_t));
+    EXPECT_EQ(io::EstimateBitmapSize(integerPath), (size_t)io::Read(integerPath, warning)->Depth() * width * height);
+    EXPECT_EQ(io::EstimateBitmapSize(floatPath), (size_t)width * height * sizeof(float));
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ScaledImagesSubtractInPhysicalValues)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int    width           = 129;
+    constexpr int    height          = 67;
+    constexpr double minuendScale    = 2.5;
+    constexpr double subtrahendScale = 0.5;
+    constexpr double unsignedZero    = 32768.0;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_subtract";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> minuendSamples(width, height, 1);
+    acrion::image::BitmapData<uint16_t> subtrahendSamples(width, height, 1);
+    uint16_t*                           minuendPixels    = (uint16_t*)minuendSamples.Buffer();
+    uint16_t*                           subtrahendPixels = (uint16_t*)subtrahendSamples.Buffer();
+    uint32_t                            random           = 1;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        random              = random * 1103515245 + 12345;
+        minuendPixels[i]    = (uint16_t)(random >> 16);
+        random              = random * 1103515245 + 12345;
+        subtrahendPixels[i] = (uint16_t)(random >> 16);
+    }
+
+    // The stored samples are signed 16 bit integers with BZERO = 32768 and BSCALE != 1 in the files. Like Read, the scaling
+    // of the bitmaps includes the offset that maps them into the range of uint16_t.
+    const std::wstring minuendPath    = (directory / "minuend.fits").wstring();
+    const std::wstring subtrahendPath = (directory / "subtrahend.fits").wstring();
+    std::string        warning;
+
+    io::Write(io::ScaledBitmap(minuendSamples, minuendScale, unsignedZero - minuendScale * 32768.0), minuendPath, warning);
+    io::Write(io::ScaledBitmap(subtrahendSamples, subtrahendScale, unsignedZero - subtrahendScale * 32768.0), subtrahendPath, warning);
+
+    const auto minuend    = std::dynamic_pointer_cast<io::ScaledBitmap>(io::Read(minuendPath, warning));
+    const auto subtrahend = std::dynamic_pointer_cast<io::ScaledBitmap>(io::Read(subtrahendPath, warning));
+    ASSERT_TRUE(minuend);
+    ASSERT_TRUE(subtrahend);
+    ASSERT_EQ(minuend->Depth(), 2);
+    EXPECT_EQ(minuend->PhysicalValue(32768.0), unsignedZero);
+    EXPECT_EQ(subtrahend->PhysicalValue(32768.0), unsignedZero);
+
+    for (const auto mode : {acrion::imagetools::SubtractMode::Clamp, acrion::imagetools::SubtractMode::Wrap, acrion::imagetools::SubtractMode::Absolute})
+    {
+        const auto difference = acrion::imagetools::SubtractPhysical({minuend->Buffer(), minuend->Scale(), minuend->Zero()},
+                                                                     {subtrahend->Buffer(), subtrahend->Scale(), subtrahend->Zero()},
+                                                                     width,
+                                                                     height,
+                                                                     1,
+                                                                     2,
+                                                                     mode);
+        ASSERT_EQ(difference.Depth(), -8);
+
+        const double* pixels = (const double*)difference.Buffer();
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            // physical = BZERO + BSCALE * signed stored value
+            const double expected = (unsignedZero + minuendScale * ((double)minuendPixels[i] - 32768.0))
+                                  - (unsignedZero + subtrahendScale * ((double)subtrahendPixels[i] - 32768.0));
+
+            switch (mode)
+            {
+            case acrion::imagetools::SubtractMode::Clamp:
+                ASSERT_EQ(pixels[i], std::max(expected, 0.0)) << i;
+                break;
+            case acrion::imagetools::SubtractMode::Wrap:
+                ASSERT_EQ(pixels[i], expected) << i;
+                break;
+            case acrion::imagetools::SubtractMode::Absolute:
+                ASSERT_EQ(pixels[i], std::abs(expected)) << i;
+                break;
+            }
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, QuantumKernelsMatchCasts)
+{
+    namespace cpu = acrion::imagetools::cpu;
+
+    std::vector<uint32_t> quanta(1100);
+    uint32_t              random = 1;
+
+    for (uint32_t& quantum : quanta)
+    {
+        random  = random * 1103515245 + 12345;
+        quantum = random ^ (random << 13);
+    }
+
+    // Compares a kernel with C-style casts for lengths below, at and beyond the vector widths, with unaligned heads on both sides
+    // and a sentinel that must stay untouched behind the last sample
+    const auto check = [&](auto sample, cpu::InstructionSet instructionSet)
+    {
+        using T = decltype(sample);
+
+        for (size_t offset : {0, 1, 3})
+        {
+            for (size_t count : {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 1000, 1093})
+            {
+                std::vector<T> converted(offset + count + 1, (T)0x5a);
+                acrion::imagetools::ConvertQuantum(quanta.data() + offset, converted.data() + offset, count, instructionSet);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    ASSERT_EQ(converted[offset + i], (T)quanta[offset + i]) << (int)instructionSet << " " << offset << " " << count << " " << i;
+                }
+
+                ASSERT_EQ(converted[offset + count], (T)0x5a) << (int)instructionSet << " " << offset << " " << count;
+            }
+        }
+    };
+
+    for (const auto instructionSet : {cpu::InstructionSet::Scalar, cpu::InstructionSet::Sse2, cpu::InstructionSet::Avx2, cpu::InstructionSet::Avx512})
+    {
+        if (instructionSet > cpu::Detect())
+        {
+            uint8_t destination;
+            EXPECT_THROW(acrion::imagetools::ConvertQuantum(quanta.data(), &destination, 1, instructionSet), std::invalid_argument);
+            continue;
+        }
+
+        check(uint8_t(), instructionSet);
+        check(uint16_t(), instructionSet);
+        check(uint64_t(), instructionSet);
+    }
+}
+
+TEST_F(ImageToolsTest, ByteSwapKernelsMatchReference)
+{
+    namespace cpu = acrion::imagetools::cpu;
+
+    std::vector<uint8_t> bytes(8 * 1100 + 8);
+    uint32_t             random = 1;
+
+    for (uint8_t& byte : bytes)
+    {
+        random = random * 1103515245 + 12345;
+        byte   = (uint8_t)(random >> 24);
+    }
+
+    // Compares a kernel with the reference for lengths below, at and beyond the vector widths, with unaligned heads on both sides,
+    // in place and out of place, with and without flipping the sign bit (the BZERO convention for unsigned integers)
+    const auto check = [&](int sampleSize, cpu::InstructionSet instructionSet)
+    {
+        for (const uint64_t flip : {(uint64_t)0, (uint64_t)1 << (8 * sampleSize - 1)})
+        {
+            for (size_t offset : {0, 1, 3})
+            {
+                for (size_t count : {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 1000, 1093})
+                {
+                    const uint8_t*             source    = bytes.data() + offset;
+                    const std::vector<uint8_t> reference = SwapReference(source, count, sampleSize, flip);
+                    const size_t               size      = count * sampleSize;
+
+                    std::vector<uint8_t> swapped(offset + size + 1, 0x5a);
+                    acrion::imagetools::SwapBytes(source, swapped.data() + offset, count, sampleSize, flip, instructionSet);
+                    ASSERT_TRUE(std::equal(reference.begin(), reference.end(), swapped.begin() + offset)) << (int)instructionSet << " " << sampleSize << " " << flip << " " << offset << " " << count;
+                    ASSERT_EQ(swapped[offset + size], 0x5a) << (int)instructionSet << " " << sampleSize << " " << offset << " " << count;
+
+                    std::vector<uint8_t> inPlace(bytes.begin(), bytes.begin() + offset + size);
+                    acrion::imagetools::SwapBytes(inPlace.data() + offset, inPlace.data() + offset, count, sampleSize, flip, instructionSet);
+                    ASSERT_TRUE(std::equal(reference.begin(), reference.end(), inPlace.begin() + offset)) << (int)instructionSet << " " << sampleSize << " " << flip << " " << offset << " " << count;
+                }
+            }
+        }
+    };
+
+    for (const auto instructionSet : {cpu::InstructionSet::Scalar, cpu::InstructionSet::Sse2, cpu::InstructionSet::Avx2, cpu::InstructionSet::Avx512})
+    {
+        if (instructionSet > cpu::Detect())
+        {
+            uint16_t sample = 0;
+            EXPECT_THROW(acrion::imagetools::SwapBytes(&sample, &sample, 1, 2, 0, instructionSet), std::invalid_argument);
+            continue;
+        }
+
+        for (int sampleSize : {1, 2, 4, 8})
+        {
+            check(sampleSize, instructionSet);
+        }
+    }
+
+    // cfitsio swaps in place through these, with the detected kernel
+    for (long count : {0L, 1L, 7L, 33L, 1093L})
+    {
+        std::vector<short>  shorts(count);
+        std::vector<int>    ints(count);
+        std::vector<double> doubles(count);
+        std::memcpy(shorts.data(), bytes.data(), count * sizeof(short));
+        std::memcpy(ints.data(), bytes.data(), count * sizeof(int));
+        std::memcpy(doubles.data(), bytes.data(), count * sizeof(double));
+
+        ffswap2(shorts.data(), count);
+        ffswap4(ints.data(), count);
+        ffswap8(doubles.data(), count);
+
+        const auto swapped2 = SwapReference(bytes.data(), count, 2, 0);
+        const auto swapped4 = SwapReference(bytes.data(), count, 4, 0);
+        const auto swapped8 = SwapReference(bytes.data(), count, 8, 0);
+        EXPECT_EQ(std::memcmp(shorts.data(), swapped2.data(), swapped2.size()), 0) << count;
+        EXPECT_EQ(std::memcmp(ints.data(), swapped4.data(), swapped4.size()), 0) << count;
+        EXPECT_EQ(std::memcmp(doubles.data(), swapped8.data(), swapped8.size()), 0) << count;
+    }
+}
+
+TEST_F(ImageToolsTest, DirectExportMatchesPixelCache)
+{
+    namespace io = acrion::imagetools::io;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_direct_export";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    // 16 bit RGB that spans more than one band of the export, and 8 bit gray with an odd width
+    acrion::image::BitmapData<uint16_t> rgb(2048, 1400, 3);
+    acrion::image::BitmapData<uint8_t>  gray(333, 201, 1);
+    uint16_t*                           rgbPixels  = (uint16_t*)rgb.Buffer();
+    uint8_t*                            grayPixels = (uint8_t*)gray.Buffer();
+    uint32_t                            random     = 1;
+
+    for (size_t i = 0; i < (size_t)rgb.Width() * rgb.Height() * rgb.Channels(); ++i)
+    {
+        random       = random * 1103515245 + 12345;
+        rgbPixels[i] = (uint16_t)(random >> 16);
+    }
+
+    for (size_t i = 0; i < (size_t)gray.Width() * gray.Height(); ++i)
+    {
+        random        = random * 1103515245 + 12345;
+        grayPixels[i] = (uint8_t)(random >> 24);
+    }
+
+    const io::ReadMode previous  = io::GetReadMode();
+    const size_t       cacheSize = io::GetCacheStatistics().byteBudget;
+    std::string        warning;
+
+    io::SetCacheSize(0);
+
+    for (const auto& [bitmap, path] : {std::pair<const acrion::image::Bitmap*, std::filesystem::path>(&rgb, directory / "rgb.tif"),
+                                       std::pair<const acrion::image::Bitmap*, std::filesystem::path>(&gray, directory / "gray.png")})
+    {
+        io::Write(*bitmap, path.wstring(), warning);
+
+        io::SetReadMode(io::ReadMode::PixelCache);
+        const auto pixelCache = io::Read(path.wstring(), warning);
+        io::SetReadMode(io::ReadMode::DirectExport);
+        const auto direct = io::Read(path.wstring(), warning);
+
+        const size_t size = (size_t)bitmap->Width() * bitmap->Height() * bitmap->Channels() * bitmap->Depth();
+
+        ASSERT_EQ(direct->Width(), bitmap->Width()) << path;
+        ASSERT_EQ(direct->Height(), bitmap->Height()) << path;
+        ASSERT_EQ(direct->Channels(), bitmap->Channels()) << path;
+        ASSERT_EQ(direct->Depth(), bitmap->Depth()) << path;
+        ASSERT_EQ(pixelCache->Depth(), bitmap->Depth()) << path;
+        EXPECT_EQ(std::memcmp(direct->Buffer(), bitmap->Buffer(), size), 0) << path;
+        EXPECT_EQ(std::memcmp(pixelCache->Buffer(), direct->Buffer(), size), 0) << path;
+    }
+
+    io::SetReadMode(previous);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ProbeMatchesRead)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 219;
+    constexpr int height = 97;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_probe";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const acrion::image::BitmapData<uint8_t>  bytes(width, height, 1);
+    const acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    const acrion::image::BitmapData<float>    floats(width, height, 1);
+    const acrion::image::BitmapData<double>   doubles(width, height, 1);
+    const acrion::image::BitmapData<uint8_t>  rgb(width, height, 3);
+    std::string                               warning;
+
+    for (const auto& [bitmap, name] : {std::pair<const acrion::image::Bitmap*, std::string>(&bytes, "bytes.fits"),
+                                       std::pair<const acrion::image::Bitmap*, std::string>(&integers, "integers.fits"),
+                                       std::pair<const acrion::image::Bitmap*, std::string>(&floats, "floats.fz"),
+                                       std::pair<const acrion::image::Bitmap*, std::string>(&doubles, "doubles.fit"),
+                                       std::pair<const acrion::image::Bitmap*, std::string>(&rgb, "rgb.png")})
+    {
+        const std::wstring path = (directory / name).wstring();
+        io::Write(*bitmap, path, warning);
+
+        const io::ImageInfo info = io::Probe(path);
+        EXPECT_EQ(info.width, width) << name;
+        EXPECT_EQ(info.height, height) << name;
+        EXPECT_EQ(info.channels, bitmap->Channels()) << name;
+        EXPECT_EQ(info.depth, bitmap->Depth()) << name;
+
+        const auto read = io::Read(path, warning);
+        EXPECT_EQ(info.channels, read->Channels()) << name;
+        EXPECT_EQ(info.depth, read->Depth()) << name;
+    }
+
+    EXPECT_THROW(io::Probe((directory / "missing.fits").wstring()), std::runtime_error);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsRegionsMatchCrops)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 601;
+    constexpr int height = 433;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_region";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    uint16_t*                           integerPixels = (uint16_t*)integers.Buffer();
+    float*                              floatPixels   = (float*)floats.Buffer();
+    uint32_t                            random        = 1;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        random           = random * 1103515245 + 12345;
+        integerPixels[i] = (uint16_t)(random >> 16);
+        floatPixels[i]   = (float)(random >> 8) / 65536.0f - 128.0f;
+    }
+
+    const std::wstring integerPath = (directory / "integers.fits").wstring();
+    const std::wstring floatPath   = (directory / "floats.fz").wstring();
+    const size_t       cacheSize   = io::GetCacheStatistics().byteBudget;
+    std::string        warning;
+
+    io::SetCacheSize(0);
+    io::Write(integers, integerPath, warning);
+
+    // lossless, so that the regions can be compared with the written samples
+    io::FitsCompressionOptions previous = io::GetFitsCompression();
+    io::FitsCompressionOptions lossless;
+    lossless.compression   = io::FitsCompression::Gzip;
+    lossless.quantizeLevel = 0.0f;
+    io::SetFitsCompression(lossless);
+    io::Write(floats, floatPath, warning);
+
+    // x and y count from the top left corner, like the rows of the bitmap
+    for (const auto& [x, y, w, h] : std::vector<std::tuple<int, int, int, int>>{{0, 0, 1, 1}, {17, 3, 64, 100}, {width - 5, height - 7, 5, 7}, {0, 200, width, 1}, {0, 0, width, height}})
+    {
+        const auto integerRegion = io::ReadRegion(integerPath, x, y, w, h, warning);
+        const auto floatRegion   = io::ReadRegion(floatPath, x, y, w, h, warning);
+
+        ASSERT_EQ(integerRegion->Width(), w);
+        ASSERT_EQ(integerRegion->Height(), h);
+        ASSERT_EQ(integerRegion->Depth(), 2);
+        ASSERT_EQ(floatRegion->Depth(), -4);
+
+        for (int row = 0; row < h; ++row)
+        {
+            const size_t source = (size_t)(y + row) * width + x;
+            EXPECT_EQ(std::memcmp((const uint16_t*)integerRegion->Buffer() + (size_t)row * w, integerPixels + source, w * sizeof(uint16_t)), 0) << x << " " << y << " " << row;
+            EXPECT_EQ(std::memcmp((const float*)floatRegion->Buffer() + (size_t)row * w, floatPixels + source, w * sizeof(float)), 0) << x << " " << y << " " << row;
+        }
+    }
+
+    EXPECT_THROW(io::ReadRegion(integerPath, width - 4, 0, 5, 1, warning), std::runtime_error);
+    EXPECT_THROW(io::ReadRegion(integerPath, 0, height, 1, 1, warning), std::runtime_error);
+    EXPECT_THROW(io::ReadRegion(integerPath, 0, 0, 0, 1, warning), std::runtime_error);
+
+    io::SetFitsCompression(previous);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ImageMagickRegionsMatchCrops)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 301;
+    constexpr int height = 203;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_magick_region";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> gray(width, height, 1);
+    acrion::image::BitmapData<uint8_t>  rgb(width, height, 3);
+    uint32_t                            random = 1;
+
+    for (size_t i = 0; i < (size_t)width * height; ++i)
+    {
+        random                        = random * 1103515245 + 12345;
+        ((uint16_t*)gray.Buffer())[i] = (uint16_t)(random >> 16);
+    }
+
+    for (size_t i = 0; i < (size_t)width * height * 3; ++i)
+    {
+        random                      = random * 1103515245 + 12345;
+        ((uint8_t*)rgb.Buffer())[i] = (uint8_t)(random >> 24);
+    }
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    std::string  warning;
+
+    io::SetCacheSize(0);
+
+    for (const auto& [bitmap, name] : {std::pair<const acrion::image::Bitmap*, std::string>(&gray, "gray.png"),
+                                       std::pair<const acrion::image::Bitmap*, std::string>(&rgb, "rgb.tif")})
+    {
+        const std::wstring path = (directory / name).wstring();
+        io::Write(*bitmap, path, warning);
+
+        const size_t pixelSize = (size_t)bitmap->Channels() * bitmap->Depth();
+
+        for (const auto& [x, y, w, h] : std::vector<std::tuple<int, int, int, int>>{{0, 0, 1, 1}, {17, 3, 64, 100}, {width - 5, height - 7, 5, 7}, {0, 0, width, height}})
+        {
+            const auto region = io::ReadRegion(path, x, y, w, h, warning);
+
+            ASSERT_EQ(region->Width(), w) << name;
+            ASSERT_EQ(region->Height(), h) << name;
+            ASSERT_EQ(region->Channels(), bitmap->Channels()) << name;
+            ASSERT_EQ(region->Depth(), bitmap->Depth()) << name;
+
+            for (int row = 0; row < h; ++row)
+            {
+                const uint8_t* source = (const uint8_t*)bitmap->Buffer() + ((size_t)(y + row) * width + x) * pixelSize;
+                EXPECT_EQ(std::memcmp((const uint8_t*)region->Buffer() + (size_t)row * w * pixelSize, source, w * pixelSize), 0) << name << " " << x << " " << y << " " << row;
+            }
+        }
+
+        // ImageMagick would crop these regions to the image, so the error reports the size of the image, not of the intersection
+        for (const auto& [x, y, w, h] : std::vector<std::tuple<int, int, int, int>>{{width - 4, 0, 5, 1}, {0, height - 1, 1, 2}, {width, 0, 1, 1}})
+        {
+            try
+            {
+                io::ReadRegion(path, x, y, w, h, warning);
+                ADD_FAILURE() << name << " " << x << " " << y;
+            }
+            catch (const std::runtime_error& ex)
+            {
+                EXPECT_NE(std::string(ex.what()).find("image size " + std::to_string(width) + "x" + std::to_string(height)), std::string::npos) << ex.what();
+            }
+        }
+    }
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsPreviewsDecimateAndScaleToBytes)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width   = 997;
+    constexpr int height  = 601;
+    constexpr int maxEdge = 100;
+    constexpr int stride  = (width + maxEdge - 1) / maxEdge;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_preview";
+    const std::wstring          path      = (directory / "image.fits").wstring();
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<float> bitmap(width, height, 1);
+    float*                           pixels = (float*)bitmap.Buffer();
+
+    for (int row = 0; row < height; ++row)
+    {
+        for (int column = 0; column < width; ++column)
+        {
+            pixels[(size_t)row * width + column] = (float)column * 0.5f + (float)row * 3.0f;
+        }
+    }
+
+    // the bottom left pixel, where FITS images have their origin, is part of the preview
+    pixels[(size_t)(height - 1) * width] = NAN;
+
+    const io::DisplayRangeOptions previous = io::GetDisplayRangeOptions();
+    std::string                   warning;
+
+    io::SetDisplayRangeOptions(io::DisplayRangeOptions());
+    io::Write(bitmap, path, warning);
+
+    const auto preview = io::ReadPreview(path, maxEdge, warning);
+    ASSERT_EQ(preview->Width(), (width - 1) / stride + 1);
+    ASSERT_EQ(preview->Height(), (height - 1) / stride + 1);
+    ASSERT_EQ(preview->Depth(), 1);
+    ASSERT_LE(std::max(preview->Width(), preview->Height()), maxEdge);
+
+    // every stride-th row and column, counted from the bottom left corner, scaled from its exact range to 0..255
+    const auto source = [&](int column, int row)
+    {
+        return pixels[(size_t)(height - 1 - (preview->Height() - 1 - row) * stride) * width + (size_t)column * stride];
+    };
+
+    double min = INFINITY;
+    double max = -INFINITY;
+
+    for (int row = 0; row < preview->Height(); ++row)
+    {
+        for (int column = 0; column < preview->Width(); ++column)
+        {
+            if (std::isfinite(source(column, row)))
+            {
+                min = std::min(min, (double)source(column, row));
+                max = std::max(max, (double)source(column, row));
+            }
+        }
+    }
+
+    const uint8_t* previewPixels = (const uint8_t*)preview->Buffer();
+
+    for (int row = 0; row < preview->Height(); ++row)
+    {
+        for (int column = 0; column < preview->Width(); ++column)
+        {
+            const float   value    = source(column, row);
+            const uint8_t expected = std::isfinite(value) ? (uint8_t)(((double)value - min) * (255.0 / (max - min)) + 0.5) : 0;
+            ASSERT_EQ(previewPixels[(size_t)row * preview->Width() + column], expected) << column << " " << row;
+        }
+    }
+
+    EXPECT_EQ(previewPixels[(size_t)(preview->Height() - 1) * preview->Width()], 0);
+
+    // images that are already small enough keep their size
+    const auto full = io::ReadPreview(path, width, warning);
+    EXPECT_EQ(full->Width(), width);
+    EXPECT_EQ(full->Height(), height);
+
+    EXPECT_THROW(io::ReadPreview(path, 0, warning), std::runtime_error);
+
+    io::SetDisplayRangeOptions(previous);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ReadFromMemoryMatchesRead)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 311;
+    constexpr int height = 177;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_memory";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    acrion::image::BitmapData<uint8_t>  rgb(width, height, 3);
+    uint16_t*                           integerPixels = (uint16_t*)integers.Buffer();
+    float*                              floatPixels   = (float*)floats.Buffer();
+    uint8_t*                            rgbPixels     = (uint8_t*)rgb.Buffer();
+    uint32_t                            random        = 1;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        random           = random * 1103515245 + 12345;
+        integerPixels[i] = (uint16_t)(random >> 16);
+        floatPixels[i]   = (float)(random >> 8) / 256.0f;
+        rgbPixels[3 * i] = rgbPixels[3 * i + 1] = (uint8_t)(random >> 24);
+        rgbPixels[3 * i + 2]                    = (uint8_t)(random >> 16);
+    }
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    std::string  warning;
+
+    io::SetCacheSize(0);
+
+    // FITS data is recognized by its header without a hint, other formats by ImageMagick
+    for (const auto& [bitmap, name, hint] : {std::tuple<const acrion::image::Bitmap*, std::string, std::string>(&integers, "integers.fits", ""),
+                                             std::tuple<const acrion::image::Bitmap*, std::string, std::string>(&integers, "integers.fits", ".fits"),
+                                             std::tuple<const acrion::image::Bitmap*, std::string, std::string>(&floats, "floats.fits", "FITS"),
+                                             std::tuple<const acrion::image::Bitmap*, std::string, std::string>(&rgb, "rgb.png", ""),
+                                             std::tuple<const acrion::image::Bitmap*, std::string, std::string>(&rgb, "rgb.png", "PNG")})
+    {
+        const std::filesystem::path path = directory / name;
+        io::Write(*bitmap, path.wstring(), warning);
+
+        std::ifstream     input(path, std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+        const auto expected = io::Read(path.wstring(), warning);
+        const auto read     = io::ReadFromMemory(content.data(), content.size(), hint, warning);
+
+        ASSERT_EQ(read->Width(), width) << name << " " << hint;
+        ASSERT_EQ(read->Height(), height) << name << " " << hint;
+        ASSERT_EQ(read->Channels(), bitmap->Channels()) << name << " " << hint;
+        ASSERT_EQ(read->Depth(), bitmap->Depth()) << name << " " << hint;
+        EXPECT_EQ(std::memcmp(read->Buffer(), bitmap->Buffer(), (size_t)width * height * bitmap->Channels() * std::abs(bitmap->Depth())), 0) << name << " " << hint;
+        EXPECT_EQ(std::memcmp(read->Buffer(), expected->Buffer(), (size_t)width * height * bitmap->Channels() * std::abs(bitmap->Depth())), 0) << name << " " << hint;
+    }
+
+    EXPECT_THROW(io::ReadFromMemory(nullptr, 0, "", warning), std::runtime_error);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsWriterRoundTripsEveryDepth)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 203;
+    constexpr int height = 119;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_writer";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0);
+
+    // fills the bitmap with samples from the whole range of T, including the extremes, and writes and reads it
+    const auto check = [&](auto sample, const std::string& name)
+    {
+        using T = decltype(sample);
+
+        acrion::image::BitmapData<T> bitmap(width, height, 1);
+        T*                           pixels = (T*)bitmap.Buffer();
+        uint64_t                     random = 1;
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                pixels[i] = (T)((double)(int64_t)random / 1e12);
+            }
+            else
+            {
+                pixels[i] = (T)(random >> (64 - 8 * sizeof(T)));
+            }
+        }
+
+        pixels[0] = std::numeric_limits<T>::lowest();
+        pixels[1] = std::numeric_limits<T>::max();
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            pixels[2] = std::numeric_limits<T>::quiet_NaN();
+            pixels[3] = std::numeric_limits<T>::infinity();
+            pixels[4] = std::numeric_limits<T>::denorm_min();
+        }
+
+        const std::wstring path = (directory / name).wstring();
+        std::string        warning;
+        io::Write(bitmap, path, warning);
+
+        const auto read = io::Read(path, warning);
+        ASSERT_EQ(read->Width(), width) << name;
+        ASSERT_EQ(read->Height(), height) << name;
+        ASSERT_EQ(read->Depth(), bitmap.Depth()) << name;
+        EXPECT_EQ(std::memcmp(read->Buffer(), pixels, (size_t)width * height * sizeof(T)), 0) << name;
+    };
+
+    check(uint8_t(), "uint8.fits");
+    check(uint16_t(), "uint16.fits");
+    check(uint32_t(), "uint32.fits");
+    check(uint64_t(), "uint64.fits");
+    check(float(), "float.fits");
+    check(double(), "double.fits");
+
+    // FITS tile compression has no 64 bit integer algorithm
+    std::string                               warning;
+    const acrion::image::BitmapData<uint64_t> integers(width, height, 1);
+    EXPECT_THROW(io::Write(integers, (directory / "uint64.fz").wstring(), warning), std::runtime_error);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsSamplesReadInNativeTypes)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr long width  = 37;
+    constexpr long height = 23;
+    constexpr long count  = width * height;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_native";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0);
+
+    // Writes the stored samples with the given header cards, reads the file and compares the result with the expected samples.
+    // A nonzero `zero` is the offset of signed samples, which are returned as io::ScaledBitmap.
+    const auto check = [&](const std::string& name, int bitpix, const auto& stored, const std::vector<std::string>& cards, int depth, const auto& expected, double zero = 0.0)
+    {
+        std::string file;
+        AppendFitsImage(file, bitpix, {width, height}, stored, cards);
+        WriteFile(directory / name, file);
+
+        std::string warning;
+        const auto  read = io::Read((directory / name).wstring(), warning);
+        ASSERT_EQ(read->Depth(), depth) << name;
+        ASSERT_EQ(read->Width(), width) << name;
+        ASSERT_EQ(read->Height(), height) << name;
+        EXPECT_TRUE(MatchesFitsSamples(*read, expected)) << name;
+
+        const auto* scaled = dynamic_cast<const io::ScaledBitmap*>(read.get());
+
+        if (zero == 0.0)
+        {
+            EXPECT_EQ(scaled, nullptr) << name;
+        }
+        else
+        {
+            ASSERT_NE(scaled, nullptr) << name;
+            EXPECT_EQ(scaled->Scale(), 1.0) << name;
+            EXPECT_EQ(scaled->Zero(), zero) << name;
+        }
+
+        EXPECT_EQ(io::EstimateBitmapSize((directory / name).wstring()), (size_t)std::abs(depth) * width * height) << name;
+    };
+
+    std::vector<uint8_t>  bytes(count);
+    std::vector<int16_t>  shorts(count);
+    std::vector<int32_t>  ints(count);
+    std::vector<int64_t>  longs(count);
+    std::vector<float>    floats(count);
+    std::vector<double>   doubles(count);
+    uint64_t              random = 1;
+
+    for (long i = 0; i < count; ++i)
+    {
+        random     = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        bytes[i]   = (uint8_t)(random >> 56);
+        shorts[i]  = (int16_t)(random >> 48);
+        ints[i]    = (int32_t)(random >> 32);
+        longs[i]   = (int64_t)random;
+        floats[i]  = (float)shorts[i] / 7.0f;
+        doubles[i] = (double)ints[i] / 7.0;
+    }
+
+    const auto transform = [](const auto& samples, auto function)
+    {
+        std::vector<decltype(function(samples[0]))> result;
+        std::transform(samples.begin(), samples.end(), std::back_inserter(result), function);
+        return result;
+    };
+
+    check("bytes.fits", 8, bytes, {}, 1, bytes);
+    check("floats.fits", -32, floats, {}, -4, floats);
+    check("doubles.fits", -64, doubles, {}, -8, doubles);
+
+    // integers with the BZERO convention for the opposite signedness keep their size
+    check("signed_bytes.fits", 8, bytes, {FitsCard("BZERO", "-128")}, 1, bytes, -128.0);
+    check("ushorts.fits", 16, shorts, {FitsCard("BZERO", "32768")}, 2, transform(shorts, [](int16_t value) { return (uint16_t)(value + 32768); }));
+    check("uints.fits", 32, ints, {FitsCard("BZERO", "2147483648")}, 4, transform(ints, [](int32_t value) { return (uint32_t)value ^ 0x80000000u; }));
+    check("ulongs.fits", 64, longs, {FitsCard("BZERO", "9223372036854775808")}, 8, transform(longs, [](int64_t value) { return (uint64_t)value ^ 0x8000000000000000ull; }));
+
+    // signed integers keep their size, offset into the range of the unsigned type, regardless of their values
+    check("shorts.fits", 16, shorts, {}, 2, transform(shorts, [](int16_t value) { return (uint16_t)((uint16_t)value ^ 0x8000u); }), -32768.0);
+    check("ints.fits", 32, ints, {}, 4, transform(ints, [](int32_t value) { return (uint32_t)value ^ 0x80000000u; }), -2147483648.0);
+    check("longs.fits", 64, longs, {}, 8, transform(longs, [](int64_t value) { return (uint64_t)value ^ 0x8000000000000000ull; }), -9223372036854775808.0);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsReadsKeepRowOrderAndExactRange)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 509;
+    constexpr int height = 257;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_bulk";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    uint16_t*                           integerPixels = (uint16_t*)integers.Buffer();
+    float*                              floatPixels   = (float*)floats.Buffer();
+    uint32_t                            random        = 1;
+
+    // rows differ from each other, so that a wrong row order cannot go unnoticed
+    for (int i = 0; i < width * height; ++i)
+    {
+        random           = random * 1103515245 + 12345;
+        integerPixels[i] = (uint16_t)(100 + i / width * 200 + (random >> 28));
+        floatPixels[i]   = (float)(i / width) - (float)(random >> 20) / 4096.0f;
+    }
+
+    floatPixels[0]                  = NAN;
+    floatPixels[width * height / 2] = NAN;
+
+    const auto [integerMin, integerMax] = std::minmax_element(integerPixels, integerPixels + width * height);
+    float      floatMin                 = INFINITY;
+    float      floatMax                 = -INFINITY;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        if (!std::isnan(floatPixels[i]))
+        {
+            floatMin = std::min(floatMin, floatPixels[i]);
+            floatMax = std::max(floatMax, floatPixels[i]);
+        }
+    }
+
+    const io::FitsCompressionOptions previous      = io::GetFitsCompression();
+    const io::DisplayRangeOptions    previousRange = io::GetDisplayRangeOptions();
+    const size_t                     cacheSize     = io::GetCacheStatistics().byteBudget;
+    std::string                      warning;
+
+    io::SetCacheSize(0);
+    io::SetDisplayRangeOptions(io::DisplayRangeOptions());
+
+    // uncompressed images are memory mapped, compressed ones are read through cfitsio, in bands of tiles on several threads
+    io::Write(integers, (directory / "integers.fits").wstring(), warning);
+    io::Write(floats, (directory / "floats.fits").wstring(), warning);
+
+    io::FitsCompressionOptions options;
+    options.compression   = io::FitsCompression::Gzip;
+    options.quantizeLevel = 0.0f;
+    options.tileRows      = 16;
+    io::SetFitsCompression(options);
+    io::Write(integers, (directory / "integers.fz").wstring(), warning);
+    io::Write(floats, (directory / "floats.fz").wstring(), warning);
+
+    const auto range = [](const acrion::image::Bitmap& bitmap)
+    {
+        const auto container = (acrion::image::BitmapContainer)bitmap;
+        return std::pair<double, double>(container.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::minBrightnessKey)),
+                                         container.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::maxBrightnessKey)));
+    };
+
+    for (const std::string name : {"integers.fits", "integers.fz"})
+    {
+        const auto read = io::Read((directory / name).wstring(), warning);
+        ASSERT_EQ(read->Depth(), 2) << name;
+        EXPECT_EQ(std::memcmp(read->Buffer(), integerPixels, (size_t)width * height * sizeof(uint16_t)), 0) << name;
+        const auto [min, max] = range(*read);
+        EXPECT_EQ(min, *integerMin) << name;
+        EXPECT_EQ(max, *integerMax) << name;
+    }
+
+    for (const std::string name : {"floats.fits", "floats.fz"})
+    {
+        const auto   read   = io::Read((directory / name).wstring(), warning);
+        const float* pixels = (const float*)read->Buffer();
+        ASSERT_EQ(read->Depth(), -4) << name;
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            ASSERT_EQ(std::isnan(pixels[i]), std::isnan(floatPixels[i])) << name << " " << i;
+            ASSERT_TRUE(std::isnan(pixels[i]) || pixels[i] == floatPixels[i]) << name << " " << i;
+        }
+
+        const auto [min, max] = range(*read);
+        EXPECT_EQ(min, floatMin) << name;
+        EXPECT_EQ(max, floatMax) << name;
+    }
+
+    io::SetFitsCompression(previous);
+    io::SetDisplayRangeOptions(previousRange);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ScaledFitsIntegersKeepTheirStoredSize)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr long width  = 41;
+    constexpr long height = 29;
+    constexpr long count  = width * height;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_scaled";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0);
+
+    // Writes the raw samples with BSCALE and BZERO, and compares the physical values of the bitmaps returned by Read and
+    // ReadRegion (memory mapped and read through cfitsio) with BZERO + BSCALE * raw value
+    const auto check = [&](const std::string& name, int bitpix, const auto& raw, double scale, double zero, int depth)
+    {
+        std::string file;
+        AppendFitsImage(file, bitpix, {width, height}, raw, {FitsCard("BSCALE", std::to_string(scale)), FitsCard("BZERO", std::to_string(zero))});
+        WriteFile(directory / name, file);
+
+        // the offset of signed samples into the range of the unsigned type is folded into the zero, which costs a few ulps of it
+        const double tolerance = 1e-14 * (std::abs(zero) + std::abs(scale) * std::ldexp(1.0, bitpix));
+        std::string  warning;
+
+        for (const auto& bitmap : {io::Read((directory / name).wstring(), warning), io::ReadRegion((directory / name).wstring(), 0, 0, width, height, warning)})
+        {
+            const auto* scaled = dynamic_cast<const io::ScaledBitmap*>(bitmap.get());
+            ASSERT_NE(scaled, nullptr) << name;
+            ASSERT_EQ(scaled->Depth(), depth) << name;
+
+            for (long row = 0; row < height; ++row)
+            {
+                for (long column = 0; column < width; ++column)
+                {
+                    const size_t source = (size_t)(height - 1 - row) * width + column; // FITS rows are from bottom to top
+                    double       stored;
+
+                    switch (depth)
+                    {
+                    case 1:
+                        stored = ((const uint8_t*)scaled->Buffer())[row * width + column];
+                        break;
+                    case 2:
+                        stored = ((const uint16_t*)scaled->Buffer())[row * width + column];
+                        break;
+                    default:
+                        stored = ((const uint32_t*)scaled->Buffer())[row * width + column];
+                        break;
+                    }
+
+                    ASSERT_NEAR(scaled->PhysicalValue(stored), zero + scale * (double)raw[source], tolerance) << name << " " << column << " " << row;
+                }
+            }
+        }
+    };
+
+    std::vector<uint8_t> bytes(count);
+    std::vector<int16_t> shorts(count);
+    std::vector<int32_t> ints(count);
+    uint64_t             random = 1;
+
+    for (long i = 0; i < count; ++i)
+    {
+        random    = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        bytes[i]  = (uint8_t)(random >> 56);
+        shorts[i] = (int16_t)(random >> 48);
+        ints[i]   = (int32_t)(random >> 32);
+    }
+
+    check("bytes.fits", 8, bytes, 0.25, 10.0, 1);
+    check("shorts.fits", 16, shorts, 2.5, 32768.0, 2);
+    check("offset_shorts.fits", 16, shorts, 1.0, 1000.0, 2);
+    check("ints.fits", 32, ints, 0.001, -5.0, 4);
+
+    // scaled 64 bit integers are returned as physical values
+    std::vector<int64_t> longs(count);
+    std::transform(ints.begin(), ints.end(), longs.begin(), [](int32_t value) { return (int64_t)value * 3; });
+
+    std::string file;
+    AppendFitsImage(file, 64, {width, height}, longs, {FitsCard("BSCALE", "0.5"), FitsCard("BZERO", "100")});
+    WriteFile(directory / "longs.fits", file);
+
+    std::string warning;
+    const auto  longsRead = io::Read((directory / "longs.fits").wstring(), warning);
+    ASSERT_EQ(longsRead->Depth(), -8);
+    EXPECT_EQ(dynamic_cast<const io::ScaledBitmap*>(longsRead.get()), nullptr);
+    EXPECT_EQ(((const double*)longsRead->Buffer())[0], 100.0 + 0.5 * (double)longs[(size_t)(height - 1) * width]);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, FitsHdusAndPlanesSelected)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr long width  = 45;
+    constexpr long height = 31;
+    constexpr long count  = width * height;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_hdus";
+    const std::filesystem::path plain     = directory / "cube.fits";
+    const std::filesystem::path packed    = directory / "cube.fits.gz";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    // an empty primary HDU, as in most multi-extension files, a 2D image and a 4D cube of 3 x 2 planes
+    std::vector<uint8_t> flat(count);
+    std::vector<float>   cube(count * 6);
+
+    for (long i = 0; i < count; ++i)
+    {
+        flat[i] = (uint8_t)(i * 7);
+    }
+
+    for (long i = 0; i < count * 6; ++i)
+    {
+        cube[i] = (float)(i / count) * 1000.0f + (float)(i % count);
+    }
+
+    std::string file;
+    AppendFitsImage(file, 8, {}, std::vector<uint8_t>());
+    AppendFitsImage(file, 8, {width, height}, flat, {FitsCard("EXTNAME", "'FLAT'")});
+    AppendFitsImage(file, -32, {width, height, 3, 2}, cube, {FitsCard("EXTNAME", "'CUBE'")});
+    WriteFile(plain, file);
+
+    {
+        gzFile output = gzopen(packed.string().c_str(), "wb1");
+        ASSERT_NE(output, nullptr);
+        EXPECT_EQ(gzwrite(output, file.data(), (unsigned)file.size()), (int)file.size());
+        gzclose(output);
+    }
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    std::string  warning;
+    io::SetCacheSize(0);
+
+    const std::vector<io::FitsHduInfo> hdus = io::ListFitsHdus(plain.wstring());
+    ASSERT_EQ(hdus.size(), 3u);
+    EXPECT_EQ(hdus[0].planes, 0);
+    EXPECT_EQ(hdus[0].image.width, 0);
+    EXPECT_EQ(hdus[1].name, "FLAT");
+    EXPECT_EQ(hdus[1].planes, 1);
+    EXPECT_EQ(hdus[1].image.width, width);
+    EXPECT_EQ(hdus[1].image.height, height);
+    EXPECT_EQ(hdus[1].image.depth, 1);
+    EXPECT_EQ(hdus[2].index, 2);
+    EXPECT_EQ(hdus[2].name, "CUBE");
+    EXPECT_EQ(hdus[2].type, io::FitsHduType::Image);
+    EXPECT_EQ(hdus[2].planes, 6);
+    EXPECT_EQ(hdus[2].image.depth, -4);
+
+    // Read skips the empty primary HDU
+    const auto first = io::Read(plain.wstring(), warning);
+    ASSERT_EQ(first->Depth(), 1);
+    EXPECT_TRUE(MatchesFitsSamples(*first, flat));
+
+    // planes count through the third axis first; the memory mapped file and cfitsio (for the .gz file) return the same planes
+    for (const auto& path : {plain, packed})
+    {
+        for (long long plane : {0LL, 2LL, 3LL, 5LL})
+        {
+            const auto bitmap = io::ReadFitsPlane(path.wstring(), 2, plane);
+            ASSERT_EQ(bitmap->Depth(), -4) << path << " " << plane;
+            ASSERT_EQ(bitmap->Width(), width) << path << " " << plane;
+            ASSERT_EQ(bitmap->Height(), height) << path << " " << plane;
+            EXPECT_TRUE(MatchesFitsSamples(*bitmap, std::vector<float>(cube.begin() + plane * count, cube.begin() + (plane + 1) * count))) << path << " " << plane;
+        }
+    }
+
+    EXPECT_THROW(io::ReadFitsPlane(plain.wstring(), 2, 6), std::runtime_error);
+    EXPECT_THROW(io::ReadFitsPlane(plain.wstring(), 2, -1), std::runtime_error);
+    EXPECT_THROW(io::ReadFitsPlane(plain.wstring(), 1, 1), std::runtime_error);
+    EXPECT_THROW(io::ReadFitsPlane(plain.wstring(), 0, 0), std::runtime_error);
+    EXPECT_THROW(io::ReadFitsPlane(plain.wstring(), 3, 0), std::runtime_error);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, MappedFitsReadsMatchCfitsio)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr long width  = 173;
+    constexpr long height = 89;
+    constexpr long count  = width * height;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_mapped";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    std::vector<uint8_t> bytes(count);
+    std::vector<int16_t> shorts(count);
+    std::vector<int32_t> ints(count);
+    std::vector<int64_t> longs(count);
+    std::vector<float>   floats(count);
+    std::vector<double>  doubles(count);
+    uint64_t             random = 1;
+
+    for (long i = 0; i < count; ++i)
+    {
+        random     = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        bytes[i]   = (uint8_t)(random >> 56);
+        shorts[i]  = (int16_t)(random >> 48);
+        ints[i]    = (int32_t)(random >> 32);
+        longs[i]   = (int64_t)random;
+        floats[i]  = (float)ints[i] / 3.0f;
+        doubles[i] = (double)longs[i] / 3.0;
+    }
+
+    floats[5]  = NAN;
+    doubles[7] = NAN;
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0);
+
+    // Read maps uncompressed files and converts their rows with the SIMD kernels, ReadRegion and .gz files go through cfitsio
+    const auto check = [&](const std::string& name, int bitpix, const auto& samples, const std::vector<std::string>& cards)
+    {
+        std::string file;
+        AppendFitsImage(file, bitpix, {width, height}, samples, cards);
+
+        const std::filesystem::path plain  = directory / (name + ".fits");
+        const std::filesystem::path packed = directory / (name + ".fits.gz");
+        WriteFile(plain, file);
+
+        {
+            gzFile output = gzopen(packed.string().c_str(), "wb1");
+            ASSERT_NE(output, nullptr);
+            EXPECT_EQ(gzwrite(output, file.data(), (unsigned)file.size()), (int)file.size());
+            gzclose(output);
+        }
+
+        std::string warning;
+        const auto  mapped = io::Read(plain.wstring(), warning);
+
+        for (const auto& read : {io::ReadRegion(plain.wstring(), 0, 0, width, height, warning), io::Read(packed.wstring(), warning)})
+        {
+            ASSERT_EQ(read->Depth(), mapped->Depth()) << name;
+            EXPECT_EQ(std::memcmp(read->Buffer(), mapped->Buffer(), (size_t)count * std::abs(mapped->Depth())), 0) << name;
+
+            const auto readRange   = (acrion::image::BitmapContainer)*read;
+            const auto mappedRange = (acrion::image::BitmapContainer)*mapped;
+            EXPECT_EQ(readRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::minBrightnessKey)), mappedRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::minBrightnessKey))) << name;
+            EXPECT_EQ(readRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::maxBrightnessKey)), mappedRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::maxBrightnessKey))) << name;
+
+            const auto* readScaled   = dynamic_cast<const io::ScaledBitmap*>(read.get());
+            const auto* mappedScaled = dynamic_cast<const io::ScaledBitmap*>(mapped.get());
+            ASSERT_EQ(readScaled == nullptr, mappedScaled == nullptr) << name;
+
+            if (readScaled)
+            {
+                EXPECT_EQ(readScaled->Scale(), mappedScaled->Scale()) << name;
+                EXPECT_EQ(readScaled->Zero(), mappedScaled->Zero()) << name;
+            }
+        }
+
+        // the view of the mapped file has the samples exactly as stored
+        const io::MappedFitsImage view(plain.wstring());
+        EXPECT_EQ(view.Width(), width) << name;
+        EXPECT_EQ(view.Height(), height) << name;
+        EXPECT_EQ(view.Planes(), 1) << name;
+        EXPECT_EQ(view.Bitpix(), bitpix) << name;
+        EXPECT_EQ(std::memcmp(view.Data(), file.data() + 2880, view.PlaneBytes()), 0) << name;
+    };
+
+    check("bytes", 8, bytes, {});
+    check("signed_bytes", 8, bytes, {FitsCard("BZERO", "-128")});
+    check("shorts", 16, shorts, {});
+    check("ushorts", 16, shorts, {FitsCard("BZERO", "32768")});
+    check("scaled_shorts", 16, shorts, {FitsCard("BSCALE", "0.5"), FitsCard("BZERO", "-3")});
+    check("ints", 32, ints, {});
+    check("uints", 32, ints, {FitsCard("BZERO", "2147483648")});
+    check("longs", 64, longs, {});
+    check("ulongs", 64, longs, {FitsCard("BZERO", "9223372036854775808")});
+    check("floats", -32, floats, {});
+    check("doubles", -64, doubles, {});
+
+    // tile-compressed images cannot be mapped
+    std::string                               warning;
+    const acrion::image::BitmapData<uint16_t> compressed(width, height, 1);
+    io::Write(compressed, (directory / "compressed.fz").wstring(), warning);
+    EXPECT_THROW(io::MappedFitsImage((directory / "compressed.fz").wstring()), std::runtime_error);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, CachedReadsReturnIndependentCopies)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 64;
+    constexpr int height = 32;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_cache_copies";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(1024 * 1024);
+    io::InvalidateCache();
+
+    acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        ((uint16_t*)bitmap.Buffer())[i] = (uint16_t)(i * 7);
+    }
+
+    const std::wstring path = (directory / "image.fits").wstring();
+    std::string        warning;
+    io::Write(bitmap, path, warning);
+
+    const io::CacheStatistics before = io::GetCacheStatistics();
+    const auto                first  = io::Read(path, warning);
+    const io::CacheStatistics missed = io::GetCacheStatistics();
+
+    EXPECT_EQ(missed.misses, before.misses + 1);
+    EXPECT_EQ(missed.hits, before.hits);
+    EXPECT_EQ(missed.entries, 1u);
+    EXPECT_EQ(missed.bytes, (size_t)width * height * sizeof(uint16_t));
+
+    // callers may modify the returned bitmaps in place, which must neither change the cached copy nor other results
+    std::fill((uint16_t*)first->Buffer(), (uint16_t*)first->Buffer() + width * height, (uint16_t)0xffff);
+
+    const auto second = io::Read(path, warning);
+    const auto third  = io::Read(path, warning);
+    const auto hit    = io::GetCacheStatistics();
+
+    EXPECT_EQ(hit.hits, missed.hits + 2);
+    EXPECT_EQ(hit.misses, missed.misses);
+    EXPECT_EQ(hit.entries, 1u);
+    EXPECT_NE(second->Buffer(), third->Buffer());
+    ASSERT_EQ(second->Depth(), 2);
+    EXPECT_EQ(std::memcmp(second->Buffer(), bitmap.Buffer(), (size_t)width * height * sizeof(uint16_t)), 0);
+
+    ((uint16_t*)second->Buffer())[0] = 1;
+    EXPECT_EQ(((const uint16_t*)third->Buffer())[0], 0);
+    EXPECT_EQ(std::memcmp(io::Read(path, warning)->Buffer(), bitmap.Buffer(), (size_t)width * height * sizeof(uint16_t)), 0);
+
+    io::InvalidateCache();
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, CacheEvictsLeastRecentlyUsedWithinBudget)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int    width     = 64;
+    constexpr int    height    = 32;
+    constexpr size_t imageSize = (size_t)width * height * sizeof(uint16_t);
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_cache_eviction";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(3 * imageSize);
+    io::InvalidateCache();
+
+    const acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+    std::vector<std::wstring>                 paths;
+    std::string                               warning;
+
+    for (const char* name : {"a.fits", "b.fits", "c.fits", "d.fits"})
+    {
+        paths.push_back((directory / name).wstring());
+        io::Write(bitmap, paths.back(), warning);
+    }
+
+    // Reads the file and returns whether it came from the cache
+    const auto cached = [&](const std::wstring& path)
+    {
+        const size_t hits = io::GetCacheStatistics().hits;
+        io::Read(path, warning);
+        return io::GetCacheStatistics().hits == hits + 1;
+    };
+
+    const size_t evictions = io::GetCacheStatistics().evictions;
+
+    EXPECT_FALSE(cached(paths[0]));
+    EXPECT_FALSE(cached(paths[1]));
+    EXPECT_FALSE(cached(paths[2]));
+    EXPECT_EQ(io::GetCacheStatistics().bytes, 3 * imageSize);
+    EXPECT_EQ(io::GetCacheStatistics().evictions, evictions);
+
+    // a is used again, so b is the least recently used image when d exceeds the budget
+    EXPECT_TRUE(cached(paths[0]));
+    EXPECT_FALSE(cached(paths[3]));
+    EXPECT_EQ(io::GetCacheStatistics().evictions, evictions + 1);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 3u);
+    EXPECT_EQ(io::GetCacheStatistics().bytes, 3 * imageSize);
+
+    EXPECT_TRUE(cached(paths[0]));
+    EXPECT_TRUE(cached(paths[2]));
+    EXPECT_TRUE(cached(paths[3]));
+    EXPECT_FALSE(cached(paths[1])); // evicts a, which is now the least recently used one
+    EXPECT_EQ(io::GetCacheStatistics().evictions, evictions + 2);
+    EXPECT_FALSE(cached(paths[0]));
+
+    // lowering the budget evicts from the least recently used end as well
+    io::SetCacheSize(imageSize);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 1u);
+    EXPECT_TRUE(cached(paths[0]));
+
+    // images larger than the whole budget are not cached
+    io::SetCacheSize(imageSize - 1);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 0u);
+    EXPECT_FALSE(cached(paths[0]));
+    EXPECT_EQ(io::GetCacheStatistics().entries, 0u);
+
+    io::InvalidateCache();
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, CacheReplacesChangedFiles)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 64;
+    constexpr int height = 32;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_cache_changes";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(1024 * 1024);
+    io::InvalidateCache();
+
+    acrion::image::BitmapData<uint16_t> original(width, height, 1);
+    acrion::image::BitmapData<uint16_t> changed(width, height, 1);
+    acrion::image::BitmapData<uint16_t> larger(width, 2 * height, 1);
+    std::fill((uint16_t*)original.Buffer(), (uint16_t*)original.Buffer() + width * height, (uint16_t)1);
+    std::fill((uint16_t*)changed.Buffer(), (uint16_t*)changed.Buffer() + width * height, (uint16_t)2);
+
+    // io::Write invalidates the cache itself, so the files are written elsewhere and copied over, like another program would
+    const std::filesystem::path path = directory / "image.fits";
+    std::string                 warning;
+    io::Write(original, path.wstring(), warning);
+    io::Write(changed, (directory / "changed.fits").wstring(), warning);
+    io::Write(larger, (directory / "larger.fits").wstring(), warning);
+
+    const auto modified = std::filesystem::last_write_time(path);
+    EXPECT_EQ(((const uint16_t*)io::Read(path.wstring(), warning)->Buffer())[0], 1);
+
+    // same size, but a different modification time
+    std::filesystem::copy_file(directory / "changed.fits", path, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::last_write_time(path, modified + std::chrono::seconds(10));
+
+    size_t misses = io::GetCacheStatistics().misses;
+    EXPECT_EQ(((const uint16_t*)io::Read(path.wstring(), warning)->Buffer())[0], 2);
+    EXPECT_EQ(io::GetCacheStatistics().misses, misses + 1);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 1u); // the outdated entry is replaced, not kept until it is evicted
+
+    // a different size with the previous modification time
+    std::filesystem::copy_file(directory / "larger.fits", path, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::last_write_time(path, modified + std::chrono::seconds(10));
+
+    misses = io::GetCacheStatistics().misses;
+    EXPECT_EQ(io::Read(path.wstring(), warning)->Height(), 2 * height);
+    EXPECT_EQ(io::GetCacheStatistics().misses, misses + 1);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 1u);
+    EXPECT_EQ(io::GetCacheStatistics().bytes, (size_t)width * 2 * height * sizeof(uint16_t));
+
+    io::InvalidateCache();
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, CacheInvalidatedAndBypassed)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int width  = 64;
+    constexpr int height = 32;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_cache_invalidation";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(1024 * 1024);
+    io::InvalidateCache();
+
+    const acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+    const std::filesystem::path               first  = directory / "first.fits";
+    const std::filesystem::path               second = directory / "second.fits";
+    std::string                               warning;
+    io::Write(bitmap, first.wstring(), warning);
+    io::Write(bitmap, second.wstring(), warning);
+
+    io::Read(first.wstring(), warning);
+    io::Read(second.wstring(), warning);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 2u);
+
+    // the path is compared in its canonical form
+    io::InvalidateCache((directory / "." / "first.fits").wstring());
+    EXPECT_EQ(io::GetCacheStatistics().entries, 1u);
+
+    size_t hits   = io::GetCacheStatistics().hits;
+    size_t misses = io::GetCacheStatistics().misses;
+    io::Read(first.wstring(), warning);
+    io::Read(second.wstring(), warning);
+    EXPECT_EQ(io::GetCacheStatistics().misses, misses + 1);
+    EXPECT_EQ(io::GetCacheStatistics().hits, hits + 1);
+
+    // an empty path clears the whole cache
+    io::InvalidateCache();
+    EXPECT_EQ(io::GetCacheStatistics().entries, 0u);
+    EXPECT_EQ(io::GetCacheStatistics().bytes, 0u);
+
+    // a budget of 0 bypasses the cache without counting hits or misses
+    io::Read(first.wstring(), warning);
+    io::SetCacheSize(0);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 0u);
+
+    hits   = io::GetCacheStatistics().hits;
+    misses = io::GetCacheStatistics().misses;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(io::Read(first.wstring(), warning)->Width(), width);
+    }
+
+    EXPECT_EQ(io::GetCacheStatistics().hits, hits);
+    EXPECT_EQ(io::GetCacheStatistics().misses, misses);
+    EXPECT_EQ(io::GetCacheStatistics().entries, 0u);
+
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ReadManyDeliversEveryFileOnceWithinBudget)
+{
+    namespace io = acrion::imagetools::io;
+
+    constexpr int    width     = 96;
+    constexpr int    height    = 64;
+    constexpr int    fileCount = 13;
+    constexpr size_t missing   = 5;
+    constexpr size_t imageSize = (size_t)width * height * sizeof(uint16_t);
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_read_many";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(1024 * 1024);
+    io::InvalidateCache();
+
+    std::vector<std::wstring> paths;
+    std::string               warning;
+
+    for (int i = 0; i < fileCount; ++i)
+    {
+        paths.push_back((directory / ("image" + std::to_string(i) + ".fits")).wstring());
+
+        if (i != (int)missing)
+        {
+            acrion::image::BitmapData<uint16_t> bitmap(width, height, 1);
+            std::fill((uint16_t*)bitmap.Buffer(), (uint16_t*)bitmap.Buffer() + width * height, (uint16_t)i);
+            io::Write(bitmap, paths.back(), warning);
+        }
+    }
+
+    io::ReadManyOptions options;
+    options.threads      = 4;
+    options.memoryBudget = 2 * imageSize;
+
+    std::vector<int> deliveries(fileCount, 0);
+    std::atomic<int> inCallback{0};
+    bool             bOverlapped = false;
+    size_t           completed   = 0;
+    size_t           maxInFlight = 0;
+    const size_t     misses      = io::GetCacheStatistics().misses;
+
+    io::ReadMany(paths,
+                 options,
+                 [&](size_t index, std::shared_ptr<acrion::image::Bitmap> bitmap, const std::string&, const std::string& error)
+                 {
+                     bOverlapped |= ++inCallback > 1;
+
+                     // Read registers a cache miss before it decodes, and the memory of a file is reserved from before its Read
+                     // until its callback has returned, so this is a lower bound of the files charged against the budget
+                     maxInFlight = std::max(maxInFlight, io::GetCacheStatistics().misses - misses - completed);
+
+                     ASSERT_LT(index, (size_t)fileCount);
+                     ++deliveries[index];
+
+                     if (index == missing)
+                     {
+                         EXPECT_EQ(bitmap, nullptr);
+                         EXPECT_FALSE(error.empty());
+                     }
+                     else
+                     {
+                         ASSERT_NE(bitmap, nullptr) << index;
+                         EXPECT_TRUE(error.empty()) << index;
+                         EXPECT_EQ(((const uint16_t*)bitmap->Buffer())[0], (uint16_t)index);
+                     }
+
+                     // a slow consumer, so that the other workers finish their files in the meantime
+                     std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+                     if (index != missing)
+                     {
+                         ++completed;
+                     }
+
+                     --inCallback;
+                 });
+
+    EXPECT_EQ(deliveries, std::vector<int>(fileCount, 1));
+    EXPECT_FALSE(bOverlapped);
+    EXPECT_GE(maxInFlight, 1u);
+    EXPECT_LE(maxInFlight * imageSize, options.memoryBudget);
+    EXPECT_EQ(io::EstimateBitmapSize(paths[0]), imageSize);
+
+    // without a budget, the workers read ahead while the callback is busy
+    io::InvalidateCache();
+    options.memoryBudget         = 0;
+    completed                    = 0;
+    maxInFlight                  = 0;
+    const size_t unlimitedMisses = io::GetCacheStatistics().misses;
+
+    io::ReadMany(paths,
+                 options,
+                 [&](size_t index, std::shared_ptr<acrion::image::Bitmap>, const std::string&, const std::string&)
+                 {
+                     maxInFlight = std::max(maxInFlight, io::GetCacheStatistics().misses - unlimitedMisses - completed);
+                     std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                     completed += index != missing;
+                 });
+
+    EXPECT_GT(maxInFlight * imageSize, 2 * imageSize);
+
+    io::InvalidateCache();
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ParallelBandsMatchSerialReads)
+{
+    namespace io       = acrion::imagetools::io;
+    namespace parallel = acrion::imagetools::parallel;
+
+    const int    threadCount = parallel::GetThreadCount();
+    const size_t minimumSize = parallel::GetMinimumParallelSize();
+
+    // Returns the bands ForEachBand splits the rows into, sorted by their first row
+    const auto bandsOf = [](size_t rows, size_t bytesPerRow)
+    {
+        std::mutex                             mutex;
+        std::vector<std::pair<size_t, size_t>> bands;
+        parallel::ForEachBand(rows,
+                              bytesPerRow,
+                              [&](size_t firstRow, size_t rowCount)
+                              {
+                                  std::lock_guard<std::mutex> lock(mutex);
+                                  bands.emplace_back(firstRow, rowCount);
+                              });
+        std::sort(bands.begin(), bands.end());
+        return bands;
+    };
+
+    parallel::SetThreadCount(4);
+    parallel::SetMinimumParallelSize(1000);
+
+    EXPECT_EQ(parallel::ThreadsFor(999), 1);
+    EXPECT_EQ(parallel::ThreadsFor(1000), 4);
+    EXPECT_EQ(bandsOf(99, 10), (std::vector<std::pair<size_t, size_t>>{{0, 99}}));
+
+    // the bands cover all rows without gaps or overlaps
+    const auto bands = bandsOf(101, 10);
+    ASSERT_EQ(bands.size(), 4u);
+
+    size_t nextRow = 0;
+    for (const auto& [firstRow, rowCount] : bands)
+    {
+        EXPECT_EQ(firstRow, nextRow);
+        EXPECT_GT(rowCount, 0u);
+        nextRow = firstRow + rowCount;
+    }
+
+    EXPECT_EQ(nextRow, 101u);
+    EXPECT_EQ(bandsOf(3, 1000).size(), 3u); // not more bands than rows
+
+    {
+        parallel::SerialScope serialScope;
+        EXPECT_EQ(parallel::ThreadsFor(1000000), 1);
+        EXPECT_EQ(bandsOf(101, 10).size(), 1u);
+    }
+
+    EXPECT_EQ(parallel::ThreadsFor(1000000), 4);
+
+    parallel::SetThreadCount(1);
+    EXPECT_EQ(parallel::ThreadsFor(1000000), 1);
+    EXPECT_EQ(bandsOf(101, 10).size(), 1u);
+
+    // Reads through the memory mapped path and through cfitsio, split into bands of a few rows, match serial reads
+    constexpr int width  = 613;
+    constexpr int height = 411;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_parallel";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const size_t cacheSize = io::GetCacheStatistics().byteBudget;
+    io::SetCacheSize(0);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    std::vector<int16_t>                shorts((size_t)width * height);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        ((uint16_t*)integers.Buffer())[i] = (uint16_t)(i * 40503);
+        ((float*)floats.Buffer())[i]      = std::sin(i * 0.001f) * 1000.0f;
+        shorts[i]                         = (int16_t)(i * 7919);
+    }
+
+    std::string file;
+    AppendFitsImage(file, 16, {width, height}, shorts, {});
+    WriteFile(directory / "shorts.fits", file);
+
+    std::vector<std::wstring> paths{(directory / "shorts.fits").wstring()};
+    std::string               warning;
+
+    for (const char* name : {"integers.fits", "floats.fits", "integers.fz", "floats.fz"})
+    {
+        paths.push_back((directory / name).wstring());
+        io::Write(name[0] == 'i' ? (const acrion::image::Bitmap&)integers : floats, paths.back(), warning);
+    }
+
+    parallel::SetThreadCount(4);
+    parallel::SetMinimumParallelSize(1);
+
+    for (const std::wstring& path : paths)
+    {
+        std::shared_ptr<acrion::image::Bitmap> serial;
+
+        {
+            parallel::SerialScope serialScope;
+            serial = io::Read(path, warning);
+        }
+
+        for (const auto& read : {io::Read(path, warning), io::ReadRegion(path, 0, 0, width, height, warning)})
+        {
+            ASSERT_EQ(read->Depth(), serial->Depth());
+            EXPECT_EQ(std::memcmp(read->Buffer(), serial->Buffer(), (size_t)width * height * std::abs(serial->Depth())), 0);
+
+            const auto readRange   = (acrion::image::BitmapContainer)*read;
+            const auto serialRange = (acrion::image::BitmapContainer)*serial;
+            EXPECT_EQ(readRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::minBrightnessKey)), serialRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::minBrightnessKey)));
+            EXPECT_EQ(readRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::maxBrightnessKey)), serialRange.get_mapped_value_or_throw<double>(std::string(acrion::image::Bitmap::maxBrightnessKey)));
+        }
+
+        std::shared_ptr<acrion::image::Bitmap> serialReduced;
+
+        {
+            parallel::SerialScope serialScope;
+            serialReduced = io::ReadReduced(path, 2, io::Reduction::Bin, warning);
+        }
+
+        const auto reduced = io::ReadReduced(path, 2, io::Reduction::Bin, warning);
+        ASSERT_EQ(reduced->Depth(), serialReduced->Depth());
+        EXPECT_EQ(std::memcmp(reduced->Buffer(), serialReduced->Buffer(), (size_t)(width / 2) * (height / 2) * std::abs(reduced->Depth())), 0);
+    }
+
+    parallel::SetThreadCount(threadCount);
+    parallel::SetMinimumParallelSize(minimumSize);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_F(ImageToolsTest, ParallelTileDecompressionMatchesSerial)
+{
+    namespace io       = acrion::imagetools::io;
+    namespace parallel = acrion::imagetools::parallel;
+
+    constexpr int width  = 301;
+    constexpr int height = 257;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "acrion_image_tools_test_parallel_tiles";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    acrion::image::BitmapData<uint16_t> integers(width, height, 1);
+    acrion::image::BitmapData<float>    floats(width, height, 1);
+    uint32_t                            random = 1;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        random                            = random * 1103515245 + 12345;
+        ((uint16_t*)integers.Buffer())[i] = (uint16_t)(random >> 16);
+        ((float*)floats.Buffer())[i]      = 100.0f + (float)(random >> 16) / 6553.6f;
+    }
+
+    ((float*)floats.Buffer())[11] = NAN;
+
+    const io::FitsCompressionOptions previous    = io::GetFitsCompression();
+    const size_t                     cacheSize   = io::GetCacheStatistics().byteBudget;
+    const int                        threadCount = parallel::GetThreadCount();
+    const size_t                     minimumSize = parallel::GetMinimumParallelSize();
+    std::vector<std::wstring>        paths;
+    std::string                      warning;
+
+    io::SetCacheSize(0);
+
+    // tiles of 3 rows, so that neither the bands nor the regions below start at tile boundaries
+    for (io::FitsCompression compression : {io::FitsCompression::Rice, io::FitsCompression::Gzip})
+    {
+        io::FitsCompressionOptions options;
+        options.compression   = compression;
+        options.tileRows      = 3;
+        options.quantizeLevel = compression == io::FitsCompression::Gzip ? 0.0f : 4.0f;
+        io::SetFitsCompression(options);
+
+        const std::string prefix = compression == io::FitsCompression::Rice ? "rice_" : "gzip_";
+
+        for (const auto& [name, bitmap] : std::vector<std::pair<std::string, std::shared_ptr<acrion::image::Bitmap>>>{
+                 {"integers.fits", std::make_shared<acrion::image::Bitmap>(integers)},
+                 {"floats.fits", std::make_shared<acrion::image::Bitmap>(floats)},
+                 {"scaled.fits", std::make_shared<io::ScaledBitmap>(integers, 0.5, 100.0)}})
+        {
+            paths.push_back((directory / (prefix + name)).wstring());
+            io::Write(*bitmap, paths.back(), warning);
+        }
+    }
+
+    io::SetFitsCompression(previous);
+
+    // each band of tile rows opens a handle of its own, which must get the scaling of the caller's handle
+    parallel::SetThreadCount(4);
+    parallel::SetMinimumParallelSize(1);
+
+    for (const std::wstring& path : paths)
+    {
+        const std::string name = std::filesystem::path(path).filename().string();
+
+        for (const auto& [x, y, regionWidth, regionHeight] : {std::tuple<int, int, int, int>{0, 0, width, height}, {7, 10, width - 20, height - 23}})
+        {
+            std::shared_ptr<acrion::image::Bitmap> serial;
+
+            {
+                parallel::SerialScope serialScope;
+                serial = io::ReadRegion(path, x, y, regionWidth, regionHeight, warning);
+            }
+
+            const auto read = io::ReadRegion(path, x, y, regionWidth, regionHeight, warning);
+
+            ASSERT_EQ(read->Depth(), serial->Depth()) << name;
+            ASSERT_EQ(read->Height(), regionHeight) << name;
+            EXPECT_EQ(std::memcmp(read->Buffer(), serial->Buffer(), (size_t)regionWidth * regionHeight * std::abs(serial->Depth())), 0) << name << " " << y;
+            EXPECT_EQ(dynamic_cast<const io::ScaledBitmap*>(read.get()) != nullptr, dynamic_cast<const io::ScaledBitmap*>(serial.get()) != nullptr) << name;
+        }
+
+        std::shared_ptr<acrion::image::Bitmap> serial;
+
+        {
+            parallel::SerialScope serialScope;
+            serial = io::Read(path, warning);
+        }
+
+        EXPECT_EQ(std::memcmp(io::Read(path, warning)->Buffer(), serial->Buffer(), (size_t)width * height * std::abs(serial->Depth())), 0) << name;
+    }
+
+    // lossless compression round trips exactly
+    EXPECT_EQ(std::memcmp(io::Read((directory / "gzip_floats.fits").wstring(), warning)->Buffer(), floats.Buffer(), (size_t)width * height * sizeof(float)), 0);
+    EXPECT_EQ(std::memcmp(io::Read((directory / "rice_integers.fits").wstring(), warning)->Buffer(), integers.Buffer(), (size_t)width * height * sizeof(uint16_t)), 0);
+
+    parallel::SetThreadCount(threadCount);
+    parallel::SetMinimumParallelSize(minimumSize);
+    io::SetCacheSize(cacheSize);
+    std::filesystem::remove_all(directory);
+}
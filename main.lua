@@ -25,13 +25,17 @@ along with acrion image tools. If not, see <https://www.gnu.org/licenses/>.
 
 local ext = {
     "*.tif *.tiff *.TIF *.TIFF",
-    "*.fit *.fits *.FIT *.FITS",
+    "*.fit *.fits *.fz *.fit.gz *.fits.gz *.FIT *.FITS *.FZ *.FIT.GZ *.FITS.GZ",
     "*.png *.PNG",
     "*.jpg *.jpeg *.JPG *.JPEG",
     "*.bmp *.BMP",
     "*.tga *.TGA",
     "*.dcm *.DCM" }
-local saveExt = "TIFF (" .. ext[1] .. ");; FITS (" .. ext[2] .. ");; PNG (" .. ext[3] .. ");; JPEG (" .. ext[4] .. ");; BMP (" .. ext[5] .. ");; TARGA (" .. ext[6] .. ")"
+local function formatFilter(fitsExt)
+    return "TIFF (" .. ext[1] .. ");; FITS (" .. fitsExt .. ");; PNG (" .. ext[3] .. ");; JPEG (" .. ext[4] .. ");; BMP (" .. ext[5] .. ");; TARGA (" .. ext[6] .. ")"
+end
+local openExt = formatFilter(ext[2])
+local saveExt = formatFilter("*.fit *.fits *.fz *.FIT *.FITS *.FZ") -- gzipped FITS files can only be read
 
 function CallOpenImageFile(parameters)
     import("acrion_image_tools", "OpenImageFile", "table(const char*)")
@@ -44,7 +48,228 @@ addmessage("CallOpenImageFile", {
     icon = "FileOpen.svg",
     parameters = {
         path = { type = "loadpath" },
-        filter = { type = "string", internal = "yes", default = "All supported formats (" .. table.concat(ext, ' ') .. ");; " .. saveExt .. ";; DICOM (" .. ext[7] .. ");; All files (*.*)" }
+        filter = { type = "string", internal = "yes", default = "All supported formats (" .. table.concat(ext, ' ') .. ");; " .. openExt .. ";; DICOM (" .. ext[7] .. ");; All files (*.*)" }
+    } })
+
+function CallOpenImageFileRegion(parameters)
+    import("acrion_image_tools", "OpenImageFileRegion", "table(const char*,long long,long long,long long,long long)")
+    return OpenImageFileRegion(parameters.path, parameters.regionX, parameters.regionY, parameters.regionWidth, parameters.regionHeight)
+end
+
+addmessage("CallOpenImageFileRegion", {
+    displayname = "Open region",
+    description = "Open a rectangle of an image file, without loading the whole image (x/y counted from the top left corner)",
+    icon = "FileOpen.svg",
+    parameters = {
+        path = { type = "loadpath" },
+        filter = { type = "string", internal = "yes", default = "All supported formats (" .. table.concat(ext, ' ') .. ");; " .. openExt .. ";; DICOM (" .. ext[7] .. ");; All files (*.*)" },
+        regionX = { type = "long long", default = 0 },
+        regionY = { type = "long long", default = 0 },
+        regionWidth = { type = "long long", default = 2048 },
+        regionHeight = { type = "long long", default = 2048 }
+    } })
+
+function CallOpenImagePreview(parameters)
+    import("acrion_image_tools", "OpenImagePreview", "table(const char*,long long)")
+    return OpenImagePreview(parameters.path, parameters.previewSize)
+end
+
+addmessage("CallOpenImagePreview", {
+    displayname = "Open preview",
+    description = "Open a downscaled 8 bit version of an image file for fast browsing",
+    icon = "FileOpen.svg",
+    parameters = {
+        path = { type = "loadpath" },
+        filter = { type = "string", internal = "yes", default = "All supported formats (" .. table.concat(ext, ' ') .. ");; " .. openExt .. ";; DICOM (" .. ext[7] .. ");; All files (*.*)" },
+        previewSize = { type = "long long", default = 1024 }
+    } })
+
+function CallOpenImageFileReduced(parameters)
+    import("acrion_image_tools", "OpenImageFileReduced", "table(const char*,long long,long long)")
+    return OpenImageFileReduced(parameters.path, parameters.factor, parameters.average)
+end
+
+addmessage("CallOpenImageFileReduced", {
+    displayname = "Open binned",
+    description = "Open an image file with its width and height divided by factor, averaging each block of factor x factor pixels (average = 1) or picking one pixel of it (average = 0)",
+    icon = "FileOpen.svg",
+    parameters = {
+        path = { type = "loadpath" },
+        filter = { type = "string", internal = "yes", default = "All supported formats (" .. table.concat(ext, ' ') .. ");; " .. openExt .. ";; DICOM (" .. ext[7] .. ");; All files (*.*)" },
+        factor = { type = "long long", default = 2 },
+        average = { type = "long long", default = 1 }
+    } })
+
+function CallProbeImageFile(parameters)
+    import("acrion_image_tools", "ProbeImageFile", "table(const char*)")
+    return ProbeImageFile(parameters.path)
+end
+
+addmessage("CallProbeImageFile", {
+    displayname = "Image info",
+    description = "Read width, height, channels and depth from the file header without decoding the image",
+    icon = "",
+    parameters = {
+        path = { type = "loadpath" },
+        filter = { type = "string", internal = "yes", default = "All supported formats (" .. table.concat(ext, ' ') .. ");; " .. openExt .. ";; DICOM (" .. ext[7] .. ");; All files (*.*)" }
+    } })
+
+function CallListImageHdus(parameters)
+    import("acrion_image_tools", "ListImageHdus", "table(const char*)")
+    return ListImageHdus(parameters.path)
+end
+
+addmessage("CallListImageHdus", {
+    displayname = "List FITS HDUs",
+    description = "List the header data units (extensions) of a FITS file and the number of planes of their images",
+    icon = "",
+    parameters = {
+        path = { type = "loadpath" },
+        filter = { type = "string", internal = "yes", default = "FITS (" .. ext[2] .. ");; All files (*.*)" }
+    } })
+
+function CallOpenImagePlane(parameters)
+    import("acrion_image_tools", "OpenImagePlane", "table(const char*,long long,long long)")
+    return OpenImagePlane(parameters.path, parameters.hdu, parameters.plane)
+end
+
+addmessage("CallOpenImagePlane", {
+    displayname = "Open FITS plane",
+    description = "Open a single plane of an image extension or data cube of a FITS file, reading only that plane from disk",
+    icon = "FileOpen.svg",
+    parameters = {
+        path = { type = "loadpath" },
+        filter = { type = "string", internal = "yes", default = "FITS (" .. ext[2] .. ");; All files (*.*)" },
+        hdu = { type = "long long", default = 0 },
+        plane = { type = "long long", default = 0 }
+    } })
+
+function CallInvalidateImageCache(parameters)
+    import("acrion_image_tools", "InvalidateImageCache", "table(const char*)")
+    return InvalidateImageCache(parameters.path)
+end
+
+addmessage("CallInvalidateImageCache", {
+    displayname = "Invalidate image cache",
+    description = "Remove an image file from the cache of decoded images, or clear the whole cache if no path is given",
+    icon = "",
+    parameters = {
+        path = { type = "string", default = "" }
+    } })
+
+function CallSetImageCacheSize(parameters)
+    import("acrion_image_tools", "SetImageCacheSize", "table(long long)")
+    return SetImageCacheSize(parameters.cacheSize)
+end
+
+addmessage("CallSetImageCacheSize", {
+    displayname = "Set image cache size",
+    description = "Set the budget of the cache of decoded images in bytes, 0 disables it",
+    icon = "",
+    parameters = {
+        cacheSize = { type = "long long", default = 536870912 }
+    } })
+
+function CallGetImageCacheStatistics(parameters)
+    import("acrion_image_tools", "GetImageCacheStatistics", "table(table)")
+    return GetImageCacheStatistics(parameters)
+end
+
+addmessage("CallGetImageCacheStatistics", {
+    displayname = "Image cache statistics",
+    description = "Report hits, misses and evictions of the cache of decoded images",
+    icon = "",
+    parameters = {} })
+
+function CallSetImageDisplayRange(parameters)
+    import("acrion_image_tools", "SetImageDisplayRange", "table(table)")
+    return SetImageDisplayRange(parameters)
+end
+
+addmessage("CallSetImageDisplayRange", {
+    displayname = "Set display range",
+    description = "Choose how opened images get their brightness range for display: exact (minimum and maximum), percentile or zscale (IRAF) of a sample of the pixels",
+    icon = "",
+    parameters = {
+        mode = { type = "string", default = "exact" },
+        samples = { type = "long long", default = 100000 },
+        lowPercentile = { type = "double", default = 0.5 },
+        highPercentile = { type = "double", default = 99.5 },
+        contrast = { type = "double", default = 0.25 }
+    } })
+
+function CallSetFitsCompression(parameters)
+    import("acrion_image_tools", "SetFitsCompression", "table(table)")
+    return SetFitsCompression(parameters)
+end
+
+addmessage("CallSetFitsCompression", {
+    displayname = "Set FITS compression",
+    description = "Choose the tile compression of saved .fits files: none, rice, gzip or hcompress. Floating point images are quantized to the noise of each tile divided by quantizeLevel, or stored losslessly with gzip and quantizeLevel 0",
+    icon = "",
+    parameters = {
+        compression = { type = "string", default = "none" },
+        quantizeLevel = { type = "double", default = 4.0 },
+        ditherSeed = { type = "long long", default = 0 },
+        hcompressScale = { type = "double", default = 0.0 },
+        tileRows = { type = "long long", default = 0 }
+    } })
+
+function CallSetFitsChecksums(parameters)
+    import("acrion_image_tools", "SetFitsChecksums", "table(table)")
+    return SetFitsChecksums(parameters)
+end
+
+addmessage("CallSetFitsChecksums", {
+    displayname = "Set FITS checksums",
+    description = "With write 1, saved FITS images get the DATASUM and CHECKSUM keywords. With verify 1, opened FITS images that have them are checked and not opened if they do not match",
+    icon = "",
+    parameters = {
+        write = { type = "long long", default = 1 },
+        verify = { type = "long long", default = 1 }
+    } })
+
+function CallSetFitsReadBlocks(parameters)
+    import("acrion_image_tools", "SetFitsReadBlocks", "table(table)")
+    return SetFitsReadBlocks(parameters)
+end
+
+addmessage("CallSetFitsReadBlocks", {
+    displayname = "Set FITS read blocks",
+    description = "Read uncompressed FITS files in blockCount aligned blocks of blockSize bytes (rounded up to 64 KiB), which speeds up regions and planes of large files on network and spinning disks. A blockSize of 0 restores the default stdio reads",
+    icon = "",
+    parameters = {
+        blockSize = { type = "long long", default = 4194304 },
+        blockCount = { type = "long long", default = 4 }
+    } })
+
+function CallUpdateFitsIndex(parameters)
+    import("acrion_image_tools", "UpdateFitsIndex", "table(const char*,const char*,const char*)")
+    return UpdateFitsIndex(parameters.index, parameters.directory, parameters.keywords)
+end
+
+addmessage("CallUpdateFitsIndex", {
+    displayname = "Update FITS index",
+    description = "Index the given header keywords of all FITS files below a directory, reading only the headers of new or modified files",
+    icon = "",
+    parameters = {
+        index = { type = "savepath" },
+        directory = { type = "string" },
+        keywords = { type = "string", default = "EXPTIME FILTER OBJECT DATE-OBS" }
+    } })
+
+function CallQueryFitsIndex(parameters)
+    import("acrion_image_tools", "QueryFitsIndex", "table(const char*,const char*)")
+    return QueryFitsIndex(parameters.index, parameters.query)
+end
+
+addmessage("CallQueryFitsIndex", {
+    displayname = "Query FITS index",
+    description = "List the indexed FITS files whose header values satisfy all conditions, e.g. EXPTIME=300 FILTER=R AIRMASS<1.5",
+    icon = "",
+    parameters = {
+        index = { type = "loadpath" },
+        query = { type = "string" }
     } })
 
 function CallSaveImageFile(parameters)
@@ -65,7 +290,9 @@ addmessage("CallSaveImageFile", {
         channels = { type = "long long" },
         depth = { type = "long long" },
         minBrightness = { type = "double" },
-        maxBrightness = { type = "double" }
+        maxBrightness = { type = "double" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 }
     } })
 
 function CallSwap(parameters)
@@ -83,7 +310,11 @@ addmessage("CallSwap", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallCopyLeftToRight(parameters)
@@ -101,7 +332,11 @@ addmessage("CallCopyLeftToRight", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallCopyRightToLeft(parameters)
@@ -119,7 +354,11 @@ addmessage("CallCopyRightToLeft", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallInvertImage(parameters)
@@ -156,7 +395,11 @@ addmessage("CallSubtractLeftRightNoWrap", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallSubtractRightLeftNoWrap(parameters)
@@ -174,7 +417,11 @@ addmessage("CallSubtractRightLeftNoWrap", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallSubtractLeftRightWrap(parameters)
@@ -192,7 +439,11 @@ addmessage("CallSubtractLeftRightWrap", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallSubtractRightLeftWrap(parameters)
@@ -210,7 +461,11 @@ addmessage("CallSubtractRightLeftWrap", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallSubtractLeftRightAbs(parameters)
@@ -228,7 +483,11 @@ addmessage("CallSubtractLeftRightAbs", {
         width = { type = "long long" },
         height = { type = "long long" },
         channels = { type = "long long" },
-        depth = { type = "long long" }
+        depth = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 },
+        referenceBscale = { type = "double", default = 1.0 },
+        referenceBzero = { type = "double", default = 0.0 }
     } })
 
 function CallSubtractLeftRightLua(parameters)
@@ -332,7 +591,13 @@ function GetPixelValueOfChannel(parameters)
         if channel > 0 then
             val = val .. ", "
         end
-        val = val .. tostring(peek(addoffset(address, channel, depth), depth))
+        local stored = peek(addoffset(address, channel, depth), depth)
+        if parameters.bscale ~= 1 or parameters.bzero ~= 0 then
+            -- scaled FITS images keep the stored integers in memory, so the physical value is computed here
+            val = val .. tostring(parameters.bzero + parameters.bscale * stored) .. " (stored " .. tostring(stored) .. ")"
+        else
+            val = val .. tostring(stored)
+        end
     end
     return { message = val }
 end
@@ -349,7 +614,9 @@ addmessage("GetPixelValueOfChannel", {
         channels = { type = "long long" },
         depth = { type = "long long" },
         x = { type = "long long" },
-        y = { type = "long long" } }
+        y = { type = "long long" },
+        bscale = { type = "double", default = 1.0 },
+        bzero = { type = "double", default = 0.0 } }
 })
 
 -- function TestMouseEvents(parameters)